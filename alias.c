@@ -0,0 +1,345 @@
+/*
+ * zsh - A mini shell program
+ * NKU OS Course
+ * Shuhao Zhang
+ *
+ * file: alias.c
+ *
+ * Aliases: alias name=value, unalias name. The first word of a command
+ * (and of every pipeline stage) that is an alias is replaced by the words
+ * of its value; if the value ends with a blank, the word after it is
+ * checked, too. An alias is not expanded again inside its own expansion,
+ * so `alias ls='ls -F'` works. Quoted words are never expanded.
+ *
+ * Aliases live in a hash table, their values split into words once when
+ * they are defined, so expanding one is a lookup and a copy of its words.
+ * eval() expands the words of a command line once, right after
+ * parseline(); a command queued with after keeps its expanded argv.
+ */
+#include "main.h"
+#include <stdint.h>
+
+#define MAXCHAIN   32           /* aliases expanded for one command word */
+
+struct alias {
+    struct alias *next;         /* in its hash bucket */
+    uint32_t hash;
+    int nwords;
+    int blank;                  /* the value ends with a blank */
+    char *name;
+    char *value;
+    char **words;               /* the value split like parseline() does */
+    char *quoted;
+};
+
+static struct alias **table;
+static uint32_t nbuckets, nalias;
+
+/* hash - FNV-1a of s */
+static uint32_t hash(const char *s)
+{
+    uint32_t h = 2166136261u;
+
+    while (*s)
+        h = (h ^ (unsigned char)*s++) * 16777619u;
+    return h;
+}
+
+/* find - The alias called name, or NULL */
+static struct alias *find(const char *name)
+{
+    uint32_t h;
+
+    if (nalias == 0)
+        return NULL;
+    h = hash(name);
+    for (struct alias *a = table[h & (nbuckets - 1)]; a; a = a->next)
+        if (a->hash == h && !strcmp(a->name, name))
+            return a;
+    return NULL;
+}
+
+/* split - Split value into words in buf, like parseline(), return count */
+static int split(char *buf, char **words, char *quoted)
+{
+    int n = 0;
+    char *end;
+
+    while (1)
+    {
+        while (*buf == ' ' || *buf == '\t')
+            buf++;
+        if (!*buf)
+            return n;
+        if ((quoted[n] = *buf == '\'') != 0)
+            end = strchr(++buf, '\'');
+        else
+            end = buf + strcspn(buf, " \t");
+        words[n++] = buf;
+        if (!end || !*end)
+            return n;
+        *end = '\0';
+        buf = end + 1;
+    }
+}
+
+/* grow - Double the hash table */
+static int grow(void)
+{
+    uint32_t size = nbuckets ? nbuckets * 2 : 64;
+    struct alias **t, *a, *next;
+
+    if ((t = calloc(size, sizeof(*t))) == NULL)
+        return -1;
+    for (uint32_t i = 0; i < nbuckets; i++)
+        for (a = table[i]; a; a = next)
+        {
+            next = a->next;
+            a->next = t[a->hash & (size - 1)];
+            t[a->hash & (size - 1)] = a;
+        }
+    free(table);
+    table = t;
+    nbuckets = size;
+    return 0;
+}
+
+/* alias_remove - Remove the alias called name, -1 if there is none */
+static int alias_remove(const char *name)
+{
+    struct alias **p;
+    uint32_t h = hash(name);
+
+    if (nalias == 0)
+        return -1;
+    for (p = &table[h & (nbuckets - 1)]; *p; p = &(*p)->next)
+        if ((*p)->hash == h && !strcmp((*p)->name, name))
+        {
+            struct alias *a = *p;
+
+            *p = a->next;
+            free(a);
+            nalias--;
+            return 0;
+        }
+    return -1;
+}
+
+/*
+ * alias_define - Define (or redefine) the alias name. Returns 0, or -1
+ *     if out of memory.
+ */
+int alias_define(const char *name, const char *value)
+{
+    size_t nlen = strlen(name) + 1, vlen = strlen(value) + 1;
+    int max = vlen / 2 + 1;     /* words in value, at most */
+    struct alias *a;
+    char *p;
+
+    if (nalias >= nbuckets && grow() < 0)
+        return -1;
+    alias_remove(name);
+
+    /* the alias, its words, name, value and the split copy in one block */
+    if ((a = malloc(sizeof(*a) + max * sizeof(char *) + max + nlen + 2 * vlen)) == NULL)
+        return -1;
+    a->words = (char **)(a + 1);
+    a->quoted = (char *)(a->words + max);
+    a->name = memcpy(a->quoted + max, name, nlen);
+    a->value = memcpy(a->name + nlen, value, vlen);
+    p = memcpy(a->value + vlen, value, vlen);
+    a->nwords = split(p, a->words, a->quoted);
+    a->blank = vlen > 1 && (value[vlen - 2] == ' ' || value[vlen - 2] == '\t');
+    a->hash = hash(name);
+    a->next = table[a->hash & (nbuckets - 1)];
+    table[a->hash & (nbuckets - 1)] = a;
+    nalias++;
+    return 0;
+}
+
+/* alias_each - Call fn for every alias */
+void alias_each(void (*fn)(const char *name, const char *value, void *arg), void *arg)
+{
+    for (uint32_t i = 0; i < nbuckets; i++)
+        for (struct alias *a = table[i]; a; a = a->next)
+            fn(a->name, a->value, arg);
+}
+
+/*
+ * alias_expand - Expand the aliases of the command words of argv (ending
+ *     with NULL); quoted[i] is set if argv[i] was quoted. The words of an
+ *     expansion are copied, so eval() may change them in place. Returns 0,
+ *     or -1 after printing an error.
+ */
+int alias_expand(char **argv, char *quoted)
+{
+    static char buf[MAXLINE];   /* the copied words of this command line */
+    struct alias *a, *chain[MAXCHAIN];
+    size_t used = 0;
+    int argc, i, k, n, end, check = 1;
+
+    if (nalias == 0)
+        return 0;
+    for (argc = 0; argv[argc]; argc++)
+        ;
+    for (i = 0; i < argc; i = end)
+    {
+        end = i + 1;            /* the word after argv[i] and its expansion */
+        if (!strcmp(argv[i], "|"))
+        {
+            check = 1;
+            continue;
+        }
+        if (!check)
+            continue;
+        check = 0;
+
+        for (n = 0; i < argc && !quoted[i] && (a = find(argv[i])) != NULL; n++)
+        {
+            /* the alias is in its own expansion: stop */
+            for (k = 0; k < n && chain[k] != a; k++)
+                ;
+            if (k < n || n == MAXCHAIN)
+                break;
+            chain[n] = a;
+
+            if (argc - 1 + a->nwords >= MAXARGS)
+            {
+                printf("%s: Argument list too long\n", a->name);
+                return -1;
+            }
+            memmove(argv + i + a->nwords, argv + i + 1, (argc - i) * sizeof(*argv));
+            memmove(quoted + i + a->nwords, quoted + i + 1, argc - i);
+            for (k = 0; k < a->nwords; k++)
+            {
+                size_t len = strlen(a->words[k]) + 1;
+
+                if (used + len > sizeof(buf))
+                {
+                    printf("%s: Command line too long\n", a->name);
+                    return -1;
+                }
+                argv[i + k] = memcpy(buf + used, a->words[k], len);
+                quoted[i + k] = a->quoted[k];
+                used += len;
+            }
+            argc += a->nwords - 1;
+            end += a->nwords - 1;
+            check |= a->blank;
+        }
+        /* expanded to nothing: the next word is the command */
+        if (end == i)
+            check = 1;
+    }
+    return 0;
+}
+
+/* show - Print one alias the way it is defined */
+static void show(const char *name, const char *value, void *arg)
+{
+    (void)arg;
+    printf("alias %s='%s'\n", name, value);
+}
+
+/* cmp - Order aliases by name for listing */
+static int cmp(const void *a, const void *b)
+{
+    return strcmp((*(struct alias *const *)a)->name, (*(struct alias *const *)b)->name);
+}
+
+/*
+ * do_alias - Execute the builtin alias command:
+ *     alias                list every alias
+ *     alias name           show one
+ *     alias name=value     define one; value may be quoted, 'ls -l'
+ */
+void do_alias(int argc, char **argv)
+{
+    char value[MAXLINE], *eq, *name;
+    struct alias *a, **all;
+    uint32_t n = 0;
+
+    if (argc == 1)
+    {
+        if ((all = malloc((nalias + 1) * sizeof(*all))) == NULL)
+            return;
+        for (uint32_t i = 0; i < nbuckets; i++)
+            for (a = table[i]; a; a = a->next)
+                all[n++] = a;
+        qsort(all, n, sizeof(*all), cmp);
+        for (uint32_t i = 0; i < n; i++)
+            show(all[i]->name, all[i]->value, NULL);
+        free(all);
+        return;
+    }
+
+    for (int i = 1; i < argc; i++)
+    {
+        if ((eq = strchr(argv[i], '=')) == NULL)
+        {
+            if ((a = find(argv[i])) != NULL)
+                show(a->name, a->value, NULL);
+            else
+                printf("alias: %s: not found\n", argv[i]);
+            continue;
+        }
+        name = argv[i];
+        *eq = '\0';
+        snprintf(value, sizeof(value), "%s", eq + 1);
+
+        /* parseline() split name='ls -l' at the blank: join the words.
+         * It drops a lone closing quote, as in name='echo ', so a value
+         * that ends without one ended with the blank before it. */
+        if (value[0] == '\'')
+        {
+            size_t len = strlen(value);
+
+            while ((len < 2 || value[len - 1] != '\'') && i + 1 < argc)
+                len += snprintf(value + len, sizeof(value) - len, " %s", argv[++i]);
+            len = strlen(value);
+            if (len >= 2 && value[len - 1] == '\'')
+                value[--len] = '\0';
+            else if (len < sizeof(value) - 1)
+            {
+                value[len++] = ' ';
+                value[len] = '\0';
+            }
+            memmove(value, value + 1, len);
+        }
+        if (!*name || strchr(name, '/'))
+            printf("alias: %s: invalid alias name\n", name);
+        else if (alias_define(name, value) < 0)
+            printf("alias: %s\n", strerror(errno));
+    }
+}
+
+/*
+ * do_unalias - Execute the builtin unalias command: unalias -a | name...
+ */
+void do_unalias(int argc, char **argv)
+{
+    struct alias *a, *next;
+
+    if (argc == 1)
+    {
+        printf("usage: unalias -a | name...\n");
+        return;
+    }
+    if (!strcmp(argv[1], "-a"))
+    {
+        for (uint32_t i = 0; i < nbuckets; i++)
+        {
+            for (a = table[i]; a; a = next)
+            {
+                next = a->next;
+                free(a);
+            }
+            table[i] = NULL;
+        }
+        nalias = 0;
+        return;
+    }
+    for (int i = 1; i < argc; i++)
+        if (alias_remove(argv[i]) < 0)
+            printf("unalias: %s: not found\n", argv[i]);
+}
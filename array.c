@@ -0,0 +1,94 @@
+/*
+ * zsh - A mini shell program
+ * NKU OS Course
+ * Shuhao Zhang
+ *
+ * file: array.c
+ *
+ * Arrays, as filled by mapfile: ${NAME[i]} is element i (from the end if
+ * i is negative, "" past either end) and ${#NAME[@]} the number of
+ * elements. Arrays are shell variables, not part of the environment, so
+ * a million-line array costs the commands the shell starts nothing.
+ *
+ * An array is one block with the text of all its elements and a vector
+ * pointing into it; mapfile builds both in a single pass over its input.
+ */
+#include "main.h"
+
+struct array {
+    struct array *next;
+    char *name;
+    char *data;                 /* the elements' text */
+    char **items;
+    size_t n;
+    char count[24];             /* n, for ${#NAME[@]} */
+};
+
+static struct array *arrays;
+
+/* find - The array called name (n bytes), or NULL */
+static struct array *find(const char *name, size_t n)
+{
+    for (struct array *a = arrays; a; a = a->next)
+        if (!strncmp(a->name, name, n) && a->name[n] == '\0')
+            return a;
+    return NULL;
+}
+
+/*
+ * array_set - Make name the array of the n strings items[], pointing into
+ *     data. Takes over data and items, both from malloc(). Returns 0, or
+ *     -1 if out of memory.
+ */
+int array_set(const char *name, char *data, char **items, size_t n)
+{
+    struct array *a = find(name, strlen(name));
+
+    if (!a)
+    {
+        if ((a = calloc(1, sizeof(*a))) == NULL || (a->name = strdup(name)) == NULL)
+        {
+            free(a);
+            free(data);
+            free(items);
+            return -1;
+        }
+        a->next = arrays;
+        arrays = a;
+    }
+    free(a->data);
+    free(a->items);
+    a->data = data;
+    a->items = items;
+    a->n = n;
+    snprintf(a->count, sizeof(a->count), "%zu", n);
+    return 0;
+}
+
+/*
+ * array_expand - The value of word if it is ${NAME[i]} or ${#NAME[@]} of
+ *     an array, else NULL
+ */
+const char *array_expand(const char *word)
+{
+    const char *name, *sub, *close;
+    struct array *a;
+    long i;
+    char *end;
+
+    if (strncmp(word, "${", 2))
+        return NULL;
+    name = word + 2 + (word[2] == '#');
+    if ((sub = strchr(name, '[')) == NULL || (close = strchr(sub, ']')) == NULL
+        || strcmp(close, "]}") || (a = find(name, sub - name)) == NULL)
+        return NULL;
+    if (word[2] == '#')
+        return close - sub == 2 && (sub[1] == '@' || sub[1] == '*') ? a->count : NULL;
+
+    i = strtol(sub + 1, &end, 10);
+    if (end != close || end == sub + 1)
+        return NULL;
+    if (i < 0)
+        i += a->n;
+    return i >= 0 && (size_t)i < a->n ? a->items[i] : "";
+}
@@ -0,0 +1,39 @@
+#!/bin/sh
+# Launch rate of external commands: direct fork() versus the pre-forked
+# launcher (zsh -z), as the shell grows with more variables.
+#
+# usage: bench/launch.sh [launches] [max variables]
+
+ZSH=${ZSH:-./zsh}
+N=${1:-2000}
+MAXVARS=${2:-1000}
+PAD=$(head -c 1000 /dev/zero | tr '\0' x)
+TMP=$(mktemp -d)
+trap 'rm -rf "$TMP"' EXIT
+
+printf "%8s %14s %14s\n" vars "fork (/s)" "launcher (/s)"
+vars=0
+while [ "$vars" -le "$MAXVARS" ]; do
+    : > "$TMP/script"
+    i=0
+    while [ "$i" -lt "$vars" ]; do
+        echo "BENCH_VAR_$i=$PAD" >> "$TMP/script"
+        i=$((i + 1))
+    done
+    i=0
+    while [ "$i" -lt "$N" ]; do
+        echo "/bin/true" >> "$TMP/script"
+        i=$((i + 1))
+    done
+
+    line="$vars"
+    for opt in "" "-z"; do
+        start=$(date +%s%N)
+        $ZSH -f -p $opt < "$TMP/script" > /dev/null
+        end=$(date +%s%N)
+        line="$line $((N * 1000000000 / (end - start)))"
+    done
+    printf "%8s %14s %14s\n" $line
+
+    if [ "$vars" -eq 0 ]; then vars=100; else vars=$((vars * 10)); fi
+done
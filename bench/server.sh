@@ -0,0 +1,51 @@
+#!/bin/sh
+# Script throughput: a new `zsh -p` per script versus one long-lived
+# `zsh -S` server fed by zshc, sequentially and with P clients at once.
+#
+# usage: bench/server.sh [scripts] [parallel clients]
+
+ZSH=${ZSH:-./zsh}
+ZSHC=${ZSHC:-./zshc}
+N=${1:-500}
+P=${2:-8}
+TMP=$(mktemp -d)
+SOCK="$TMP/sock"
+trap 'kill $SERVER 2>/dev/null; rm -rf "$TMP"' EXIT
+
+cat > "$TMP/script" <<'SCRIPT'
+BENCH=1
+cd /tmp
+/bin/true
+SCRIPT
+
+$ZSH -f -S "$SOCK" > /dev/null &
+SERVER=$!
+while [ ! -S "$SOCK" ]; do sleep 0.01; done
+
+# run CMD... < script N times split over $1 parallel loops, print scripts/s
+rate()
+{
+    par=$1
+    shift
+    start=$(date +%s%N)
+    j=0
+    while [ "$j" -lt "$par" ]; do
+        (
+            i=0
+            while [ "$i" -lt $((N / par)) ]; do
+                "$@" < "$TMP/script" > /dev/null
+                i=$((i + 1))
+            done
+        ) &
+        j=$((j + 1))
+    done
+    wait
+    end=$(date +%s%N)
+    echo $((N / par * par * 1000000000 / (end - start)))
+}
+
+printf "%-22s %10s %10s\n" "" "serial/s" "x$P/s"
+printf "%-22s %10s %10s\n" "zsh -p" \
+    "$(rate 1 "$ZSH" -f -p)" "$(rate "$P" "$ZSH" -f -p)"
+printf "%-22s %10s %10s\n" "zshc -S sock" \
+    "$(rate 1 "$ZSHC" -S "$SOCK")" "$(rate "$P" "$ZSHC" -S "$SOCK")"
@@ -0,0 +1,37 @@
+#!/bin/sh
+# Start-up time of the shell (execve to reading the first command):
+# without a startup file, with a large ~/.zshenv read line by line, and
+# with its snapshot mapped (zsh -s).
+#
+# usage: bench/startup.sh [starts] [variables in the startup file]
+
+ZSH=$(realpath "${ZSH:-./zsh}")
+N=${1:-500}
+VARS=${2:-3000}
+PAD=$(head -c 40 /dev/zero | tr '\0' x)
+TMP=$(mktemp -d)
+trap 'rm -rf "$TMP"' EXIT
+
+i=0
+while [ "$i" -lt "$VARS" ]; do
+    echo "BENCH_VAR_$i=$PAD" >> "$TMP/.zshenv"
+    i=$((i + 1))
+done
+
+# microseconds per start of zsh -p with the given options
+per_start() {
+    start=$(date +%s%N)
+    i=0
+    while [ "$i" -lt "$N" ]; do
+        HOME="$TMP" "$ZSH" -p "$@" < /dev/null > /dev/null
+        i=$((i + 1))
+    done
+    end=$(date +%s%N)
+    echo $(((end - start) / N / 1000))
+}
+
+printf "%-24s %8s\n" "startup file" "us"
+printf "%-24s %8s\n" none "$(per_start -f)"
+printf "%-24s %8s\n" "$VARS lines" "$(per_start)"
+HOME="$TMP" "$ZSH" -p -s < /dev/null > /dev/null
+printf "%-24s %8s\n" "$VARS lines, snapshot" "$(per_start)"
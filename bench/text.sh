@@ -0,0 +1,43 @@
+#!/bin/sh
+# wc, head and grep -F run by the shell (with the best vector routines,
+# and ZSH_SIMD=scalar) against the coreutils commands, on a file of
+# text lines grown to the given size.
+#
+# usage: bench/text.sh [MB]
+
+ZSH=$(realpath "${ZSH:-./zsh}")
+MB=${1:-2048}
+TMP=$(mktemp -d)
+trap 'rm -rf "$TMP"' EXIT
+F="$TMP/text"
+
+# lines of 0 to 12 words, one of them now and then "needle"
+awk 'BEGIN { srand(1); split("foo bar hay quux lorem ipsum dolor", w, " ");
+             for (i = 0; i < 200000; i++) { n = int(rand() * 13); s = "";
+                 for (j = 0; j < n; j++) s = s (j ? " " : "") (rand() < 0.01 ? "needle" : w[int(rand() * 7) + 1]);
+                 print s } }' > "$TMP/chunk"
+: > "$F"
+while [ $(($(wc -c < "$F") / 1048576)) -lt "$MB" ]; do
+    cat "$TMP/chunk" >> "$F"
+done
+cat "$F" > /dev/null    # in the page cache for all runs
+
+# milliseconds for the shell to run the command line $1, ZSH_SIMD=$2;
+# not into /dev/null, which GNU grep notices and stops at the first match
+ms() {
+    start=$(date +%s%N)
+    printf '%s\n' "$1" | ZSH_SIMD=$2 "$ZSH" -p > "$TMP/out"
+    end=$(date +%s%N)
+    echo $(((end - start) / 1000000))
+}
+
+printf "%s: %d MB\n" "$F" $(($(wc -c < "$F") / 1048576))
+printf "%-28s %10s %10s %10s\n" command "coreutils" "zsh" "zsh scalar"
+for cmd in "wc -l FILE" "wc -w FILE" "wc FILE" "cat FILE | wc -l" "grep -F needle FILE" \
+           "grep -Fc zzz FILE" "cat FILE | grep -Fc needle" "grep -Fvc needle FILE" \
+           "cat FILE | head -n 10"; do
+    builtin=$(echo "$cmd" | sed "s|FILE|$F|g")
+    external=$(echo "$builtin" | sed "s|wc |/usr/bin/wc |; s|grep |/bin/grep |; s|head |/usr/bin/head |")
+    printf "%-28s %10s %10s %10s\n" "$cmd" "$(ms "$external")" "$(ms "$builtin")" \
+        "$(ms "$builtin" scalar)"
+done
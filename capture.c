@@ -0,0 +1,225 @@
+/*
+ * zsh - A mini shell program
+ * NKU OS Course
+ * Shuhao Zhang
+ *
+ * file: capture.c
+ *
+ * Output capture for background jobs (zsh -b). Instead of writing to the
+ * terminal, the stdout and stderr of every stage of a background job go
+ * to one pipe. The shell keeps the read end non-blocking in the job entry
+ * and drains it into a fixed-size ring whenever it waits anyway (see
+ * wait_event() and wait_input()), so a chatty job never blocks on a full
+ * pipe and never blocks the shell. `jobs -o %N [K]` prints the last K
+ * bytes of a job's ring.
+ *
+ * Each ring holds CAPTURE_RING bytes and all rings together at most
+ * CAPTURE_MAX. Jobs started once the budget is used up still get a pipe,
+ * but their output is drained and dropped.
+ *
+ * The SIGCHLD handler deletes jobs but never touches capture state: the
+ * pipe of a finished job is drained here, from the main flow, and its
+ * ring stays in the free job slot so `jobs -o` still works after the job
+ * is done. It is freed when addjob() reuses the slot, or evicted when a
+ * new job needs the memory.
+ */
+#include "main.h"
+#include <poll.h>
+#include <sys/uio.h>
+
+extern struct job_t jobs[MAXJOBS];
+
+#define CAPTURE_RING  (64 * 1024)        /* bytes kept per job */
+#define CAPTURE_MAX   (8 * 1024 * 1024)  /* bytes kept over all jobs */
+
+/* Last bytes written by a job */
+struct ring {
+    int jid;                    /* the job, also after it is done */
+    pid_t pid;
+    char *cmdline;              /* a copy, the job's goes with the job */
+    size_t head;                /* where the next byte goes */
+    unsigned long long total;   /* bytes ever written */
+    char data[CAPTURE_RING];
+};
+
+int capture_on = 0;             /* capture background job output (-b) */
+static size_t capture_used = 0; /* bytes of all rings */
+
+/*
+ * capture_attach - Make fd, the read end of a job's output pipe, the
+ *     job's capture pipe, with a ring if the budget allows.
+ */
+void capture_attach(struct job_t *job, int fd)
+{
+    struct ring *r;
+
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+    job->capfd = fd;
+    job->ring = NULL;
+
+    /* make room by dropping the output of a finished job */
+    for (int i = 0; i < MAXJOBS && capture_used + sizeof(*r) > CAPTURE_MAX; i++)
+        if (jobs[i].jid == 0 && jobs[i].capfd < 0 && jobs[i].ring)
+            capture_release(&jobs[i]);
+
+    if (capture_used + sizeof(*r) > CAPTURE_MAX || (r = malloc(sizeof(*r))) == NULL)
+        return;
+    if ((r->cmdline = strdup(job->cmdline)) == NULL)
+    {
+        free(r);
+        return;
+    }
+    capture_used += sizeof(*r);
+    r->jid = job->jid;
+    r->pid = job->pid;
+    r->head = 0;
+    r->total = 0;
+    job->ring = r;
+}
+
+/*
+ * capture_release - Drop the capture state of a job slot.
+ */
+void capture_release(struct job_t *job)
+{
+    if (job->capfd >= 0)
+        close(job->capfd);
+    job->capfd = -1;
+    if (job->ring)
+    {
+        free(job->ring->cmdline);
+        free(job->ring);
+        capture_used -= sizeof(struct ring);
+    }
+    job->ring = NULL;
+}
+
+/*
+ * capture_pollfds - Add the open capture pipes to pfd, return how many.
+ */
+int capture_pollfds(struct pollfd *pfd)
+{
+    int n = 0;
+
+    for (int i = 0; i < jobs_used; i++)
+    {
+        if (jobs[i].capfd < 0)
+            continue;
+        pfd[n].fd = jobs[i].capfd;
+        pfd[n].events = POLLIN;
+        pfd[n++].revents = 0;
+    }
+    return n;
+}
+
+/* drain - Move what the pipe of job holds into its ring, without blocking */
+static void drain(struct job_t *job)
+{
+    static char discard[4096];
+    struct ring *r = job->ring;
+    struct iovec iov[2];
+    ssize_t n;
+
+    while (1)
+    {
+        if (r)
+        {
+            /* read straight into the ring, wrapping at its end */
+            iov[0].iov_base = r->data + r->head;
+            iov[0].iov_len = CAPTURE_RING - r->head;
+            iov[1].iov_base = r->data;
+            iov[1].iov_len = r->head;
+            n = readv(job->capfd, iov, r->head ? 2 : 1);
+        }
+        else
+            n = read(job->capfd, discard, sizeof(discard));
+
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n < 0)
+            return;                 /* EAGAIN: nothing more for now */
+        if (n == 0)
+        {
+            /* every writer is gone, keep the ring for jobs -o */
+            close(job->capfd);
+            job->capfd = -1;
+            return;
+        }
+        if (r)
+        {
+            r->head = (r->head + n) % CAPTURE_RING;
+            r->total += n;
+        }
+    }
+}
+
+/*
+ * capture_drain - Drain every capture pipe. Cheap when nothing is
+ *     pending: one failed read per pipe.
+ */
+void capture_drain(void)
+{
+    for (int i = 0; i < jobs_used; i++)
+        if (jobs[i].capfd >= 0)
+            drain(&jobs[i]);
+}
+
+/*
+ * capture_find - Find the slot holding the output of the finished job jid.
+ */
+struct job_t *capture_find(int jid)
+{
+    for (int i = 0; i < MAXJOBS; i++)
+        if (jobs[i].jid == 0 && jobs[i].ring && jobs[i].ring->jid == jid)
+            return &jobs[i];
+    return NULL;
+}
+
+/*
+ * capture_list - List finished jobs whose output is still kept.
+ */
+void capture_list(void)
+{
+    struct ring *r;
+
+    for (int i = 0; i < MAXJOBS; i++)
+    {
+        if (jobs[i].jid != 0 || (r = jobs[i].ring) == NULL)
+            continue;
+        printf("[%d] (%d) Done %s(%llu bytes of output)\n", r->jid, r->pid, r->cmdline, r->total);
+    }
+}
+
+/*
+ * capture_show - Print the last k bytes captured from job (all of the
+ *     ring if k is 0).
+ */
+void capture_show(struct job_t *job, size_t k)
+{
+    struct ring *r = job->ring;
+    size_t start;
+
+    if (job->capfd >= 0)
+        drain(job);
+    if (!r)
+    {
+        printf("%%%d: output not captured\n", job->jid);
+        return;
+    }
+
+    if (k == 0 || k > CAPTURE_RING)
+        k = CAPTURE_RING;
+    if (k > r->total)
+        k = r->total;
+    start = (r->head + CAPTURE_RING - k) % CAPTURE_RING;
+
+    fflush(stdout);
+    if (start + k <= CAPTURE_RING)
+        fwrite(r->data + start, 1, k, stdout);
+    else
+    {
+        fwrite(r->data + start, 1, CAPTURE_RING - start, stdout);
+        fwrite(r->data, 1, k - (CAPTURE_RING - start), stdout);
+    }
+    fflush(stdout);
+}
@@ -0,0 +1,158 @@
+/*
+ * zsh - A mini shell program
+ * NKU OS Course
+ * Shuhao Zhang
+ *
+ * file: coproc.c
+ *
+ * Coprocesses: `coproc [NAME] cmd ...` starts cmd as a background job
+ * whose stdin and stdout are pipes held by the shell, so a filter that is
+ * slow to start is started once and then fed many small requests:
+ *
+ *     coproc BC python3 -u calc.py
+ *     printf -u $BC_W '%s\n' 1+2
+ *     read -u $BC_R answer
+ *
+ * NAME (COPROC if left out) must be written in capitals, digits and '_',
+ * otherwise it is taken as the command. The shell exports NAME_R, the fd
+ * it reads the coprocess's output from, NAME_W, the fd it writes its
+ * input to, and NAME_PID. Both fds are close-on-exec: only the builtins
+ * read and printf use them, without forking. The job is in the job table
+ * like any background job (jobs, fg, kill %N); its fds are closed when a
+ * new coprocess of the same name is started.
+ */
+#include "main.h"
+
+#define MAXCOPROC    16         /* named coprocesses at once */
+#define MAXNAME      32
+
+extern struct job_t jobs[MAXJOBS];
+
+static struct coproc {
+    char name[MAXNAME];         /* "" for a free entry */
+    int rfd, wfd;               /* the shell's ends of the pipes */
+    pid_t pid;                  /* process group of the job */
+} coprocs[MAXCOPROC];
+
+/* is_name - Is s a coprocess name rather than a command? */
+static int is_name(const char *s)
+{
+    if (!*s || isdigit((unsigned char)*s) || strlen(s) >= MAXNAME)
+        return 0;
+    for (; *s; s++)
+        if (!isupper((unsigned char)*s) && !isdigit((unsigned char)*s) && *s != '_')
+            return 0;
+    return 1;
+}
+
+/* export - Set NAME_suffix to the number n */
+static void export(const char *name, const char *suffix, long n)
+{
+    char var[MAXNAME + 8], val[24];
+
+    snprintf(var, sizeof(var), "%s_%s", name, suffix);
+    snprintf(val, sizeof(val), "%ld", n);
+    setenv(var, val, 1);
+}
+
+/* forget - Close the fds of a coprocess and free its entry */
+static void forget(struct coproc *c)
+{
+    io_forget(c->rfd);
+    close(c->rfd);
+    close(c->wfd);
+    c->name[0] = '\0';
+}
+
+/*
+ * do_coproc - Execute coproc [NAME] cmd ...; the limit and timeout
+ *     prefixes may come before cmd. Takes over r, which may hold
+ *     here-documents of later pipeline stages.
+ */
+void do_coproc(char **argv, char *cmdline, struct redir *r)
+{
+    struct coproc *c, *slot = NULL;
+    struct spawn_attr attr;
+    const char *name = "COPROC";
+    char **args = argv + 1;
+    int in[2], out[2];
+    pid_t pid;
+
+    if (args[0] && args[1] && is_name(args[0]))
+        name = *args++;
+    if (args[0] == NULL)
+    {
+        printf("usage: coproc [NAME] command [args...]\n");
+        redir_close(r);
+        return;
+    }
+    if (r->in[0] >= 0)
+    {
+        printf("coproc: the input of %s is the shell's pipe\n", args[0]);
+        redir_close(r);
+        return;
+    }
+
+    /* a coprocess of that name: keep it while it runs */
+    for (c = coprocs; c < coprocs + MAXCOPROC; c++)
+    {
+        if (!slot && !c->name[0])
+            slot = c;
+        if (strcmp(c->name, name))
+            continue;
+        if (getjobpid(jobs, c->pid) != NULL)
+        {
+            printf("coproc: %s is still running (%d)\n", name, c->pid);
+            redir_close(r);
+            return;
+        }
+        forget(c);
+        slot = c;
+    }
+    if (!slot)
+    {
+        printf("coproc: too many coprocesses\n");
+        redir_close(r);
+        return;
+    }
+
+    if ((args = job_prefixes(args, &attr)) == NULL)
+    {
+        redir_close(r);
+        return;
+    }
+    if (pipe2(in, O_CLOEXEC) < 0)
+    {
+        printf("coproc: %s\n", strerror(errno));
+        redir_close(r);
+        return;
+    }
+    if (pipe2(out, O_CLOEXEC) < 0)
+    {
+        printf("coproc: %s\n", strerror(errno));
+        close(in[0]);
+        close(in[1]);
+        redir_close(r);
+        return;
+    }
+
+    /* the job reads in[0] and writes out[1], launch_job() closes both */
+    r->in[0] = in[0];
+    r->out = out[1];
+    if ((pid = launch_job(args, BG, cmdline, &attr, NULL, r)) == 0)
+    {
+        close(in[1]);
+        close(out[0]);
+        return;
+    }
+
+    snprintf(slot->name, sizeof(slot->name), "%s", name);
+    slot->rfd = out[0];
+    slot->wfd = in[1];
+    slot->pid = pid;
+    io_own(slot->rfd);
+    export(name, "R", slot->rfd);
+    export(name, "W", slot->wfd);
+    export(name, "PID", pid);
+    env_gen++;
+}
@@ -0,0 +1,373 @@
+/*
+ * zsh - A mini shell program
+ * NKU OS Course
+ * Shuhao Zhang
+ *
+ * file: dirs.c
+ *
+ * The working directory: cd, pwd and the directory stack (pushd, popd,
+ * dirs). The shell tracks its directory logically, the way it was
+ * reached (symlinks are not resolved, `..` drops the last component),
+ * in cur_dir. cd keeps cur_dir, $PWD and $OLDPWD up to date, so pwd, the
+ * prompt and spawn() just read cur_dir instead of calling getcwd(). Only
+ * `pwd -P` asks the kernel.
+ *
+ * $HOME is looked up again only after the environment changed (env_gen),
+ * and the password file only if $HOME is not set. A relative cd target
+ * is searched in $CDPATH first, like in sh.
+ */
+#include "main.h"
+#include <sys/stat.h>
+
+#define MAXDIRS  64             /* max entries of the directory stack */
+
+extern char cur_dir[MAXPATH];
+extern char prev_dir[MAXPATH];
+
+static char *stack[MAXDIRS];    /* stack[0] is the top, below cur_dir */
+static int nstack = 0;
+
+/* home_dir - Return $HOME, or the home directory in the password file */
+const char *home_dir(void)
+{
+    static char dir[MAXPATH];
+    static int gen = -1;
+    struct passwd *pw;
+    char *h;
+
+    if (gen == env_gen)
+        return dir;
+    gen = env_gen;
+    if ((h = getenv("HOME")) != NULL && *h)
+        snprintf(dir, sizeof(dir), "%s", h);
+    else if ((pw = getpwuid(getuid())) != NULL)
+        snprintf(dir, sizeof(dir), "%s", pw->pw_dir);
+    else
+        strcpy(dir, "/");
+    return dir;
+}
+
+/*
+ * logical - Resolve path against the logical directory base into out:
+ *     "." and empty components go, ".." drops the component before it.
+ *     Returns -1 if the result does not fit.
+ */
+static int logical(const char *base, const char *path, char *out)
+{
+    char buf[MAXPATH], *c, *next;
+    size_t len = 0, n;
+
+    if (path[0] != '/')
+        len = strlen(strcpy(out, base));
+    if (snprintf(buf, sizeof(buf), "%s", path) >= (int)sizeof(buf))
+        return -1;
+
+    for (c = buf; c; c = next)
+    {
+        if ((next = strchr(c, '/')) != NULL)
+            *next++ = '\0';
+        if (!*c || !strcmp(c, "."))
+            continue;
+        if (!strcmp(c, ".."))
+        {
+            while (len > 0 && out[--len] != '/')
+                ;
+            continue;
+        }
+        n = strlen(c);
+        if (len + n + 2 > MAXPATH)
+            return -1;
+        if (len == 0 || out[len - 1] != '/')
+            out[len++] = '/';
+        memcpy(out + len, c, n);
+        len += n;
+    }
+    if (len == 0)
+        out[len++] = '/';
+    out[len] = '\0';
+    return 0;
+}
+
+/* tilde - Expand a leading ~ of path into buf, return the result */
+static const char *tilde(const char *path, char *buf)
+{
+    if (path[0] != '~' || (path[1] && path[1] != '/'))
+        return path;
+    snprintf(buf, MAXPATH, "%s%s", home_dir(), path + 1);
+    return buf;
+}
+
+/* set_dir - Make dir, which the shell just changed to, the current one */
+static void set_dir(const char *dir)
+{
+    if (strcmp(cur_dir, dir))
+    {
+        strcpy(prev_dir, cur_dir);
+        strcpy(cur_dir, dir);
+    }
+    setenv("OLDPWD", prev_dir, 1);
+    setenv("PWD", cur_dir, 1);
+    env_gen++;
+}
+
+/*
+ * change_dir - Change to path, logically, trying $CDPATH for relative
+ *     paths. Returns 0, or -1 after printing an error. If verbose, or if
+ *     $CDPATH supplied the directory, the new directory is printed.
+ */
+static int change_dir(const char *path, int verbose)
+{
+    char dir[MAXPATH], buf[MAXPATH], try[MAXPATH];
+    const char *cdpath, *p, *end;
+    int err;
+
+    path = tilde(path, buf);
+
+    /* $CDPATH is not searched for ., .. and paths starting with them */
+    if (path[0] != '/' && strcmp(path, ".") && strcmp(path, "..")
+        && strncmp(path, "./", 2) && strncmp(path, "../", 3)
+        && (cdpath = getenv("CDPATH")) != NULL)
+    {
+        for (p = cdpath; ; p = end + 1)
+        {
+            if ((end = strchr(p, ':')) == NULL)
+                end = p + strlen(p);
+            /* an empty entry is the current directory */
+            if (snprintf(try, sizeof(try), "%.*s%s%s", (int)(end - p), p, end == p ? "" : "/", path)
+                < (int)sizeof(try) && logical(cur_dir, try, dir) == 0 && chdir(dir) == 0)
+            {
+                if (end != p || verbose)
+                    printf("%s\n", dir);
+                set_dir(dir);
+                return 0;
+            }
+            if (!*end)
+                break;
+        }
+    }
+
+    if (logical(cur_dir, path, dir) < 0)
+    {
+        printf("cd: %s: File name too long\n", path);
+        return -1;
+    }
+    if (chdir(dir) < 0)
+    {
+        /* the logical path may not exist physically, e.g. .. of a symlink */
+        err = errno;
+        if (chdir(path) < 0 || getcwd(dir, sizeof(dir)) == NULL)
+        {
+            printf("cd: %s: %s\n", path, strerror(err));
+            return -1;
+        }
+    }
+    if (verbose)
+        printf("%s\n", dir);
+    set_dir(dir);
+    return 0;
+}
+
+/*
+ * dirs_init - Find the directory the shell starts in: $PWD if it really
+ *     is the working directory, which keeps symlinks the parent shell
+ *     went through, else getcwd().
+ */
+void dirs_init(void)
+{
+    struct stat a, b;
+    char *pwd = getenv("PWD");
+
+    if (pwd && pwd[0] == '/' && strlen(pwd) < MAXPATH
+        && stat(pwd, &a) == 0 && stat(".", &b) == 0
+        && a.st_dev == b.st_dev && a.st_ino == b.st_ino)
+        strcpy(cur_dir, pwd);
+    else if (getcwd(cur_dir, MAXPATH) == NULL)
+        strcpy(cur_dir, "/");
+    strcpy(prev_dir, cur_dir);
+}
+
+/*
+ * pwd - Execute the builtin pwd command: pwd [-L|-P]
+ */
+void pwd(int argc, char **argv)
+{
+    char dir[MAXPATH];
+
+    if (argc > 1 && !strcmp(argv[1], "-P"))
+    {
+        if (getcwd(dir, sizeof(dir)) == NULL)
+            printf("pwd: %s\n", strerror(errno));
+        else
+            printf("%s\n", dir);
+        return;
+    }
+    printf("%s\n", cur_dir);
+}
+
+/*
+ * cd - Execute the builtin cd command: cd [dir | - | ~[/path]]
+ */
+void cd(int argc, char **argv)
+{
+    if (argc == 1)
+        change_dir(home_dir(), 0);
+    else if (!strcmp(argv[1], "-"))
+        change_dir(prev_dir, 1);
+    else
+        change_dir(argv[1], 0);
+}
+
+/* show - Print a directory, with $HOME shortened to ~ */
+static void show(const char *dir)
+{
+    const char *h = home_dir();
+    size_t n = strlen(h);
+
+    if (n > 1 && !strncmp(dir, h, n) && (dir[n] == '/' || dir[n] == '\0'))
+        printf("~%s", dir + n);
+    else
+        printf("%s", dir);
+}
+
+/*
+ * do_dirs - Execute the builtin dirs command: dirs [-c | -v]
+ */
+void do_dirs(int argc, char **argv)
+{
+    int verbose = argc > 1 && !strcmp(argv[1], "-v");
+
+    if (argc > 1 && !strcmp(argv[1], "-c"))
+    {
+        while (nstack > 0)
+            free(stack[--nstack]);
+        return;
+    }
+    for (int i = -1; i < nstack; i++)
+    {
+        if (verbose)
+            printf("%2d  ", i + 1);
+        show(i < 0 ? cur_dir : stack[i]);
+        printf(verbose || i == nstack - 1 ? "\n" : " ");
+    }
+}
+
+/* stack_index - Parse +N (counting cur_dir as 0) into 0..nstack, -1 if bad */
+static int stack_index(const char *arg)
+{
+    char *end;
+    long n;
+
+    if (arg[0] != '+')
+        return -1;
+    n = strtol(arg + 1, &end, 10);
+    if (end == arg + 1 || *end || n < 0 || n > nstack)
+        return -1;
+    return n;
+}
+
+/*
+ * do_pushd - Execute the builtin pushd command:
+ *     pushd dir    push cur_dir, change to dir
+ *     pushd        swap cur_dir and the top of the stack
+ *     pushd +N     rotate the stack so that entry N is cur_dir
+ */
+void do_pushd(int argc, char **argv)
+{
+    char *saved, *ring[MAXDIRS + 1];
+    int n, k;
+
+    if (argc > 1 && argv[1][0] == '+')
+    {
+        if ((k = stack_index(argv[1])) < 0)
+        {
+            printf("pushd: %s: directory stack index out of range\n", argv[1]);
+            return;
+        }
+        if (k == 0)
+        {
+            do_dirs(1, argv);
+            return;
+        }
+        /* ring[0] is cur_dir, rotate entry k to the front */
+        ring[0] = strdup(cur_dir);
+        for (int i = 0; i < nstack; i++)
+            ring[i + 1] = stack[i];
+        n = nstack + 1;
+        if (change_dir(ring[k], 0) < 0)
+        {
+            free(ring[0]);
+            return;
+        }
+        for (int i = 1; i < n; i++)
+            stack[i - 1] = ring[(k + i) % n];
+        free(ring[k]);
+        do_dirs(1, argv);
+        return;
+    }
+
+    if (argc == 1)
+    {
+        if (nstack == 0)
+        {
+            printf("pushd: no other directory\n");
+            return;
+        }
+        saved = strdup(cur_dir);
+        if (change_dir(stack[0], 0) < 0)
+        {
+            free(saved);
+            return;
+        }
+        free(stack[0]);
+        stack[0] = saved;
+        do_dirs(1, argv);
+        return;
+    }
+
+    if (nstack == MAXDIRS)
+    {
+        printf("pushd: directory stack full\n");
+        return;
+    }
+    saved = strdup(cur_dir);
+    if (change_dir(argv[1], 0) < 0)
+    {
+        free(saved);
+        return;
+    }
+    memmove(stack + 1, stack, nstack * sizeof(*stack));
+    stack[0] = saved;
+    nstack++;
+    do_dirs(1, argv);
+}
+
+/*
+ * do_popd - Execute the builtin popd command:
+ *     popd         change to the top of the stack and pop it
+ *     popd +N      drop entry N from the stack
+ */
+void do_popd(int argc, char **argv)
+{
+    int k = 0;
+
+    if (nstack == 0)
+    {
+        printf("popd: directory stack empty\n");
+        return;
+    }
+    if (argc > 1 && (k = stack_index(argv[1])) < 0)
+    {
+        printf("popd: %s: directory stack index out of range\n", argv[1]);
+        return;
+    }
+    if (k == 0)
+    {
+        if (change_dir(stack[0], 0) < 0)
+            return;
+        k = 1;
+    }
+    free(stack[k - 1]);
+    memmove(stack + k - 1, stack + k, (nstack - k) * sizeof(*stack));
+    nstack--;
+    do_dirs(1, argv);
+}
@@ -0,0 +1,539 @@
+/*
+ * zsh - A mini shell program
+ * NKU OS Course
+ * Shuhao Zhang
+ *
+ * file: edit.c
+ *
+ * The line editor of the interactive shell, with emacs keys:
+ *     C-a C-e C-b C-f M-b M-f   move (Home, End and the arrows, too)
+ *     C-d Backspace             delete a character; C-d on an empty line
+ *                               is the end of input
+ *     C-k C-u C-w M-d           kill to the end, the start, a word back
+ *                               or forward; C-y yanks it back
+ *     C-p C-n                   history (Up and Down, too)
+ *     C-l                       clear the screen; C-c drops the line
+ *
+ * The editor keeps a model of the screen: the text shown after the
+ * prompt and where the cursor is. Input is read in blocks and every key
+ * of a block is applied before the screen is brought up to date, once:
+ * only the text after the first byte that differs is written, with
+ * relative cursor moves, so a key costs a few bytes of output and a
+ * pasted 10k-character line is written once, not redrawn per key.
+ * Lines wrap at the terminal width; the model counts columns, UTF-8
+ * continuation bytes take none.
+ *
+ * The prompt may change while a line is edited, when a segment computed
+ * in the background comes in (see prompt.c): it is drawn again in place
+ * and the line after it, the cursor where it was.
+ */
+#include "main.h"
+#include <sys/ioctl.h>
+#include <termios.h>
+
+#define HISTMAX    1000         /* lines of history kept */
+#define EDITMAX    (MAXLINE - 2)    /* room for the newline and '\0' */
+
+/* keys that are escape sequences, after the bytes 0..255 */
+enum { K_LEFT = 256, K_RIGHT, K_UP, K_DOWN, K_HOME, K_END, K_DEL,
+       K_WLEFT, K_WRIGHT, K_WKILL, K_WRUBOUT, K_NONE };
+
+static char *hist[HISTMAX];     /* oldest first */
+static int nhist;
+
+static char in[4096];           /* input not processed yet */
+static size_t nin;
+
+static char out[16 * 1024];     /* output not written yet */
+static size_t nout;
+
+static char killed[MAXLINE];    /* what C-y yanks */
+
+static struct {                 /* what the terminal shows */
+    char text[MAXLINE];         /* after the prompt */
+    size_t len;
+    size_t cur;                 /* the cursor, an index into text */
+} shown;
+
+static char prompt_shown[2 * MAXPATH];
+static int pw;                  /* columns of the prompt */
+static int cols;                /* of the terminal */
+
+/* flush - Write the output buffer to the terminal */
+static void flush(void)
+{
+    size_t done;
+    ssize_t n;
+
+    for (done = 0; done < nout; done += n)
+        if ((n = write(STDOUT_FILENO, out + done, nout - done)) < 0)
+        {
+            if (errno == EINTR)
+            {
+                n = 0;
+                continue;
+            }
+            break;
+        }
+    nout = 0;
+}
+
+/* emit - Queue n bytes of output */
+static void emit(const char *s, size_t n)
+{
+    while (n > 0)
+    {
+        size_t k = n < sizeof(out) - nout ? n : sizeof(out) - nout;
+
+        memcpy(out + nout, s, k);
+        nout += k;
+        s += k;
+        n -= k;
+        if (nout == sizeof(out))
+            flush();
+    }
+}
+
+/* emitf - Queue a cursor movement */
+static void emitf(const char *fmt, int n)
+{
+    char buf[32];
+
+    emit(buf, snprintf(buf, sizeof(buf), fmt, n));
+}
+
+/* cont - Is c a UTF-8 continuation byte? */
+static int cont(char c)
+{
+    return (c & 0xC0) == 0x80;
+}
+
+/* width - Columns of the first n bytes of s */
+static int width(const char *s, size_t n)
+{
+    int w = 0;
+
+    for (size_t i = 0; i < n; i++)
+        w += !cont(s[i]);
+    return w;
+}
+
+/* prompt_width - Columns of the prompt, without its escape sequences */
+static int prompt_width(const char *p)
+{
+    int w = 0;
+
+    while (*p)
+    {
+        if (*p == '\033' && p[1] == '[')
+        {
+            for (p += 2; *p && !(*p >= 0x40 && *p <= 0x7e); p++)
+                ;
+            if (*p)
+                p++;
+            continue;
+        }
+        w += !cont(*p++);
+    }
+    return w;
+}
+
+/* move - Move the cursor from column from to column to, counted from the
+ * start of the prompt */
+static void move(int from, int to)
+{
+    int r1 = from / cols, c1 = from % cols, r2 = to / cols, c2 = to % cols;
+
+    if (r2 < r1)
+        emitf("\033[%dA", r1 - r2);
+    else if (r2 > r1)
+        emitf("\033[%dB", r2 - r1);
+    if (c2 < c1)
+        emitf("\033[%dD", c1 - c2);
+    else if (c2 > c1)
+        emitf("\033[%dC", c2 - c1);
+}
+
+/*
+ * refresh - Make the screen show the n bytes of text with the cursor at
+ *     cur, writing only what changed
+ */
+static void refresh(const char *text, size_t n, size_t cur)
+{
+    size_t p = 0;
+    int at = pw + width(shown.text, shown.cur);
+
+    while (p < n && p < shown.len && text[p] == shown.text[p])
+        p++;
+    while (p > 0 && p < n && cont(text[p]))
+        p--;
+
+    if (p < n || p < shown.len)
+    {
+        int end = pw + width(text, n);
+
+        move(at, pw + width(text, p));
+        emit(text + p, n - p);
+        /* the terminal waits in the last column after a full row; go to
+         * the next row, where the model has the cursor */
+        if (n > p && end % cols == 0)
+            emit("\r\n", 2);
+        if (n < shown.len)
+            emit("\033[J", 3);
+        memcpy(shown.text + p, text + p, n - p);
+        shown.len = n;
+        at = end;
+    }
+    move(at, pw + width(text, cur));
+    shown.cur = cur;
+}
+
+/* restart - Print the prompt on a fresh line, with nothing after it */
+static void restart(const char *prompt)
+{
+    snprintf(prompt_shown, sizeof(prompt_shown), "%s", prompt);
+    pw = prompt_width(prompt);
+    emit(prompt, strlen(prompt));
+    shown.len = shown.cur = 0;
+}
+
+/* the line being edited */
+static char *line;
+static size_t len, pos;
+
+/* repaint - Draw a new prompt over the old one, then the line again */
+static void repaint(const char *prompt)
+{
+    int at = pw + width(shown.text, shown.cur);
+
+    if (at / cols)
+        emitf("\033[%dA", at / cols);
+    emit("\r\033[J", 4);
+    restart(prompt);
+    refresh(line, len, pos);
+}
+
+/*
+ * next_key - Decode the key at the start of in[0..nin). Returns the
+ *     bytes it takes, 0 if an escape sequence is still incomplete.
+ */
+static size_t next_key(int *key)
+{
+    unsigned char *s = (unsigned char *)in;
+    size_t i;
+
+    *key = s[0];
+    if (s[0] != '\033')
+        return 1;
+    if (nin < 2)
+        return 0;
+    if (s[1] == '[' || s[1] == 'O')
+    {
+        /* CSI or SS3: parameters, then the final byte */
+        for (i = 2; i < nin && !(s[i] >= 0x40 && s[i] <= 0x7e); i++)
+            ;
+        if (i == nin)
+            return 0;
+        switch (s[i])
+        {
+        case 'A': *key = K_UP; break;
+        case 'B': *key = K_DOWN; break;
+        case 'C': *key = i > 2 && s[i - 1] == '5' ? K_WRIGHT : K_RIGHT; break;
+        case 'D': *key = i > 2 && s[i - 1] == '5' ? K_WLEFT : K_LEFT; break;
+        case 'H': *key = K_HOME; break;
+        case 'F': *key = K_END; break;
+        case '~':
+            switch (s[2])
+            {
+            case '1': case '7': *key = K_HOME; break;
+            case '4': case '8': *key = K_END; break;
+            case '3': *key = K_DEL; break;
+            default: *key = K_NONE;
+            }
+            break;
+        default:
+            *key = K_NONE;
+        }
+        return i + 1;
+    }
+    /* ESC as meta */
+    switch (s[1])
+    {
+    case 'b': *key = K_WLEFT; break;
+    case 'f': *key = K_WRIGHT; break;
+    case 'd': *key = K_WKILL; break;
+    case 0x7f: case 0x08: *key = K_WRUBOUT; break;
+    default: *key = K_NONE;
+    }
+    return 2;
+}
+
+/* word - Is c part of a word, for M-b, M-f and M-d? */
+static int word(char c)
+{
+    return isalnum((unsigned char)c) || cont(c) || (unsigned char)c >= 0x80;
+}
+
+/* erase - Remove line[from..to), into the kill buffer if kill */
+static void erase(size_t from, size_t to, int kill)
+{
+    if (from >= to)
+        return;
+    if (kill)
+    {
+        memcpy(killed, line + from, to - from);
+        killed[to - from] = '\0';
+    }
+    memmove(line + from, line + to, len - to);
+    len -= to - from;
+    if (pos > to)
+        pos -= to - from;
+    else if (pos > from)
+        pos = from;
+}
+
+/* insert - Insert n bytes at the cursor, as far as they fit */
+static void insert(const char *s, size_t n)
+{
+    if (n > EDITMAX - len)
+        n = EDITMAX - len;
+    memmove(line + pos + n, line + pos, len - pos);
+    memcpy(line + pos, s, n);
+    len += n;
+    pos += n;
+}
+
+/* set_line - Replace the line, for the history */
+static void set_line(const char *s)
+{
+    len = pos = strlen(s) < EDITMAX ? strlen(s) : EDITMAX;
+    memcpy(line, s, len);
+}
+
+/* prev_char/next_char - Index of the character before/after i */
+static size_t prev_char(size_t i)
+{
+    while (i > 0 && cont(line[--i]))
+        ;
+    return i;
+}
+
+static size_t next_char(size_t i)
+{
+    while (i < len && cont(line[++i]))
+        ;
+    return i;
+}
+
+/* word_left/word_right - Index of the start/end of the word at i */
+static size_t word_left(size_t i)
+{
+    while (i > 0 && !word(line[i - 1]))
+        i--;
+    while (i > 0 && word(line[i - 1]))
+        i--;
+    return i;
+}
+
+static size_t word_right(size_t i)
+{
+    while (i < len && !word(line[i]))
+        i++;
+    while (i < len && word(line[i]))
+        i++;
+    return i;
+}
+
+/* remember - Add a line to the history */
+static void remember(const char *s)
+{
+    if (!*s || (nhist && !strcmp(hist[nhist - 1], s)))
+        return;
+    if (nhist == HISTMAX)
+    {
+        free(hist[0]);
+        memmove(hist, hist + 1, (HISTMAX - 1) * sizeof(*hist));
+        nhist--;
+    }
+    if ((hist[nhist] = strdup(s)) != NULL)
+        nhist++;
+}
+
+/*
+ * edit_line - Read a line with the line editor, after printing the
+ *     prompt that prompt() returns; it is asked again whenever the editor
+ *     wakes up without input. Like fgets(), buf gets the line and its
+ *     newline. Returns the length, or -1 at the end of input.
+ */
+int edit_line(const char *(*prompt)(void), char *buf, int size)
+{
+    static char stash[MAXLINE];     /* the new line, while in the history */
+    struct termios saved, raw;
+    struct winsize ws;
+    int key, h = nhist, done = 0;
+    size_t k;
+    ssize_t n;
+
+    (void)size;                     /* buf holds MAXLINE bytes */
+    fflush(stdout);
+    if (tcgetattr(STDIN_FILENO, &saved) < 0)
+    {
+        printf("%s", prompt());
+        fflush(stdout);
+        return in_gets(buf, size) ? (int)strlen(buf) : -1;
+    }
+    raw = saved;
+    raw.c_iflag &= ~(ICRNL | INLCR | IXON);
+    raw.c_lflag &= ~(ICANON | ECHO | ISIG | IEXTEN);
+    raw.c_cc[VMIN] = 1;
+    raw.c_cc[VTIME] = 0;
+    tcsetattr(STDIN_FILENO, TCSADRAIN, &raw);
+
+    cols = ioctl(STDOUT_FILENO, TIOCGWINSZ, &ws) == 0 && ws.ws_col ? ws.ws_col : 80;
+    line = buf;
+    len = pos = 0;
+    restart(prompt());
+
+    while (!done)
+    {
+        if (nin == 0 || !next_key(&key))
+        {
+            flush();
+            if (!wait_input(STDIN_FILENO, -1))
+            {
+                if (strcmp(prompt(), prompt_shown))
+                    repaint(prompt());
+                continue;
+            }
+            if ((n = read(STDIN_FILENO, in + nin, sizeof(in) - nin)) < 0 && errno == EINTR)
+                continue;
+            if (n <= 0)
+            {
+                done = -1;
+                break;
+            }
+            nin += n;
+        }
+
+        /* every key that came in, then one screen update */
+        while (nin > 0 && !done && (k = next_key(&key)) > 0)
+        {
+            memmove(in, in + k, nin - k);
+            nin -= k;
+            switch (key)
+            {
+            case '\r': case '\n':
+                done = 1;
+                break;
+            case 0x01: case K_HOME:                 /* C-a */
+                pos = 0;
+                break;
+            case 0x05: case K_END:                  /* C-e */
+                pos = len;
+                break;
+            case 0x02: case K_LEFT:                 /* C-b */
+                pos = prev_char(pos);
+                break;
+            case 0x06: case K_RIGHT:                /* C-f */
+                pos = next_char(pos);
+                break;
+            case K_WLEFT:
+                pos = word_left(pos);
+                break;
+            case K_WRIGHT:
+                pos = word_right(pos);
+                break;
+            case 0x04:                              /* C-d */
+                if (len == 0)
+                {
+                    done = -1;
+                    break;
+                }
+                /* fall through */
+            case K_DEL:
+                erase(pos, next_char(pos), 0);
+                break;
+            case 0x7f: case 0x08:                   /* Backspace, C-h */
+                erase(prev_char(pos), pos, 0);
+                break;
+            case 0x0b:                              /* C-k */
+                erase(pos, len, 1);
+                break;
+            case 0x15:                              /* C-u */
+                erase(0, pos, 1);
+                break;
+            case 0x17:                              /* C-w */
+                for (k = pos; k > 0 && line[k - 1] == ' '; k--)
+                    ;
+                while (k > 0 && line[k - 1] != ' ')
+                    k--;
+                erase(k, pos, 1);
+                break;
+            case K_WKILL:
+                erase(pos, word_right(pos), 1);
+                break;
+            case K_WRUBOUT:
+                erase(word_left(pos), pos, 1);
+                break;
+            case 0x19:                              /* C-y */
+                insert(killed, strlen(killed));
+                break;
+            case 0x10: case K_UP:                   /* C-p */
+                if (h == 0)
+                    break;
+                if (h == nhist)
+                {
+                    memcpy(stash, line, len);
+                    stash[len] = '\0';
+                }
+                set_line(hist[--h]);
+                break;
+            case 0x0e: case K_DOWN:                 /* C-n */
+                if (h == nhist)
+                    break;
+                set_line(++h == nhist ? stash : hist[h]);
+                break;
+            case 0x0c:                              /* C-l */
+                emit("\033[H\033[2J", 7);
+                restart(prompt());
+                break;
+            case 0x03:                              /* C-c */
+                refresh(line, len, len);
+                emit("^C\r\n", 4);
+                restart(prompt());
+                len = pos = 0;
+                h = nhist;
+                break;
+            case '\t':
+                insert(" ", 1);
+                break;
+            default:
+                if (key >= 0x20 && key < 0x100)
+                {
+                    char c = key;
+
+                    /* a paste: the rest of the run of text at once */
+                    for (k = 0; k < nin && (unsigned char)in[k] >= 0x20 && in[k] != 0x7f; k++)
+                        ;
+                    insert(&c, 1);
+                    insert(in, k);
+                    memmove(in, in + k, nin - k);
+                    nin -= k;
+                }
+            }
+        }
+        refresh(line, len, done ? len : pos);
+    }
+
+    if (done > 0 || len > 0)
+        emit("\r\n", 2);
+    flush();
+    tcsetattr(STDIN_FILENO, TCSADRAIN, &saved);
+    if (done < 0)
+        return -1;
+    line[len] = '\0';
+    remember(line);
+    line[len++] = '\n';
+    line[len] = '\0';
+    return len;
+}
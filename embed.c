@@ -0,0 +1,545 @@
+/*
+ * zsh - A mini shell program
+ * NKU OS Course
+ * Shuhao Zhang
+ *
+ * file: embed.c
+ *
+ * The embedding API of libminishell, see minishell.h. Every snippet runs
+ * in a forked copy of the host, which becomes a shell: it takes the
+ * context's directory and environment, evaluates the snippet like a
+ * server script (see eval_script()) with stdout and stderr on two pipes,
+ * and at exit sends its directory and environment back on a third one.
+ * The host side never runs shell code; it only polls the pipes and a
+ * pidfd per snippet, so the shell's globals and signal handlers are only
+ * ever set up in the children.
+ */
+#include "main.h"
+#include "minishell.h"
+#include <poll.h>
+#include <sys/syscall.h>
+
+extern struct job_t jobs[MAXJOBS];
+extern char cur_dir[MAXPATH];
+
+/* One running snippet */
+struct run {
+    int id;
+    pid_t pid;                  /* the shell copy, leads its process group */
+    int pidfd;                  /* readable once it exited, -1 after */
+    int fd[3];                  /* stdout, stderr and state pipes, or -1 */
+    char *state;                /* what came in on the state pipe */
+    size_t nstate, capstate;
+    int status;                 /* once done: exit code or 128 + signal */
+    int done;
+    int collected;              /* status went to the done callback or msh_wait() */
+};
+
+struct msh {
+    struct msh_events ev;
+    void *arg;
+    char *cwd;
+    char **env;                 /* NULL-terminated, strings malloc'd */
+    struct run *runs;
+    int nruns, capruns;
+    int nextid;
+    int waiting, waited, wait_status;   /* for msh_wait() */
+};
+
+/* env_free - Free a NULL-terminated array of strings */
+static void env_free(char **env)
+{
+    for (char **e = env; e && *e; e++)
+        free(*e);
+    free(env);
+}
+
+/* env_copy - Copy a NULL-terminated array of strings */
+static char **env_copy(char **env)
+{
+    char **copy;
+    int n = 0;
+
+    while (env && env[n])
+        n++;
+    if ((copy = calloc(n + 1, sizeof(*copy))) == NULL)
+        return NULL;
+    for (int i = 0; i < n; i++)
+        if ((copy[i] = strdup(env[i])) == NULL)
+        {
+            env_free(copy);
+            return NULL;
+        }
+    return copy;
+}
+
+/* env_find - Index of name in m->env, or the index of its NULL end */
+static int env_find(struct msh *m, const char *name, int *found)
+{
+    size_t n = strlen(name);
+    int i;
+
+    for (i = 0; m->env[i]; i++)
+        if (!strncmp(m->env[i], name, n) && m->env[i][n] == '=')
+        {
+            *found = 1;
+            return i;
+        }
+    *found = 0;
+    return i;
+}
+
+struct msh *msh_new(const struct msh_events *ev, void *arg)
+{
+    char dir[MAXPATH];
+    struct msh *m;
+
+    if ((m = calloc(1, sizeof(*m))) == NULL)
+        return NULL;
+    if (ev)
+        m->ev = *ev;
+    m->arg = arg;
+    m->nextid = 1;
+    if (getcwd(dir, sizeof(dir)) == NULL || (m->cwd = strdup(dir)) == NULL
+        || (m->env = env_copy(environ)) == NULL)
+    {
+        msh_free(m);
+        return NULL;
+    }
+    return m;
+}
+
+void msh_free(struct msh *m)
+{
+    int status;
+
+    if (!m)
+        return;
+    for (int i = 0; i < m->nruns; i++)
+    {
+        struct run *r = &m->runs[i];
+
+        if (!r->done)
+        {
+            kill(-r->pid, SIGKILL);
+            waitpid(r->pid, &status, 0);
+        }
+        for (int k = 0; k < 3; k++)
+            if (r->fd[k] >= 0)
+                close(r->fd[k]);
+        if (r->pidfd >= 0)
+            close(r->pidfd);
+        free(r->state);
+    }
+    free(m->runs);
+    env_free(m->env);
+    free(m->cwd);
+    free(m);
+}
+
+const char *msh_cwd(struct msh *m)
+{
+    return m->cwd;
+}
+
+const char *msh_getenv(struct msh *m, const char *name)
+{
+    int found, i = env_find(m, name, &found);
+
+    return found ? strchr(m->env[i], '=') + 1 : NULL;
+}
+
+int msh_setenv(struct msh *m, const char *name, const char *value)
+{
+    int found, i = env_find(m, name, &found);
+    char **env, *s;
+
+    if (!value)
+    {
+        /* unset: move the rest down */
+        if (found)
+        {
+            free(m->env[i]);
+            do
+                m->env[i] = m->env[i + 1];
+            while (m->env[i++]);
+        }
+        return 0;
+    }
+    if ((s = malloc(strlen(name) + strlen(value) + 2)) == NULL)
+        return -1;
+    sprintf(s, "%s=%s", name, value);
+    if (found)
+    {
+        free(m->env[i]);
+        m->env[i] = s;
+        return 0;
+    }
+    if ((env = realloc(m->env, (i + 2) * sizeof(*env))) == NULL)
+    {
+        free(s);
+        return -1;
+    }
+    env[i] = s;
+    env[i + 1] = NULL;
+    m->env = env;
+    return 0;
+}
+
+/*
+ * Child side: the forked copy of the host becomes a shell
+ */
+
+static int state_fd = -1;
+
+/* send_state - Send cur_dir and the environment to the context, once */
+static void send_state(void)
+{
+    size_t len = strlen(cur_dir) + 1, n, done;
+    char *buf, *p;
+    ssize_t w;
+
+    if (state_fd < 0)
+        return;
+    for (char **e = environ; *e; e++)
+        len += strlen(*e) + 1;
+    if ((p = buf = malloc(len)) != NULL)
+    {
+        p = stpcpy(p, cur_dir) + 1;
+        for (char **e = environ; *e; e++)
+            p = stpcpy(p, *e) + 1;
+        for (n = len, done = 0; done < n; done += w)
+            if ((w = write(state_fd, buf + done, n - done)) <= 0)
+                break;
+        free(buf);
+    }
+    close(state_fd);
+    state_fd = -1;
+}
+
+/*
+ * child_exit - Leave the forked copy, after sending its state. Not
+ *     through exit(): the atexit() handlers and stdio buffers are the
+ *     host's.
+ */
+static void child_exit(int status)
+{
+    send_state();
+    fflush(stdout);
+    fflush(stderr);
+    _exit(status);
+}
+
+/* child_main - Run script in the forked copy, with the state of m */
+static void child_main(struct msh *m, char *script, int fd)
+{
+    sigset_t none;
+
+    /* the context's environment and directory, as the shell's own */
+    environ = m->env;
+    if (chdir(m->cwd) == 0)
+        setenv("PWD", m->cwd, 1);
+    env_gen++;
+
+    sigemptyset(&none);
+    sigprocmask(SIG_SETMASK, &none, NULL);
+    Signal(SIGINT, sigint_handler);
+    Signal(SIGTSTP, sigtstp_handler);
+    Signal(SIGCHLD, sigchld_handler);
+    Signal(SIGQUIT, sigquit_handler);
+    initjobs(jobs);
+    sched_forget();
+    dirs_init();
+
+    /* so does the exit builtin */
+    state_fd = fd;
+    exit_hook = child_exit;
+    child_exit(eval_script(script));
+}
+
+/*
+ * Host side
+ */
+
+int msh_run(struct msh *m, const char *script)
+{
+    int out[2], err[2], st[2], null;
+    struct run *r;
+    char *copy;
+    pid_t pid;
+
+    if (m->nruns == m->capruns)
+    {
+        int cap = m->capruns ? m->capruns * 2 : 16;
+
+        if ((r = realloc(m->runs, cap * sizeof(*r))) == NULL)
+            return -1;
+        m->runs = r;
+        m->capruns = cap;
+    }
+    if ((copy = strdup(script)) == NULL)
+        return -1;
+    if (pipe2(out, O_CLOEXEC) < 0)
+        goto fail_copy;
+    if (pipe2(err, O_CLOEXEC) < 0)
+        goto fail_out;
+    if (pipe2(st, O_CLOEXEC) < 0)
+        goto fail_err;
+
+    fflush(NULL);
+    if ((pid = fork()) < 0)
+        goto fail_st;
+    if (pid == 0)
+    {
+        setpgid(0, 0);
+        if ((null = open("/dev/null", O_RDONLY)) >= 0)
+            dup2(null, STDIN_FILENO);
+        dup2(out[1], STDOUT_FILENO);
+        dup2(err[1], STDERR_FILENO);
+        child_main(m, copy, st[1]);
+    }
+    /* in both processes, so kill(-pid) works at once */
+    setpgid(pid, pid);
+    free(copy);
+    close(out[1]);
+    close(err[1]);
+    close(st[1]);
+
+    r = &m->runs[m->nruns++];
+    memset(r, 0, sizeof(*r));
+    r->id = m->nextid++;
+    r->pid = pid;
+    r->fd[0] = out[0];
+    r->fd[1] = err[0];
+    r->fd[2] = st[0];
+    for (int k = 0; k < 3; k++)
+        fcntl(r->fd[k], F_SETFL, O_NONBLOCK);
+    r->pidfd = syscall(SYS_pidfd_open, pid, 0);
+    return r->id;
+
+fail_st:
+    close(st[0]);
+    close(st[1]);
+fail_err:
+    close(err[0]);
+    close(err[1]);
+fail_out:
+    close(out[0]);
+    close(out[1]);
+fail_copy:
+    free(copy);
+    return -1;
+}
+
+/* find - Look up a snippet by id; callbacks may move the runs array */
+static struct run *find(struct msh *m, int id)
+{
+    for (int i = 0; i < m->nruns; i++)
+        if (m->runs[i].id == id)
+            return &m->runs[i];
+    return NULL;
+}
+
+/* drain - Read what pipe k of snippet id holds, without blocking */
+static void drain(struct msh *m, int id, int k)
+{
+    char buf[64 * 1024];
+    struct run *r;
+    ssize_t n;
+
+    while ((r = find(m, id)) != NULL && r->fd[k] >= 0)
+    {
+        if ((n = read(r->fd[k], buf, sizeof(buf))) < 0 && errno == EINTR)
+            continue;
+        if (n < 0)
+            return;                 /* EAGAIN */
+        if (n == 0)
+        {
+            close(r->fd[k]);
+            r->fd[k] = -1;
+            return;
+        }
+        if (k == 2)
+        {
+            if (r->nstate + n > r->capstate)
+            {
+                size_t cap = r->capstate ? r->capstate * 2 : 4096;
+                char *p;
+
+                while (cap < r->nstate + n)
+                    cap *= 2;
+                if ((p = realloc(r->state, cap)) == NULL)
+                    return;
+                r->state = p;
+                r->capstate = cap;
+            }
+            memcpy(r->state + r->nstate, buf, n);
+            r->nstate += n;
+        }
+        else if (m->ev.output)
+            m->ev.output(m->arg, id, k + 1, buf, n);
+    }
+}
+
+/* adopt - Make the state a finished snippet sent the context's */
+static void adopt(struct msh *m, struct run *r)
+{
+    char **env, *p, *end = r->state + r->nstate;
+    int n = 0, i = 0;
+
+    if (r->nstate == 0 || end[-1] != '\0')
+        return;                     /* it died before sending it */
+    for (p = r->state; p < end; p += strlen(p) + 1)
+        n++;
+    if ((env = calloc(n, sizeof(*env))) == NULL)
+        return;
+    p = r->state + strlen(r->state) + 1;
+    for (; p < end; p += strlen(p) + 1)
+        if ((env[i++] = strdup(p)) == NULL)
+        {
+            env_free(env);
+            return;
+        }
+    if ((p = strdup(r->state)) == NULL)
+    {
+        env_free(env);
+        return;
+    }
+    free(m->cwd);
+    m->cwd = p;
+    env_free(m->env);
+    m->env = env;
+}
+
+/* reap - Finish snippet id if its shell exited */
+static void reap(struct msh *m, int id)
+{
+    struct run *r = find(m, id);
+    int status;
+
+    if (!r || r->done || waitpid(r->pid, &status, WNOHANG) <= 0)
+        return;
+    close(r->pidfd);
+    r->pidfd = -1;
+    r->done = 1;
+    r->status = WIFEXITED(status) ? WEXITSTATUS(status) : 128 + WTERMSIG(status);
+
+    /* what it wrote comes before it is done; jobs it left in the
+     * background may write more later */
+    drain(m, id, 0);
+    drain(m, id, 1);
+    drain(m, id, 2);
+    if ((r = find(m, id)) == NULL)
+        return;
+    adopt(m, r);
+    free(r->state);
+    r->state = NULL;
+    if (m->waiting == id)
+    {
+        m->waited = 1;
+        m->wait_status = r->status;
+    }
+    status = r->status;
+    if (m->ev.done)
+    {
+        r->collected = 1;
+        m->ev.done(m->arg, id, status);
+    }
+}
+
+int msh_poll(struct msh *m, int ms)
+{
+    struct pollfd *pfd;
+    int *who, n = 0, left = 0, i;
+
+    if ((pfd = malloc(m->nruns * 4 * (sizeof(*pfd) + 2 * sizeof(int)) + 1)) == NULL)
+        return -1;
+    who = (int *)(pfd + m->nruns * 4);
+    for (i = 0; i < m->nruns; i++)
+    {
+        struct run *r = &m->runs[i];
+
+        /* pipes first: output is delivered before the snippet is done */
+        for (int k = 0; k < 3; k++)
+            if (r->fd[k] >= 0)
+            {
+                pfd[n].fd = r->fd[k];
+                pfd[n].events = POLLIN;
+                who[2 * n] = r->id;
+                who[2 * n++ + 1] = k;
+            }
+        if (r->pidfd >= 0)
+        {
+            pfd[n].fd = r->pidfd;
+            pfd[n].events = POLLIN;
+            who[2 * n] = r->id;
+            who[2 * n++ + 1] = 3;
+        }
+        /* no pidfd (old kernel): check on every poll */
+        else if (!r->done)
+            ms = ms < 0 || ms > 10 ? 10 : ms;
+    }
+
+    /* nothing to wait for: do not sleep forever */
+    if ((n > 0 || ms >= 0) && poll(pfd, n, ms) > 0)
+        for (i = 0; i < n; i++)
+        {
+            if (!pfd[i].revents)
+                continue;
+            if (who[2 * i + 1] < 3)
+                drain(m, who[2 * i], who[2 * i + 1]);
+            else
+                reap(m, who[2 * i]);
+        }
+    free(pfd);
+
+    /* forget snippets that are done, whose status was collected and
+     * whose pipes are closed */
+    for (i = 0; i < m->nruns; i++)
+    {
+        struct run *r = &m->runs[i];
+
+        if (r->pidfd < 0 && !r->done)
+            reap(m, r->id);
+        if (r->done && r->collected && r->fd[0] < 0 && r->fd[1] < 0)
+        {
+            if (r->fd[2] >= 0)
+                close(r->fd[2]);
+            m->runs[i--] = m->runs[--m->nruns];
+        }
+        else if (!r->done)
+            left++;
+    }
+    return left;
+}
+
+int msh_wait(struct msh *m, int id)
+{
+    struct run *r = find(m, id);
+
+    if (!r)
+        return -1;
+    m->waiting = id;
+    m->waited = r->done;
+    m->wait_status = r->status;
+    while (!m->waited)
+        if (msh_poll(m, -1) < 0)
+            return -1;
+    m->waiting = 0;
+    /* it is forgotten by the next msh_poll() once its pipes are closed */
+    if ((r = find(m, id)) != NULL)
+        r->collected = 1;
+    return m->wait_status;
+}
+
+int msh_kill(struct msh *m, int id, int sig)
+{
+    struct run *r = find(m, id);
+
+    if (!r || r->done)
+    {
+        errno = ESRCH;
+        return -1;
+    }
+    return kill(-r->pid, sig);
+}
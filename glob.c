@@ -0,0 +1,445 @@
+/*
+ * zsh - A mini shell program
+ * NKU OS Course
+ * Shuhao Zhang
+ *
+ * file: glob.c
+ *
+ * Pathname expansion of *, ?, [...] and ** in the words of a command
+ * line. A word that matches nothing stays as it is, like in sh; quoted
+ * words are never expanded. The matches of each word are sorted.
+ *
+ * Each pattern is compiled once, one matcher per path component, and
+ * then run over directory listings read with getdents64(2). Listings are
+ * cached for the rest of the command line, so two patterns in src, as
+ * in `ls src/[ab]*.c src/[ab]*.h`, read src once. A ** component matches
+ * any number of directories; the tree under it is walked depth first,
+ * each directory listed once and freed as soon as the walk leaves it, so
+ * memory stays bounded by the depth of the tree. The expanded words go
+ * into an argv that grows as needed, so there is no limit on how many
+ * a command line expands to.
+ */
+#include "main.h"
+#include <dirent.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+
+#define GLOB_CACHE   64         /* directories cached per command line */
+
+/* One compiled path component */
+struct tok {
+    char kind;                  /* 'c' a char, '?', '*', '[' a set */
+    unsigned char c;
+    unsigned char set[32];      /* bit per byte for '[' */
+};
+struct seg {
+    int ntok;
+    int meta;                   /* 0: a literal name, 2: ** */
+    int dot;                    /* may match names starting with '.' */
+    char *name;                 /* the component as written */
+    struct tok *tok;
+};
+
+/* The entries of a directory: a type byte, the name, '\0', and so on */
+struct dirlist {
+    int n;
+    size_t len;
+    char *buf;
+};
+
+static struct {
+    char *path;
+    struct dirlist *list;
+} cache[GLOB_CACHE];
+static int ncache = 0;
+
+/* A growing vector of words */
+struct vec {
+    char **v;
+    int n, max;
+};
+
+static struct vec out;          /* the argv being built */
+static struct vec owned;        /* matches handed out, freed with the next command line */
+
+/* compile - Compile one path component; unmatched '[' is a plain char */
+static void compile(struct seg *s, char *name)
+{
+    unsigned char *p = (unsigned char *)name, lo, hi;
+    struct tok *t;
+    int neg;
+
+    s->name = name;
+    s->tok = malloc((strlen(name) + 1) * sizeof(*s->tok));
+    s->ntok = 0;
+    s->meta = 0;
+    s->dot = name[0] == '.';
+    if (!s->tok)
+        app_error("glob: out of memory");
+
+    while (*p)
+    {
+        t = &s->tok[s->ntok++];
+        t->kind = 'c';
+        if (*p == '*' || *p == '?')
+        {
+            t->kind = *p++;
+            s->meta |= 1;
+            /* a run of stars is one star */
+            while (t->kind == '*' && *p == '*')
+                p++;
+            continue;
+        }
+        if (*p == '[' && p[1] && strchr((char *)p + 2, ']'))
+        {
+            unsigned char *q = p + 1;
+
+            memset(t->set, 0, sizeof(t->set));
+            if ((neg = (*q == '!' || *q == '^')) != 0)
+                q++;
+            /* a ']' right after the '[' is part of the set */
+            do
+            {
+                lo = hi = *q++;
+                if (*q == '-' && q[1] && q[1] != ']')
+                {
+                    hi = q[1];
+                    q += 2;
+                }
+                for (int c = lo; c <= hi; c++)
+                    t->set[c / 8] |= 1 << (c % 8);
+            } while (*q && *q != ']');
+            if (*q == ']')
+            {
+                if (neg)
+                    for (int i = 0; i < 32; i++)
+                        t->set[i] = ~t->set[i];
+                t->kind = '[';
+                s->meta |= 1;
+                p = q + 1;
+                continue;
+            }
+        }
+        if (*p == '\\' && p[1])
+            p++;
+        t->c = *p++;
+    }
+    if (!strcmp(name, "**"))
+        s->meta = 2;
+}
+
+/* match - Does name match the compiled component s? */
+static int match(const struct seg *s, const char *name)
+{
+    const unsigned char *n = (const unsigned char *)name, *star_n = NULL;
+    int i = 0, star_i = -1;
+
+    if (name[0] == '.' && !s->dot)
+        return 0;
+    while (*n)
+    {
+        if (i < s->ntok && s->tok[i].kind == '*')
+        {
+            star_i = i++;
+            star_n = n;
+            continue;
+        }
+        if (i < s->ntok && (s->tok[i].kind == '?'
+                            || (s->tok[i].kind == 'c' && s->tok[i].c == *n)
+                            || (s->tok[i].kind == '[' && (s->tok[i].set[*n / 8] & (1 << (*n % 8))))))
+        {
+            i++;
+            n++;
+            continue;
+        }
+        /* let the last star eat one more char */
+        if (star_i < 0)
+            return 0;
+        i = star_i + 1;
+        n = ++star_n;
+    }
+    while (i < s->ntok && s->tok[i].kind == '*')
+        i++;
+    return i == s->ntok;
+}
+
+/* join - Return prefix/name in a new string */
+static char *join(const char *prefix, const char *name)
+{
+    size_t lp = strlen(prefix), ln = strlen(name);
+    char *p = malloc(lp + ln + 2);
+
+    if (!p)
+        app_error("glob: out of memory");
+    memcpy(p, prefix, lp);
+    if (lp && prefix[lp - 1] != '/')
+        p[lp++] = '/';
+    memcpy(p + lp, name, ln + 1);
+    return p;
+}
+
+/* readdir_list - List directory path with getdents64, NULL if it can't */
+static struct dirlist *readdir_list(const char *path)
+{
+    static char dbuf[32 * 1024];
+    struct dirlist *l;
+    size_t cap = 4096, ln;
+    long n, off;
+    int fd;
+
+    if ((fd = open(*path ? path : ".", O_RDONLY | O_DIRECTORY | O_CLOEXEC)) < 0)
+        return NULL;
+    if ((l = malloc(sizeof(*l))) == NULL || (l->buf = malloc(cap)) == NULL)
+        app_error("glob: out of memory");
+    l->n = 0;
+    l->len = 0;
+
+    while ((n = syscall(SYS_getdents64, fd, dbuf, sizeof(dbuf))) > 0)
+    {
+        for (off = 0; off < n; )
+        {
+            struct dirent64 *d = (struct dirent64 *)(dbuf + off);
+
+            off += d->d_reclen;
+            if (!strcmp(d->d_name, ".") || !strcmp(d->d_name, ".."))
+                continue;
+            ln = strlen(d->d_name);
+            if (l->len + ln + 2 > cap)
+            {
+                while (l->len + ln + 2 > cap)
+                    cap *= 2;
+                if ((l->buf = realloc(l->buf, cap)) == NULL)
+                    app_error("glob: out of memory");
+            }
+            l->buf[l->len++] = d->d_type;
+            memcpy(l->buf + l->len, d->d_name, ln + 1);
+            l->len += ln + 1;
+            l->n++;
+        }
+    }
+    close(fd);
+    return l;
+}
+
+static void dirlist_free(struct dirlist *l)
+{
+    if (l)
+        free(l->buf);
+    free(l);
+}
+
+/* cached_list - List directory path, reading it only once per command
+ * line. *tmp is set if the cache is full and the caller frees the list. */
+static struct dirlist *cached_list(const char *path, int *tmp)
+{
+    struct dirlist *l;
+
+    *tmp = 0;
+    for (int i = 0; i < ncache; i++)
+        if (!strcmp(cache[i].path, path))
+            return cache[i].list;
+    l = readdir_list(path);
+    if (ncache < GLOB_CACHE && (cache[ncache].path = strdup(path)) != NULL)
+        cache[ncache++].list = l;
+    else
+        *tmp = 1;
+    return l;
+}
+
+/* is_dir - Is entry name of dir, of the given d_type, a directory? */
+static int is_dir(const char *path, int type, int follow)
+{
+    struct stat st;
+
+    if (type == DT_DIR)
+        return 1;
+    if (type != DT_UNKNOWN && (type != DT_LNK || !follow))
+        return 0;
+    if ((follow ? stat(path, &st) : lstat(path, &st)) < 0)
+        return 0;
+    return S_ISDIR(st.st_mode);
+}
+
+/* push - Append word to vec */
+static void push(struct vec *vec, char *word)
+{
+    if (vec->n == vec->max)
+    {
+        vec->max = vec->max ? 2 * vec->max : 256;
+        if ((vec->v = realloc(vec->v, vec->max * sizeof(char *))) == NULL)
+            app_error("glob: out of memory");
+    }
+    vec->v[vec->n++] = word;
+}
+
+/* add - Record a match */
+static int add(char *path)
+{
+    if (!path)
+        app_error("glob: out of memory");
+    push(&out, path);
+    return 0;
+}
+
+static int expand(const char *prefix, struct seg *s, int nseg, struct dirlist *have);
+
+/*
+ * walk - Match s[0] == ** at prefix: the rest of the pattern is matched
+ *     in prefix and in every directory below it (not following symlinks
+ *     or entering hidden directories). prefix is listed once, for both.
+ */
+static int walk(const char *prefix, struct seg *s, int nseg)
+{
+    struct dirlist *l = readdir_list(prefix);
+    char *p, *path;
+    int r = 0;
+
+    if (!l)
+        return 0;
+    if (nseg > 1 && (r = expand(prefix, s + 1, nseg - 1, l)) < 0)
+        goto out;
+
+    for (p = l->buf; p < l->buf + l->len; p += strlen(p + 1) + 2)
+    {
+        if (p[1] == '.')
+            continue;
+        path = join(prefix, p + 1);
+        /* a trailing ** matches everything below prefix */
+        if (nseg == 1 && (r = add(strdup(path))) < 0)
+        {
+            free(path);
+            break;
+        }
+        if (is_dir(path, (unsigned char)p[0], 0))
+            r = walk(path, s, nseg);
+        free(path);
+        if (r < 0)
+            break;
+    }
+out:
+    dirlist_free(l);
+    return r;
+}
+
+/*
+ * expand - Match the components s[0..nseg) below prefix ("" for the
+ *     current directory). have, if not NULL, is the listing of prefix.
+ */
+static int expand(const char *prefix, struct seg *s, int nseg, struct dirlist *have)
+{
+    struct dirlist *l;
+    struct stat st;
+    char *p, *path;
+    int r = 0, tmp = 0;
+
+    if (nseg == 0)
+        return add(strdup(prefix));
+    if (s->meta == 2)
+        return walk(prefix, s, nseg);
+
+    if (!s->meta)
+    {
+        /* a literal component: only the last one has to exist */
+        path = join(prefix, s->name);
+        if (nseg > 1 || lstat(path, &st) == 0)
+            r = expand(path, s + 1, nseg - 1, NULL);
+        free(path);
+        return r;
+    }
+
+    if ((l = have ? have : cached_list(prefix, &tmp)) == NULL)
+        return 0;
+    for (p = l->buf; p < l->buf + l->len && r == 0; p += strlen(p + 1) + 2)
+    {
+        if (!match(s, p + 1))
+            continue;
+        path = join(prefix, p + 1);
+        if (nseg == 1)
+        {
+            r = add(path);
+            continue;
+        }
+        if (is_dir(path, (unsigned char)p[0], 1))
+            r = expand(path, s + 1, nseg - 1, NULL);
+        free(path);
+    }
+    if (tmp)
+        dirlist_free(l);
+    return r;
+}
+
+static int cmp(const void *a, const void *b)
+{
+    return strcmp(*(char *const *)a, *(char *const *)b);
+}
+
+/*
+ * glob_word - Expand one word, adding its matches to the argv being
+ *     built, sorted. Returns their number, 0 if the word has no pattern
+ *     or nothing matches.
+ */
+static int glob_word(const char *word)
+{
+    struct seg segs[MAXLINE / 2];
+    char copy[MAXLINE], *c, *next;
+    int nseg = 0, meta = 0, start = out.n;
+
+    strcpy(copy, word);
+    for (c = copy + (copy[0] == '/'); c && *c; c = next)
+    {
+        if ((next = strchr(c, '/')) != NULL)
+            *next++ = '\0';
+        if (*c)
+        {
+            compile(&segs[nseg], c);
+            meta |= segs[nseg++].meta;
+        }
+    }
+
+    if (meta)
+        expand(copy[0] == '/' ? "/" : "", segs, nseg, NULL);
+    for (int i = 0; i < nseg; i++)
+        free(segs[i].tok);
+    qsort(out.v + start, out.n - start, sizeof(char *), cmp);
+    return out.n - start;
+}
+
+/*
+ * glob_argv - Expand the words of argv. quoted[i] tells that argv[i] was
+ *     quoted. Returns the expanded words as an argv from malloc(), which
+ *     the caller frees; the matches in it stay until the next call.
+ */
+char **glob_argv(char **argv, const char *quoted)
+{
+    char **words;
+    int i, n;
+
+    /* the words of the previous command line are no longer used */
+    for (i = 0; i < owned.n; i++)
+        free(owned.v[i]);
+    owned.n = 0;
+
+    for (i = 0; argv[i]; i++)
+    {
+        /* the word after << is a here-document delimiter */
+        n = 0;
+        if (!quoted[i] && strpbrk(argv[i], "*?[")
+            && !(i > 0 && (!strcmp(argv[i - 1], "<<") || !strcmp(argv[i - 1], "<<<"))))
+            n = glob_word(argv[i]);
+        if (n == 0)
+            push(&out, argv[i]);
+        for (int k = out.n - n; k < out.n; k++)
+            push(&owned, out.v[k]);
+    }
+    push(&out, NULL);
+    words = out.v;
+    memset(&out, 0, sizeof(out));
+
+    for (i = 0; i < ncache; i++)
+    {
+        free(cache[i].path);
+        dirlist_free(cache[i].list);
+    }
+    ncache = 0;
+    return words;
+}
@@ -0,0 +1,91 @@
+/*
+ * zsh - A mini shell program
+ * NKU OS Course
+ * Shuhao Zhang
+ *
+ * file: input.c
+ *
+ * The shell's own stdin. Command lines and here-documents are read with
+ * in_gets(), which reads ahead in blocks like stdio, but into a buffer
+ * of the shell's: the main loop can tell whether the next line is
+ * already there (in_buffered()) before it waits for input. Builtins
+ * that read stdin themselves, like xargs, start with what is read ahead
+ * (in_take()). Commands the shell starts do not see what it read ahead,
+ * as with stdio.
+ */
+#include "main.h"
+
+#define INSIZE  4096
+
+static struct {
+    size_t off, n;              /* data[off..n) is not read yet */
+    char data[INSIZE];
+} in;
+
+/* in_buffered - How many bytes of stdin are read ahead */
+size_t in_buffered(void)
+{
+    return in.n - in.off;
+}
+
+/*
+ * in_take - Take up to size bytes of what is read ahead into buf.
+ *     Returns how many, 0 if nothing is.
+ */
+size_t in_take(char *buf, size_t size)
+{
+    size_t k = in.n - in.off;
+
+    if (k > size)
+        k = size;
+    memcpy(buf, in.data + in.off, k);
+    in.off += k;
+    return k;
+}
+
+/*
+ * fill - Read the next block of stdin, servicing the shell's events
+ *     while it waits. Returns 0 at the end of input or on an error.
+ */
+static int fill(void)
+{
+    ssize_t got;
+
+    in.off = in.n = 0;
+    while (1)
+    {
+        if (!wait_input(STDIN_FILENO, -1))
+            continue;
+        if ((got = read(STDIN_FILENO, in.data, INSIZE)) >= 0
+            || (errno != EINTR && errno != EAGAIN))
+            break;
+    }
+    if (got > 0)
+        in.n = got;
+    return got > 0;
+}
+
+/*
+ * in_gets - Read a line of stdin, like fgets(): buf gets the line and
+ *     its newline. Returns NULL at the end of input with nothing read.
+ */
+char *in_gets(char *buf, int size)
+{
+    char *nl = NULL;
+    size_t k;
+    int len = 0;
+
+    while (!nl && len < size - 1 && (in.off < in.n || fill()))
+    {
+        k = in.n - in.off;
+        if (k > (size_t)(size - 1 - len))
+            k = size - 1 - len;
+        if ((nl = memchr(in.data + in.off, '\n', k)) != NULL)
+            k = nl - (in.data + in.off) + 1;
+        memcpy(buf + len, in.data + in.off, k);
+        in.off += k;
+        len += k;
+    }
+    buf[len] = '\0';
+    return len > 0 ? buf : NULL;
+}
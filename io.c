@@ -0,0 +1,613 @@
+/*
+ * zsh - A mini shell program
+ * NKU OS Course
+ * Shuhao Zhang
+ *
+ * file: io.c
+ *
+ * The builtins read, mapfile and printf, which talk to files and
+ * coprocesses without forking:
+ *     read [-r] [-u fd] [name ...]     read a line, split it into the
+ *                                      variables (REPLY if none given)
+ *     mapfile [-t] [-n count] [-u fd] [name]
+ *                                      read the lines into an array
+ *                                      (MAPFILE if none given), readarray
+ *                                      is the same
+ *     printf [-u fd] format [arg ...]  %s %c %d %i %u %o %x %X %%, with
+ *                                      flags and width; \n \t \r \\ \a \e
+ * read and mapfile take their input from `< file` and here-documents,
+ * too.
+ *
+ * Shells read one byte at a time so that read never takes more than the
+ * line from a fd it shares with other processes. This shell reads ahead
+ * in blocks where that cannot hurt:
+ *     - the fds it owns alone, like the output pipe of a coprocess (see
+ *       coproc.c), whatever they are;
+ *     - regular files: io_sync() seeks back over what was read ahead
+ *       before the shell starts a command that could read the file, and
+ *       the buffer goes when redir_close() closes the file.
+ * Other fds, like a pipe the shell shares with its jobs, are still read
+ * a byte at a time. stdin is read through the shell's own buffer
+ * (input.c), so a script can read the lines that follow it.
+ */
+#include "main.h"
+#include <stdarg.h>
+#include <sys/stat.h>
+
+#define MAXOWNED   256          /* fds below this can have a buffer */
+#define BUFSIZE   (64 * 1024)
+
+/* Read-ahead of a fd */
+struct rbuf {
+    int file;                   /* a regular file, not an owned fd */
+    size_t off, n;              /* data[off..n) is not read yet */
+    char data[BUFSIZE];
+};
+
+static struct rbuf *bufs[MAXOWNED];
+static int nfiles;              /* buffers of regular files */
+
+/*
+ * io_own - fd is read by the shell alone: read it ahead
+ */
+void io_own(int fd)
+{
+    if (fd >= 0 && fd < MAXOWNED && !bufs[fd])
+        bufs[fd] = calloc(1, sizeof(struct rbuf));
+}
+
+/*
+ * io_forget - fd is about to be closed: drop what was read ahead
+ */
+void io_forget(int fd)
+{
+    if (fd >= 0 && fd < MAXOWNED && bufs[fd])
+    {
+        nfiles -= bufs[fd]->file;
+        free(bufs[fd]);
+        bufs[fd] = NULL;
+    }
+}
+
+/*
+ * io_sync - A command is about to start: give the files read ahead their
+ *     offsets back, so it reads on where read stopped
+ */
+void io_sync(void)
+{
+    for (int fd = 0; nfiles > 0 && fd < MAXOWNED; fd++)
+        if (bufs[fd] && bufs[fd]->file)
+        {
+            lseek(fd, -(off_t)(bufs[fd]->n - bufs[fd]->off), SEEK_CUR);
+            io_forget(fd);
+        }
+}
+
+/* buffer - The read-ahead of fd, made for a regular file, or NULL */
+static struct rbuf *buffer(int fd)
+{
+    struct stat st;
+
+    if (fd < 0 || fd >= MAXOWNED)
+        return NULL;
+    if (!bufs[fd] && fstat(fd, &st) == 0 && S_ISREG(st.st_mode)
+        && (bufs[fd] = calloc(1, sizeof(struct rbuf))) != NULL)
+    {
+        bufs[fd]->file = 1;
+        nfiles++;
+    }
+    return bufs[fd];
+}
+
+/* fill - Read more of fd into buf, waiting with the shell's events serviced */
+static ssize_t fill(int fd, char *buf, size_t size, int file)
+{
+    ssize_t n;
+
+    while (1)
+    {
+        if (!file)
+            wait_input(fd, -1);
+        if ((n = read(fd, buf, size)) >= 0 || (errno != EINTR && errno != EAGAIN))
+            return n;
+    }
+}
+
+/*
+ * read_line - Read a line from fd into buf, without its newline. Returns
+ *     its length, or -1 at the end of input with nothing read.
+ */
+static int read_line(int fd, char *buf, int size)
+{
+    struct rbuf *b = buffer(fd);
+    int len = 0;
+    ssize_t n;
+    char *nl;
+
+    if (fd == STDIN_FILENO)
+    {
+        if (in_gets(buf, size) == NULL)
+            return -1;
+        len = strlen(buf);
+        if (len > 0 && buf[len - 1] == '\n')
+            buf[--len] = '\0';
+        return len;
+    }
+
+    while (len < size - 1)
+    {
+        if (!b)
+        {
+            /* shared: not a byte past the newline */
+            if ((n = fill(fd, buf + len, 1, 0)) <= 0)
+                break;
+            if (buf[len] == '\n')
+            {
+                buf[len] = '\0';
+                return len;
+            }
+            len++;
+            continue;
+        }
+        if (b->off == b->n)
+        {
+            b->off = 0;
+            if ((n = fill(fd, b->data, BUFSIZE, b->file)) <= 0)
+            {
+                b->n = 0;
+                break;
+            }
+            b->n = n;
+        }
+        n = b->n - b->off;
+        if (n > size - 1 - len)
+            n = size - 1 - len;
+        if ((nl = memchr(b->data + b->off, '\n', n)) != NULL)
+        {
+            n = nl - (b->data + b->off);
+            memcpy(buf + len, b->data + b->off, n);
+            b->off += n + 1;
+            buf[len + n] = '\0';
+            return len + n;
+        }
+        memcpy(buf + len, b->data + b->off, n);
+        b->off += n;
+        len += n;
+    }
+    buf[len] = '\0';
+    return len > 0 ? len : -1;
+}
+
+/* get_fd - Parse the fd of -u, -1 after printing an error */
+static int get_fd(const char *cmd, const char *s)
+{
+    char *end;
+    long fd;
+
+    if (s == NULL)
+    {
+        printf("%s: -u: option requires an argument\n", cmd);
+        return -1;
+    }
+    fd = strtol(s, &end, 10);
+    if (*end || end == s || fd < 0 || fcntl(fd, F_GETFD) < 0)
+    {
+        printf("%s: %s: invalid file descriptor\n", cmd, s);
+        return -1;
+    }
+    return fd;
+}
+
+/*
+ * do_read - Execute the builtin read. Its status is 1 at the end of
+ *     input.
+ */
+void do_read(int argc, char **argv)
+{
+    char line[MAXLINE], *p, *end;
+    int i, fd = builtin_in >= 0 ? builtin_in : STDIN_FILENO, raw = 0, len;
+
+    for (i = 1; i < argc && argv[i][0] == '-' && argv[i][1]; i++)
+    {
+        if (!strcmp(argv[i], "-r"))
+            raw = 1;
+        else if (!strcmp(argv[i], "-u"))
+        {
+            if ((fd = get_fd("read", argv[++i])) < 0)
+            {
+                builtin_status = 2;
+                return;
+            }
+        }
+        else
+        {
+            printf("usage: read [-r] [-u fd] [name ...]\n");
+            builtin_status = 2;
+            return;
+        }
+    }
+
+    if ((len = read_line(fd, line, sizeof(line))) < 0)
+    {
+        builtin_status = 1;
+        line[0] = '\0';
+    }
+    /* without -r: a backslash quotes the next character, and one at the
+     * end of the line joins the next line */
+    for (int r = 0, w = 0; !raw && len >= 0; r++)
+    {
+        if (line[r] == '\\' && line[r + 1])
+            line[w++] = line[++r];
+        else if (line[r] == '\\')
+        {
+            if (read_line(fd, line + r, sizeof(line) - r) < 0)
+                line[r] = '\0';
+            r--;
+        }
+        else if ((line[w++] = line[r]) == '\0')
+            break;
+    }
+
+    if (i == argc)
+    {
+        setenv("REPLY", line, 1);
+        env_gen++;
+        return;
+    }
+    /* a word per name, the rest of the line for the last one */
+    for (p = line; i < argc; i++)
+    {
+        p += strspn(p, " \t");
+        if (i == argc - 1)
+        {
+            for (end = p + strlen(p); end > p && (end[-1] == ' ' || end[-1] == '\t'); end--)
+                ;
+            *end = '\0';
+        }
+        else if (*(end = p + strcspn(p, " \t")))
+            *end++ = '\0';
+        setenv(argv[i], p, 1);
+        p = end;
+    }
+    env_gen++;
+}
+
+/* slurp - The rest of fd in a block from malloc(), *len bytes of it */
+static char *slurp(int fd, size_t *len)
+{
+    struct rbuf *b = fd == STDIN_FILENO ? NULL : buffer(fd);
+    size_t cap = 64 * 1024, n = 0;
+    struct stat st;
+    off_t at;
+    ssize_t got;
+    char *data, *p;
+
+    /* a file: all of it with one read() */
+    if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && (at = lseek(fd, 0, SEEK_CUR)) >= 0
+        && st.st_size > at)
+        cap = st.st_size - at + 1;
+    if (b)
+        cap += b->n - b->off;
+    if ((data = malloc(cap)) == NULL)
+        return NULL;
+    if (b)
+    {
+        memcpy(data, b->data + b->off, b->n - b->off);
+        n = b->n - b->off;
+        b->off = b->n = 0;
+    }
+    while (1)
+    {
+        if (n == cap)
+        {
+            if ((p = realloc(data, cap *= 2)) == NULL)
+            {
+                free(data);
+                return NULL;
+            }
+            data = p;
+        }
+        /* what the shell read ahead of its stdin comes first */
+        got = fd == STDIN_FILENO ? (ssize_t)in_take(data + n, cap - n) : 0;
+        if (!got && (got = fill(fd, data + n, cap - n, b && b->file)) <= 0)
+            break;
+        n += got;
+    }
+    *len = n;
+    return data;
+}
+
+/*
+ * do_mapfile - Execute the builtin mapfile (and readarray): the lines of
+ *     the input become the elements of an array, with their newlines
+ *     unless -t
+ */
+void do_mapfile(int argc, char **argv)
+{
+    int i, fd = builtin_in >= 0 ? builtin_in : STDIN_FILENO, trim = 0;
+    long count = 0;
+    size_t len, n = 0, k, cap;
+    char *data, *copy, *p, *nl, *end, **items;
+    const char *name = "MAPFILE";
+
+    for (i = 1; i < argc && argv[i][0] == '-' && argv[i][1]; i++)
+    {
+        if (!strcmp(argv[i], "-t"))
+            trim = 1;
+        else if (!strcmp(argv[i], "-u"))
+        {
+            if ((fd = get_fd(argv[0], argv[++i])) < 0)
+            {
+                builtin_status = 2;
+                return;
+            }
+        }
+        else if (!strcmp(argv[i], "-n") && i + 1 < argc)
+        {
+            if ((count = strtol(argv[++i], &end, 10)) < 0 || *end)
+                goto usage;
+        }
+        else
+            goto usage;
+    }
+    if (i < argc)
+        name = argv[i];
+
+    if (count > 0)
+    {
+        /* just count lines: no more than those may be taken */
+        char line[MAXLINE];
+        int l;
+
+        cap = 64 * 1024;
+        if ((data = malloc(cap)) == NULL)
+            goto fail;
+        for (len = 0; n < (size_t)count && (l = read_line(fd, line, sizeof(line))) >= 0; n++)
+        {
+            if (len + l + 2 > cap)
+            {
+                if ((p = realloc(data, cap = 2 * cap + l)) == NULL)
+                {
+                    free(data);
+                    goto fail;
+                }
+                data = p;
+            }
+            memcpy(data + len, line, l);
+            len += l;
+            if (!trim)
+                data[len++] = '\n';
+            data[len++] = '\0';
+        }
+    }
+    else
+    {
+        if ((data = slurp(fd, &len)) == NULL)
+            goto fail;
+        for (p = data, end = data + len; p < end; n++)
+            p = (nl = memchr(p, '\n', end - p)) ? nl + 1 : end;
+
+        /* each element needs its '\0': in the place of the newline with
+         * -t, else after it, in a copy */
+        if ((copy = malloc(len + n + 1)) == NULL)
+        {
+            free(data);
+            goto fail;
+        }
+        for (p = data, k = 0; p < end; p += len)
+        {
+            len = ((nl = memchr(p, '\n', end - p)) ? nl + 1 : end) - p;
+            memcpy(copy + k, p, len - (trim && nl));
+            k += len - (trim && nl);
+            copy[k++] = '\0';
+        }
+        free(data);
+        data = copy;
+        len = k;
+    }
+
+    if ((items = malloc((n + 1) * sizeof(char *))) == NULL)
+    {
+        free(data);
+        goto fail;
+    }
+    for (k = 0, p = data; k < n; k++, p += strlen(p) + 1)
+        items[k] = p;
+    items[n] = NULL;
+    if (array_set(name, data, items, n) == 0)
+        return;
+fail:
+    printf("%s: %s\n", argv[0], strerror(errno));
+    builtin_status = 1;
+    return;
+usage:
+    printf("usage: %s [-t] [-n count] [-u fd] [name]\n", argv[0]);
+    builtin_status = 2;
+}
+
+/* escape - The character of the escape at *s, which it steps over */
+static char escape(const char **s)
+{
+    switch (*(*s)++)
+    {
+    case 'n': return '\n';
+    case 't': return '\t';
+    case 'r': return '\r';
+    case 'a': return '\a';
+    case 'e': return '\033';
+    case '\\': return '\\';
+    default: (*s)--; return '\\';
+    }
+}
+
+/* put - Append n bytes to the growing buffer *buf */
+static int put(char **buf, size_t *len, size_t *cap, const char *s, size_t n)
+{
+    if (*len + n > *cap)
+    {
+        size_t size = *cap ? *cap : 256;
+        char *p;
+
+        while (size < *len + n)
+            size *= 2;
+        if ((p = realloc(*buf, size)) == NULL)
+            return -1;
+        *buf = p;
+        *cap = size;
+    }
+    memcpy(*buf + *len, s, n);
+    *len += n;
+    return 0;
+}
+
+/*
+ * put_format - Append what snprintf() makes of spec and one argument, at
+ *     any length: the width of "%200d" is the user's
+ */
+static void put_format(char **buf, size_t *len, size_t *cap, const char *spec, ...)
+{
+    char small[64], *s = small;
+    va_list ap;
+    int n;
+
+    va_start(ap, spec);
+    n = vsnprintf(small, sizeof(small), spec, ap);
+    va_end(ap);
+    if (n < 0)
+        return;
+    if ((size_t)n >= sizeof(small))
+    {
+        if ((s = malloc(n + 1)) == NULL)
+            return;
+        va_start(ap, spec);
+        vsnprintf(s, n + 1, spec, ap);
+        va_end(ap);
+    }
+    put(buf, len, cap, s, n);
+    if (s != small)
+        free(s);
+}
+
+/* write_all - Write n bytes to fd; a gone reader is an error, not SIGPIPE */
+static int write_all(int fd, const char *s, size_t n)
+{
+    struct timespec zero = { 0, 0 };
+    sigset_t mask, prev;
+    ssize_t w = 0;
+    size_t done;
+
+    sigemptyset(&mask);
+    sigaddset(&mask, SIGPIPE);
+    sigprocmask(SIG_BLOCK, &mask, &prev);
+    for (done = 0; done < n; done += w)
+        if ((w = write(fd, s + done, n - done)) < 0 && errno != EINTR)
+            break;
+        else if (w < 0)
+            w = 0;
+    if (w < 0 && errno == EPIPE)
+        sigtimedwait(&mask, NULL, &zero);
+    sigprocmask(SIG_SETMASK, &prev, NULL);
+    return w < 0 ? -1 : 0;
+}
+
+/*
+ * do_printf - Execute the builtin printf. The format is used again while
+ *     arguments are left; the output is written with one write().
+ */
+void do_printf(int argc, char **argv)
+{
+    char spec[32], *out = NULL;
+    size_t len = 0, cap = 0, k;
+    const char *f, *arg;
+    int i = 1, fd = STDOUT_FILENO, used;
+    char c;
+
+    if (i + 1 < argc && !strcmp(argv[i], "-u"))
+    {
+        if ((fd = get_fd("printf", argv[i + 1])) < 0)
+        {
+            builtin_status = 2;
+            return;
+        }
+        i += 2;
+    }
+    if (i == argc)
+    {
+        printf("usage: printf [-u fd] format [arg ...]\n");
+        builtin_status = 2;
+        return;
+    }
+
+    const char *format = argv[i++];
+    do
+    {
+        used = 0;
+        for (f = format; *f; )
+        {
+            if (*f == '\\' && f[1])
+            {
+                f++;
+                c = escape(&f);
+                put(&out, &len, &cap, &c, 1);
+                continue;
+            }
+            if (*f != '%')
+            {
+                put(&out, &len, &cap, f++, 1);
+                continue;
+            }
+            if (f[1] == '%')
+            {
+                put(&out, &len, &cap, "%", 1);
+                f += 2;
+                continue;
+            }
+
+            /* %[flags][width][.precision]conversion */
+            k = 1 + strspn(f + 1, "-+ #0");
+            k += strspn(f + k, "0123456789");
+            if (f[k] == '.')
+                k += 1 + strspn(f + k + 1, "0123456789");
+            if (!f[k] || !strchr("scdiuoxX", f[k]) || k + 3 >= sizeof(spec))
+            {
+                put(&out, &len, &cap, f++, 1);
+                continue;
+            }
+            arg = i < argc ? argv[i++] : "";
+            used = 1;
+            if (f[k] == 's')
+            {
+                memcpy(spec, f, k + 1);
+                spec[k + 1] = '\0';
+                put_format(&out, &len, &cap, spec, arg);
+            }
+            else if (f[k] == 'c')
+            {
+                memcpy(spec, f, k);
+                spec[k] = 'c';
+                spec[k + 1] = '\0';
+                put_format(&out, &len, &cap, spec, arg[0]);
+            }
+            else
+            {
+                /* integers are long long: "%5d" becomes "%5lld" */
+                memcpy(spec, f, k);
+                memcpy(spec + k, "ll", 2);
+                spec[k + 2] = f[k];
+                spec[k + 3] = '\0';
+                long long v = strtoll(arg, NULL, 0);
+                put_format(&out, &len, &cap, spec, v);
+            }
+            f += k + 1;
+        }
+    } while (used && i < argc);
+
+    if (fd == STDOUT_FILENO)
+        fwrite(out, 1, len, stdout);
+    else if (len > 0 && write_all(fd, out, len) < 0)
+    {
+        printf("printf: %s\n", strerror(errno));
+        builtin_status = 1;
+    }
+    free(out);
+}
@@ -0,0 +1,355 @@
+/*
+ * zsh - A mini shell program
+ * NKU OS Course
+ * Shuhao Zhang
+ *
+ * file: launcher.c
+ *
+ * The launcher is a small helper process forked at startup, before the
+ * shell has grown. eval() hands it spawn requests over a Unix socket and
+ * it forks the command out of its own tiny address space. The child is
+ * created with CLONE_PARENT, so it is a child of the shell rather than of
+ * the helper: the shell reaps it in sigchld_handler() and tracks it in the
+ * job table exactly like a child it forked itself.
+ */
+#include "main.h"
+#include <sched.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+
+pid_t launcher_pid = 0; /* pid of the helper, 0 if not running */
+int env_gen = 0;        /* bumped whenever the shell changes environ */
+static int launcher_fd = -1;
+static int sent_gen = -1; /* env_gen of the environment the helper holds */
+
+/* Header of one spawn request, followed by len bytes of strings, argv[0..argc-1]
+ * and the working directory, then envlen bytes of envp[0..envc-1]. The
+ * environment is only sent when it changed since the last request
+ * (envc == -1 otherwise). The child's stdin, stdout and stderr travel as
+ * SCM_RIGHTS. */
+struct launch_req {
+    pid_t pgid;             /* process group to join, 0 for a new one */
+    int argc;
+    int envc;
+    int len;
+    int envlen;
+    int has_attr;
+    struct spawn_attr attr; /* limits for the child, if has_attr */
+};
+
+/* growable buffers for packing and unpacking requests */
+struct buf {
+    char *data;
+    size_t cap;
+};
+
+static int reserve(struct buf *b, size_t n)
+{
+    char *p;
+
+    if (n <= b->cap)
+        return 0;
+    if (!(p = realloc(b->data, n)))
+        return -1;
+    b->data = p;
+    b->cap = n;
+    return 0;
+}
+
+/* pack - Copy the strings of vec into b, returns the bytes used */
+static size_t pack(struct buf *b, size_t off, char **vec, int n)
+{
+    size_t len;
+
+    for (int i = 0; i < n; i++, off += len)
+        memcpy(b->data + off, vec[i], len = strlen(vec[i]) + 1);
+    return off;
+}
+
+/* unpack - Point vec[0..n-1] at the strings in data, NULL-terminated */
+static char *unpack(char *data, char **vec, int n)
+{
+    for (int i = 0; i < n; i++, data += strlen(data) + 1)
+        vec[i] = data;
+    vec[n] = NULL;
+    return data;
+}
+
+static void launcher_loop(int fd);
+
+/*
+ * launcher_start - Fork the helper. Call it first thing in main().
+ */
+void launcher_start(void)
+{
+    int sv[2];
+    pid_t pid;
+
+    if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, sv) < 0)
+        unix_error("socketpair error");
+
+    if ((pid = fork()) < 0)
+        unix_error("fork error");
+    if (pid == 0)
+    {
+        close(sv[0]);
+        /* keep ctrl-c and ctrl-z for the shell's own process group */
+        setpgid(0, 0);
+        launcher_loop(sv[1]);
+        _exit(0);
+    }
+
+    close(sv[1]);
+    launcher_fd = sv[0];
+    launcher_pid = pid;
+}
+
+/*
+ * launcher_lost - The helper exited; later spawns fall back to fork().
+ */
+void launcher_lost(void)
+{
+    launcher_pid = 0;
+    if (launcher_fd >= 0)
+        close(launcher_fd);
+    launcher_fd = -1;
+}
+
+/* readn/writen - Transfer exactly n bytes, 0 on success */
+static int readn(int fd, void *buf, size_t n)
+{
+    char *p = buf;
+    ssize_t r;
+
+    while (n > 0)
+    {
+        if ((r = read(fd, p, n)) < 0 && errno == EINTR)
+            continue;
+        if (r <= 0)
+            return -1;
+        p += r;
+        n -= r;
+    }
+    return 0;
+}
+
+static int writen(int fd, const void *buf, size_t n)
+{
+    const char *p = buf;
+    ssize_t r;
+
+    while (n > 0)
+    {
+        if ((r = write(fd, p, n)) < 0 && errno == EINTR)
+            continue;
+        if (r <= 0)
+            return -1;
+        p += r;
+        n -= r;
+    }
+    return 0;
+}
+
+/*
+ * launcher_spawn - Ask the helper to start argv with the given stdio fds
+ *     in process group pgid. Called with SIGCHLD blocked, like fork() in
+ *     eval(). Returns the child's pid, or -1 if the request could not be
+ *     delivered and the caller should fork() itself.
+ */
+pid_t launcher_spawn(char **argv, char **envp, int fds[3], pid_t pgid, const char *cwd,
+                     struct spawn_attr *attr)
+{
+    static struct buf data, env;
+    struct launch_req req;
+    struct iovec iov;
+    struct msghdr msg;
+    union {
+        struct cmsghdr hdr;
+        char buf[CMSG_SPACE(3 * sizeof(int))];
+    } ctl;
+    struct cmsghdr *cmsg;
+    char *cwdv[1] = { (char *)cwd };
+    pid_t pid;
+
+    if (launcher_fd < 0)
+        return -1;
+
+    req.pgid = pgid;
+    if ((req.has_attr = attr != NULL))
+        req.attr = *attr;
+    req.len = strlen(cwd) + 1;
+    for (req.argc = 0; argv[req.argc]; req.argc++)
+        req.len += strlen(argv[req.argc]) + 1;
+    if (reserve(&data, req.len) < 0)
+        return -1;
+    pack(&data, pack(&data, 0, argv, req.argc), cwdv, 1);
+
+    req.envc = -1;
+    req.envlen = 0;
+    if (sent_gen != env_gen)
+    {
+        for (req.envc = 0; envp[req.envc]; req.envc++)
+            req.envlen += strlen(envp[req.envc]) + 1;
+        if (reserve(&env, req.envlen) < 0)
+            return -1;
+        pack(&env, 0, envp, req.envc);
+    }
+
+    /* the fds ride along with the header */
+    iov.iov_base = &req;
+    iov.iov_len = sizeof(req);
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = ctl.buf;
+    msg.msg_controllen = sizeof(ctl.buf);
+    cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(3 * sizeof(int));
+    memcpy(CMSG_DATA(cmsg), fds, 3 * sizeof(int));
+
+    if (sendmsg(launcher_fd, &msg, MSG_NOSIGNAL) != sizeof(req)
+        || writen(launcher_fd, data.data, req.len) < 0
+        || writen(launcher_fd, env.data, req.envlen) < 0
+        || readn(launcher_fd, &pid, sizeof(pid)) < 0)
+    {
+        launcher_lost();
+        return -1;
+    }
+    sent_gen = env_gen;
+    if (pid < 0)
+    {
+        errno = -pid;
+        return -1;
+    }
+    return pid;
+}
+
+/*
+ * launcher_limit - Apply attr to the helper itself, so that children it
+ *     starts later inherit a limit set with the ulimit builtin.
+ */
+void launcher_limit(struct spawn_attr *attr)
+{
+    struct launch_req req;
+    pid_t ret;
+
+    if (launcher_fd < 0)
+        return;
+
+    memset(&req, 0, sizeof(req));
+    req.argc = -1;
+    req.envc = -1;
+    req.has_attr = 1;
+    req.attr = *attr;
+    if (writen(launcher_fd, &req, sizeof(req)) < 0
+        || readn(launcher_fd, &ret, sizeof(ret)) < 0)
+        launcher_lost();
+}
+
+/*
+ * launcher_loop - The helper's main loop: serve spawn requests until the
+ *     shell closes its end of the socket.
+ */
+static void launcher_loop(int fd)
+{
+    struct buf data = { NULL, 0 }, env = { NULL, 0 };
+    char **args = NULL, **envp = NULL;
+    int argcap = 0;
+
+    while (1)
+    {
+        struct launch_req req;
+        struct iovec iov = { &req, sizeof(req) };
+        struct msghdr msg;
+        union {
+            struct cmsghdr hdr;
+            char buf[CMSG_SPACE(3 * sizeof(int))];
+        } ctl;
+        struct cmsghdr *cmsg;
+        int fds[3] = { -1, -1, -1 };
+        char *cwd;
+        pid_t pid;
+        ssize_t r;
+        int i;
+
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_iov = &iov;
+        msg.msg_iovlen = 1;
+        msg.msg_control = ctl.buf;
+        msg.msg_controllen = sizeof(ctl.buf);
+
+        if ((r = recvmsg(fd, &msg, MSG_CMSG_CLOEXEC)) < 0 && errno == EINTR)
+            continue;
+        if (r <= 0)
+            return;
+        if (r < sizeof(req) && readn(fd, (char *)&req + r, sizeof(req) - r) < 0)
+            return;
+        for (cmsg = CMSG_FIRSTHDR(&msg); cmsg; cmsg = CMSG_NXTHDR(&msg, cmsg))
+            if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS)
+                memcpy(fds, CMSG_DATA(cmsg), sizeof(fds));
+
+        /* not a spawn: new limits for the helper, from ulimit */
+        if (req.argc < 0)
+        {
+            apply_attr(&req.attr);
+            pid = 0;
+            if (writen(fd, &pid, sizeof(pid)) < 0)
+                return;
+            continue;
+        }
+
+        if (reserve(&data, req.len) < 0 || readn(fd, data.data, req.len) < 0)
+            return;
+        if (req.argc + 1 > argcap)
+        {
+            argcap = req.argc + 1;
+            if (!(args = realloc(args, argcap * sizeof(char *))))
+                return;
+        }
+        cwd = unpack(data.data, args, req.argc);
+
+        /* a new environment replaces the one kept from earlier requests */
+        if (req.envc >= 0)
+        {
+            if (reserve(&env, req.envlen) < 0 || readn(fd, env.data, req.envlen) < 0)
+                return;
+            if (!(envp = realloc(envp, (req.envc + 1) * sizeof(char *))))
+                return;
+            unpack(env.data, envp, req.envc);
+        }
+
+        /* a plain fork(), except the child's parent is the shell */
+        pid = syscall(SYS_clone, CLONE_PARENT | SIGCHLD, 0, 0, 0, 0);
+        if (pid == 0)
+        {
+            if (setpgid(0, req.pgid) < 0)
+            {
+                printf("setpgid error: %s\n", strerror(errno));
+                fflush(stdout);
+                _exit(1);
+            }
+            if (chdir(cwd) < 0)
+                _exit(1);
+            for (i = 0; i < 3; i++)
+                dup2(fds[i], i);
+            if (req.has_attr)
+                apply_attr(&req.attr);
+            if (env_eval(args[0], args, envp) < 0)
+            {
+                printf("%s: command not found\n", args[0]);
+                fflush(stdout);
+            }
+            _exit(127);
+        }
+        if (pid < 0)
+            pid = -errno;
+
+        for (i = 0; i < 3; i++)
+            if (fds[i] >= 0)
+                close(fds[i]);
+        if (writen(fd, &pid, sizeof(pid)) < 0)
+            return;
+    }
+}
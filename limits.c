@@ -0,0 +1,286 @@
+/*
+ * zsh - A mini shell program
+ * NKU OS Course
+ * Shuhao Zhang
+ *
+ * file: limits.c
+ *
+ * Resource limits and CPU placement. `ulimit` changes the shell's own
+ * limits, which every later job inherits. The `limit` prefix applies
+ * limits, a nice value and a CPU affinity to one job only: spawn() hands
+ * the attributes to the child, which applies them after setpgid() and
+ * before execve(), so no wrapper program is exec'd.
+ */
+#include "main.h"
+
+/* the limits both builtins know, in `ulimit -a` order */
+static const struct {
+    char opt;
+    int resource;
+    rlim_t unit;            /* bytes per unit of the user's value */
+    const char *name;
+} limit_tab[NLIMITS] = {
+    { 't', RLIMIT_CPU,    1,    "cpu time (seconds)" },
+    { 'v', RLIMIT_AS,     1024, "virtual memory (kbytes)" },
+    { 'n', RLIMIT_NOFILE, 1,    "open files" },
+    { 'u', RLIMIT_NPROC,  1,    "max user processes" },
+};
+
+/* limit_index - Map an option letter to its limit_tab slot, -1 if none */
+static int limit_index(char opt)
+{
+    for (int i = 0; i < NLIMITS; i++)
+        if (limit_tab[i].opt == opt)
+            return i;
+    return -1;
+}
+
+/* parse_rlim - Parse a limit value ("unlimited" or a number of units) */
+static int parse_rlim(const char *s, int i, rlim_t *val)
+{
+    char *end;
+    unsigned long long v;
+
+    if (!strcmp(s, "unlimited"))
+    {
+        *val = RLIM_INFINITY;
+        return 0;
+    }
+    errno = 0;
+    v = strtoull(s, &end, 10);
+    if (errno || end == s || *end || *s == '-')
+        return -1;
+    *val = v * limit_tab[i].unit;
+    return 0;
+}
+
+/* parse_cpus - Parse a CPU list such as "0,2-3" into set */
+static int parse_cpus(const char *s, cpu_set_t *set)
+{
+    char *end;
+    long lo, hi;
+
+    CPU_ZERO(set);
+    while (*s)
+    {
+        lo = hi = strtol(s, &end, 10);
+        if (end == s)
+            return -1;
+        if (*end == '-')
+        {
+            s = end + 1;
+            hi = strtol(s, &end, 10);
+            if (end == s)
+                return -1;
+        }
+        if (lo < 0 || hi < lo || hi >= CPU_SETSIZE)
+            return -1;
+        for (; lo <= hi; lo++)
+            CPU_SET(lo, set);
+        if (*end == ',')
+            end++;
+        else if (*end)
+            return -1;
+        s = end;
+    }
+    return CPU_COUNT(set) ? 0 : -1;
+}
+
+/*
+ * limit_prefix - Parse the options of `limit [-t secs] [-v kbytes]
+ *     [-n files] [-u procs] [-N nice] [-c cpus] [-P] -- cmd ...` into
+ *     attr, which the caller has cleared. Returns the index of cmd in argv, or -1 after printing an
+ *     error. -P pins each pipeline stage to its own CPU, taken in order
+ *     from -c or from the shell's own affinity.
+ */
+int limit_prefix(char **argv, struct spawn_attr *attr)
+{
+    int i, k;
+    rlim_t val;
+
+    for (i = 1; argv[i] && argv[i][0] == '-'; i++)
+    {
+        char opt = argv[i][1];
+
+        if (!strcmp(argv[i], "--"))
+        {
+            i++;
+            break;
+        }
+        if (opt == 'P' && !argv[i][2])
+        {
+            attr->spread = 1;
+            continue;
+        }
+        if (!opt || argv[i][2] || !argv[i + 1])
+            goto usage;
+
+        if ((k = limit_index(opt)) >= 0)
+        {
+            if (parse_rlim(argv[++i], k, &val) < 0)
+            {
+                printf("limit: %s: invalid limit\n", argv[i]);
+                return -1;
+            }
+            attr->set |= 1 << k;
+            attr->rlim[k].rlim_cur = attr->rlim[k].rlim_max = val;
+        }
+        else if (opt == 'N')
+        {
+            attr->set |= ATTR_NICE;
+            attr->nice = atoi(argv[++i]);
+        }
+        else if (opt == 'c')
+        {
+            if (parse_cpus(argv[++i], &attr->cpus) < 0)
+            {
+                printf("limit: %s: invalid cpu list\n", argv[i]);
+                return -1;
+            }
+            attr->set |= ATTR_CPUS;
+        }
+        else
+            goto usage;
+    }
+    if (!argv[i])
+        goto usage;
+
+    if (attr->spread && !(attr->set & ATTR_CPUS))
+    {
+        if (sched_getaffinity(0, sizeof(attr->cpus), &attr->cpus) < 0)
+            unix_error("sched_getaffinity error");
+        attr->set |= ATTR_CPUS;
+    }
+    return i;
+
+usage:
+    printf("usage: limit [-t secs] [-v kbytes] [-n files] [-u procs] [-N nice] [-c cpus] [-P] -- cmd\n");
+    return -1;
+}
+
+/*
+ * stage_attr - Narrow attr to stage i of a pipeline: with -P the stage
+ *     gets only the i-th CPU of the set (wrapping around).
+ */
+void stage_attr(const struct spawn_attr *attr, int i, struct spawn_attr *out)
+{
+    int cpu, n;
+
+    *out = *attr;
+    if (!attr->spread)
+        return;
+    n = i % CPU_COUNT(&attr->cpus);
+    for (cpu = 0; cpu < CPU_SETSIZE; cpu++)
+        if (CPU_ISSET(cpu, &attr->cpus) && n-- == 0)
+            break;
+    CPU_ZERO(&out->cpus);
+    CPU_SET(cpu, &out->cpus);
+}
+
+/*
+ * apply_attr - Apply attr to the calling process. Runs in the child
+ *     between setpgid() and execve(); errors end the child with
+ *     _exit(), which leaves the stdio buffers it shares with the shell.
+ */
+void apply_attr(const struct spawn_attr *attr)
+{
+    if (!attr->set)
+        return;
+    for (int i = 0; i < NLIMITS; i++)
+    {
+        if ((attr->set & (1 << i)) && setrlimit(limit_tab[i].resource, &attr->rlim[i]) < 0)
+        {
+            fprintf(stderr, "limit: %s: %s\n", limit_tab[i].name, strerror(errno));
+            _exit(1);
+        }
+    }
+    if (attr->set & ATTR_NICE)
+    {
+        errno = 0;
+        if (nice(attr->nice) == -1 && errno)
+        {
+            fprintf(stderr, "limit: nice: %s\n", strerror(errno));
+            _exit(1);
+        }
+    }
+    if ((attr->set & ATTR_CPUS) && sched_setaffinity(0, sizeof(attr->cpus), &attr->cpus) < 0)
+    {
+        fprintf(stderr, "limit: cpus: %s\n", strerror(errno));
+        _exit(1);
+    }
+}
+
+/* print_rlim - Print one limit in user units */
+static void print_rlim(int i, rlim_t val, int label)
+{
+    if (label)
+        printf("-%c: %-26s ", limit_tab[i].opt, limit_tab[i].name);
+    if (val == RLIM_INFINITY)
+        printf("unlimited\n");
+    else
+        printf("%llu\n", (unsigned long long)(val / limit_tab[i].unit));
+}
+
+/*
+ * do_ulimit - Execute the builtin ulimit command:
+ *     ulimit -a | ulimit [-t|-v|-n|-u] [value]
+ *     Changes the shell's own soft and hard limits, inherited by all jobs.
+ */
+void do_ulimit(int argc, char **argv)
+{
+    struct rlimit rl;
+    int k = limit_index('n');   /* like other shells, the default is -n */
+    int i = 1;
+
+    if (argc > 1 && !strcmp(argv[1], "-a"))
+    {
+        for (k = 0; k < NLIMITS; k++)
+        {
+            getrlimit(limit_tab[k].resource, &rl);
+            print_rlim(k, rl.rlim_cur, 1);
+        }
+        return;
+    }
+    if (argc > 1 && argv[1][0] == '-')
+    {
+        if (argv[1][2] || (k = limit_index(argv[1][1])) < 0)
+        {
+            printf("usage: ulimit -a | ulimit [-t|-v|-n|-u] [value]\n");
+            return;
+        }
+        i++;
+    }
+
+    if (getrlimit(limit_tab[k].resource, &rl) < 0)
+    {
+        printf("ulimit: %s\n", strerror(errno));
+        return;
+    }
+    if (!argv[i])
+    {
+        print_rlim(k, rl.rlim_cur, 0);
+        return;
+    }
+    if (parse_rlim(argv[i], k, &rl.rlim_cur) < 0)
+    {
+        printf("ulimit: %s: invalid limit\n", argv[i]);
+        return;
+    }
+    rl.rlim_max = rl.rlim_cur;
+    if (setrlimit(limit_tab[k].resource, &rl) < 0)
+    {
+        printf("ulimit: %s: %s\n", limit_tab[k].name, strerror(errno));
+        return;
+    }
+
+    /* children of the launcher inherit its limits, not ours */
+    if (launcher_pid)
+    {
+        struct spawn_attr attr;
+
+        memset(&attr, 0, sizeof(attr));
+        attr.set = 1 << k;
+        attr.rlim[k] = rl;
+        launcher_limit(&attr);
+    }
+}
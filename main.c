@@ -6,22 +6,28 @@
  * file: main.c
  */
 #include "main.h"
+#include <getopt.h>
 
 /* Global variables */
 extern char **environ; /* defined in libc */
-                       /* command line prompt */
-char prompt[]      = "\033[01;32m%s@%s\033[00m:\033[01;34m%s\033[00m %s ";
 char user[MAXLINE] = "zsh";
 char host[MAXLINE] = "kali";
 int verbose = 0;            /* if true, print additional output */
+int last_status = 0;        /* exit status of the last foreground job */
+int builtin_status = 0;     /* exit status of the builtin that just ran */
+int builtin_in = -1;        /* stdin of the builtin, from < or <<, or -1 */
+void (*exit_hook)(int status) = NULL;   /* the exit builtin leaves here, see embed.c */
 int nextjid = 1;            /* next job ID to allocate */
 char sbuf[MAXLINE];         /* for composing sprintf messages */
-char cur_dir[MAXLINE];      /* store current directory path */
-char prev_dir[MAXLINE];
+char cur_dir[MAXPATH];      /* store current directory path */
+char prev_dir[MAXPATH];
 struct job_t jobs[MAXJOBS]; /* The job list */
+int jobs_used = 0;          /* jobs[0..jobs_used) are initialized slots */
+char parse_quoted[MAXARGS]; /* parseline(): argv[i] was in quotes */
 const char *delim = ";";    /* delimiter for multi-cmdlines */
 /* End global variables */
 
+#ifndef MINISHELL_LIB        /* libminishell has no main(), see embed.c */
 /*
  * main - The shell's main routine
  */
@@ -30,6 +36,20 @@ int main(int argc, char **argv)
     char c;
     char cmdlines[MAXLINE]; /* the user inputted string might be multi-cmds (delimiter: ';'). */
     int emit_prompt = 1;    /* emit prompt (default) */
+    int use_launcher = 0;   /* spawn through a pre-forked helper */
+    char *server_path = NULL; /* serve scripts on this socket */
+    int read_rc = 1;        /* read the startup file */
+    int snapshot = 0;       /* and write a snapshot of it */
+    char *replay_path = NULL; /* read commands from this recording */
+    int timed = 0;          /* at the times they were recorded */
+    static struct option longopts[] = {
+        { "replay", required_argument, NULL, 'P' },
+        { "timed", no_argument, NULL, 'T' },
+        { NULL, 0, NULL, 0 }
+    };
+    int interactive;
+    int editing;            /* read commands with the line editor */
+    int eof;
 
     /* Redirect stderr to stdout (so that driver will get all output
      * on the pipe connected to stdout) */
@@ -37,7 +57,7 @@ int main(int argc, char **argv)
     /* TODO: implement the function of pipe. by zsh */
 
     /* Parse the command line */
-    while ((c = getopt(argc, argv, "hvp")) != EOF)
+    while ((c = getopt_long(argc, argv, "hvpzbfsS:R:", longopts, NULL)) != EOF)
     {
         switch (c)
         {
@@ -50,11 +70,45 @@ int main(int argc, char **argv)
         case 'p':            /* don't print a prompt */
             emit_prompt = 0; /* handy for automatic testing */
             break;
+        case 'z':            /* spawn commands through the launcher */
+            use_launcher = 1;
+            break;
+        case 'b':            /* capture output of background jobs */
+            capture_on = 1;
+            break;
+        case 'S':            /* command server on a Unix socket */
+            server_path = optarg;
+            break;
+        case 'f':            /* skip the startup file */
+            read_rc = 0;
+            break;
+        case 's':            /* snapshot the startup file */
+            snapshot = 1;
+            break;
+        case 'R':            /* record the session */
+            record_open(optarg);
+            break;
+        case 'P':            /* --replay: run a recorded session */
+            replay_path = optarg;
+            break;
+        case 'T':            /* --timed */
+            timed = 1;
+            break;
         default:
             usage();
         }
     }
 
+    /* An up-to-date snapshot of the startup file runs no commands, so it
+     * is applied before anything forks */
+    interactive = emit_prompt && !server_path;
+    if (read_rc && !snapshot && rc_map(interactive) == 0)
+        read_rc = 0;
+
+    /* Fork the launcher while the shell is still small */
+    if (use_launcher)
+        launcher_start();
+
     /* Install the signal handlers */
 
     /* These are the ones implemented for handling signals. */
@@ -68,73 +122,104 @@ int main(int argc, char **argv)
     /* Initialize the job list */
     initjobs(jobs);
 
+    /* Find the logical working directory */
+    dirs_init();
+
+    /* Evaluate the startup file */
+    if (read_rc)
+        rc_load(interactive, snapshot);
+
+    editing = emit_prompt && isatty(STDIN_FILENO) && isatty(STDOUT_FILENO) && !replay_path;
+    if (replay_path)
+        replay_open(replay_path, timed);
+
+    /* Serve scripts instead of reading commands, never returns */
+    if (server_path)
+        server_run(server_path);
+
     /* Execute the shell's read/eval loop */
     while (1)
     {
 
-        /* Read command line */
+        /* Read command line, with the line editor on a terminal */
         if (emit_prompt)
+            prompt_update();
+        if (replay_path)
+            eof = replay_next(cmdlines, MAXLINE) < 0;
+        else if (editing)
+            eof = edit_line(prompt_string, cmdlines, MAXLINE) < 0;
+        else
         {
-            print_prompt();
-            fflush(stdout);
+            if (emit_prompt)
+            {
+                print_prompt();
+                fflush(stdout);
+            }
+            /* Wait for input, servicing job deadlines meanwhile. Nothing to
+             * wait for if the shell already read ahead the next line. */
+            if (!in_buffered())
+                while (!wait_input(STDIN_FILENO, -1))
+                    ;
+            else
+            {
+                capture_drain();
+                sched_run();
+            }
+            eof = in_gets(cmdlines, MAXLINE - 1) == NULL;
         }
-        if ((fgets(cmdlines, MAXLINE, stdin) == NULL) && ferror(stdin))
-            app_error("fgets error");
-        if (feof(stdin))
+        if (eof)
         { /* End of file (ctrl-d) */
+            sched_wait();
+            metrics_exit();
             puts("\n\033[1;32mGood bye from zsh!\033[00m");
             fflush(stdout);
             exit(0);
         }
 
-        cmdlines[strlen(cmdlines) - 1] = ' ';
-        /* Evaluate the command line */
-        /* If cmdlines is just one cmdline. */
-        if (!strchr(cmdlines, delim[0]))
-        {
-            eval(cmdlines);
-            continue;
-        }
-        /* If cmdlines is multi-cmdline. */
-        else
-        {
-            char *cmdline = strtok(cmdlines, delim);
-            while (cmdline)
-            {
-                //printf("[*] cmdline = [%s]\n", cmdline);
-                eval(cmdline);
-                cmdline = strtok(NULL, delim);
-            }
-        }
+        record_begin(cmdlines);
+        /* the newline becomes a space; the last line may have none */
+        size_t len = strlen(cmdlines);
+        if (cmdlines[len - 1] == '\n')
+            len--;
+        cmdlines[len] = ' ';
+        cmdlines[len + 1] = '\0';
+        /* Evaluate the command line, timed for the prompt and -R */
+        prompt_begin();
+        eval_lines(cmdlines);
+        prompt_end();
+        record_end(last_status);
 
         fflush(stdout);
-        fflush(stdout);
     }
 
     exit(0); /* control never reaches here */
 }
+#endif
 
 /*
-* print_prompt - print prompt information into stdout
-*/
-void print_prompt(void) {
-    getcwd(cur_dir, sizeof(cur_dir));
-
-    /* Get username and hostname */
-    struct passwd* username;
-    username = getpwuid(getuid());
-    strcpy(user, username->pw_name);
-
-    gethostname(host, sizeof(host));
-
-    char* c;
-    if (!strcmp(username->pw_name, "root")) {
-        c = "\033[01;31m➤\033[00m";
-    } else {
-        c = "\033[01;32m➤\033[00m";
+ * eval_lines - Evaluate one input line, which may hold several cmdlines
+ *     separated by ';'. Like eval(), expects a trailing space instead of
+ *     the newline.
+ */
+void eval_lines(char *cmdlines)
+{
+    char *save;
+
+    /* If cmdlines is just one cmdline. */
+    if (!strchr(cmdlines, delim[0]))
+    {
+        eval(cmdlines);
+        return;
     }
 
-    printf(prompt, user, host, cur_dir, c);
+    /* If cmdlines is multi-cmdline. builtins may use strtok() themselves. */
+    char *cmdline = strtok_r(cmdlines, delim, &save);
+    while (cmdline)
+    {
+        //printf("[*] cmdline = [%s]\n", cmdline);
+        eval(cmdline);
+        cmdline = strtok_r(NULL, delim, &save);
+    }
 }
 
 /*
@@ -152,8 +237,7 @@ void eval(char *cmdline)
 {
     char *argv[MAXARGS];
     int state = UNDEF;
-    sigset_t set;
-    pid_t pid;
+    char **words;
 
     // 处理输入的数据
     if (parseline(cmdline, argv) == 1)
@@ -165,9 +249,21 @@ void eval(char *cmdline)
     if (argv[0] == NULL)
         return;
 
+    // 别名展开: 命令词如果是别名, 换成别名的各个词
+    if (alias_expand(argv, parse_quoted) < 0 || argv[0] == NULL)
+        return;
+
     // Parse the args, if one is environ variable, then change it to its content.
     for (int i = 0; argv[i]; i++)
     {
+        const char *value;
+
+        // 数组: ${NAME[i]} 是一个元素, ${#NAME[@]} 是元素个数
+        if ((value = array_expand(argv[i])) != NULL)
+        {
+            argv[i] = (char *)value;
+            continue;
+        }
         if (argv[i][0] == '$') /* environ var is begin with $, like $PATH. */
         {
             //char* var_name = strchr(argv[i], '$') + 1;
@@ -186,55 +282,419 @@ void eval(char *cmdline)
         }
     }
 
-    // 把命令传递给命令执行函数, 如果不是内置命令, 则执行if内的内容
+    // 路径名展开: *, ?, [...] 和 **, 引号中的参数不展开; 展开后的词可以多于 MAXARGS 个
+    words = glob_argv(argv, parse_quoted);
+    eval_words(words, state, cmdline);
+    free(words);
+}
+
+/*
+ * eval_words - The rest of eval(), once the words of the command line
+ *     are expanded: take out the redirections, then run the command.
+ */
+void eval_words(char **argv, int state, char *cmdline)
+{
+    struct spawn_attr attr;
+    struct redir redir;
+    char **args;
+    int i;
+
+    // here-document, here-string 和进程替换: 从 argv 中取出, 由 launch_job 接到各个阶段上
+    if (redir_parse(argv, &redir) < 0)
+        return;
+    if (argv[0] == NULL || (redir_used(&redir) && !strcmp(argv[0], "after")))
+    {
+        if (argv[0])
+            printf("after: redirections are not supported for queued jobs\n");
+        redir_close(&redir);
+        return;
+    }
+
+    // after 依赖: 命令排队, 等到所依赖的作业都成功结束后再启动
+    if (!strcmp(argv[0], "after"))
+    {
+        do_after(argv, cmdline);
+        return;
+    }
+
+    // 协进程: 作业的标准输入输出是 zsh 持有的两个管道
+    if (!strcmp(argv[0], "coproc"))
+    {
+        do_coproc(argv, cmdline, &redir);
+        return;
+    }
+
+    // on-change: 监视文件, 每次有改动就取消正在运行的命令并重新运行
+    if (!strcmp(argv[0], "on-change"))
+    {
+        do_onchange(argv, cmdline, &redir);
+        return;
+    }
+
+    // xargs 在管道的最后一个阶段时由 zsh 自己执行, 不需要 xargs 进程
+    if (state == FG && (i = xargs_stage(argv)) >= 0)
+    {
+        do_xargs(argv, i, cmdline, &redir);
+        return;
+    }
+
+    // wc, head 和 grep -F 也是: 由 zsh 读取前面各个阶段写入的管道
+    if (state == FG && (i = text_stage(argv)) >= 0)
+    {
+        do_text(argv, i, cmdline, &redir);
+        return;
+    }
+
+    // limit / timeout 前缀: 为这个作业设置资源限制、CPU亲和性和截止时间
+    if ((args = job_prefixes(argv, &attr)) == NULL)
+    {
+        redir_close(&redir);
+        return;
+    }
+    if (args != argv)
+    {
+        launch_job(args, state, cmdline, &attr, NULL, &redir);
+        return;
+    }
+
+    // 把命令传递给命令执行函数, 如果不是内置命令, 则启动作业
+    builtin_in = redir.in[0];
     if (!builtin_cmd(argv))
+        launch_job(argv, state, cmdline, NULL, NULL, &redir);
+    else
     {
-        if (sigemptyset(&set) < 0)
-            unix_error("sigemptyset error");
-        if (sigaddset(&set, SIGINT) < 0 || sigaddset(&set, SIGTSTP) < 0 || sigaddset(&set, SIGCHLD) < 0)
-            unix_error("sigaddset error");
-        // 在fork前，将SIGCHLD信号阻塞，防止并发错误-竞争的发生
-        if (sigprocmask(SIG_BLOCK, &set, NULL) < 0)
-            unix_error("sigprocmask error");
+        builtin_in = -1;
+        redir_close(&redir);
+        last_status = builtin_status;
+    }
+    return;
+}
+
+/*
+ * job_prefixes - Strip the limit and timeout prefixes off argv, filling
+ *     attr (cleared first). Returns the command after them, argv itself
+ *     if there are none, or NULL after printing an error.
+ */
+char **job_prefixes(char **argv, struct spawn_attr *attr)
+{
+    int cmd;
+
+    memset(attr, 0, sizeof(*attr));
+    while (!strcmp(argv[0], "limit") || !strcmp(argv[0], "timeout"))
+    {
+        if (!strcmp(argv[0], "limit"))
+            cmd = limit_prefix(argv, attr);
+        else
+            cmd = timeout_prefix(argv, attr);
+        if (cmd < 0)
+            return NULL;
+        argv += cmd;
+    }
+    return argv;
+}
+
+/*
+ * launch_job - Run the command in argv as a job, see start_job(), then
+ *     wait for it if it is a foreground job. Returns the job's process
+ *     group, or 0 if the command was refused.
+ */
+pid_t launch_job(char **argv, int state, char *cmdline, struct spawn_attr *attr, struct job_t *slot,
+                 struct redir *r)
+{
+    pid_t pgid;
+
+    if ((pgid = start_job(argv, state, cmdline, attr, slot, r)) == 0)
+        return 0;
+    // 判断子进程类型并做处理
+    if (state == FG)
+        waitfg(pgid);
+    else
+        printf("[%d] (%d) %s", pid2jid(pgid), pgid, cmdline);
+    return pgid;
+}
+
+/*
+ * stage_input - The input of a last pipeline stage that the shell runs
+ *     itself (xargs, wc, head, grep -F), whose command is argv[at]. The
+ *     stages before it are started as a foreground job writing into a
+ *     pipe, whose read end is returned and the job in *pgid. A command
+ *     alone reads its file or here-document, or else the shell's stdin
+ *     (*pgid is 0). Takes over r. Returns -1 if it could not start.
+ */
+int stage_input(char **argv, int at, char *cmdline, struct redir *r, pid_t *pgid)
+{
+    int stage = 0, fd = STDIN_FILENO, pd[2];
+
+    *pgid = 0;
+    for (int i = 0; i < at; i++)
+        stage += !strcmp(argv[i], "|");
+    if (r->in[stage] >= 0)
+    {
+        /* cmd <<EOF or cmd < file: that is its input */
+        fd = r->in[stage];
+        r->in[stage] = -1;
+    }
+    if (at == 0)
+    {
+        redir_close(r);
+        return fd;
+    }
+    if (fd != STDIN_FILENO)
+    {
+        printf("%s: input is both a pipe and a redirection\n", argv[at]);
+        close(fd);
+        redir_close(r);
+        return -1;
+    }
+    if (pipe2(pd, O_CLOEXEC) < 0)
+    {
+        printf("%s: %s\n", argv[at], strerror(errno));
+        redir_close(r);
+        return -1;
+    }
+    /* fewer, larger reads for the shell: 1MB, if the system allows */
+    fcntl(pd[0], F_SETPIPE_SZ, 1 << 20);
+    argv[at - 1] = NULL;
+    r->out = pd[1];
+    if ((*pgid = start_job(argv, FG, cmdline, NULL, NULL, r)) == 0)
+    {
+        close(pd[0]);
+        return -1;
+    }
+    return pd[0];
+}
+
+/*
+ * start_job - Start the command in argv as a job. Stages of a pipeline are
+ *     separated by "|" arguments; all of them join the process group of
+ *     the first stage, and the job ends when every stage has been reaped.
+ *     attr (may be NULL) holds the limits given with the limit prefix.
+ *     slot (may be NULL) is a queued job to start instead of a new one.
+ *     r (may be NULL) holds the here-documents and process substitutions
+ *     taken out of argv; start_job() closes them. Returns the job's
+ *     process group, or 0 if the command was refused.
+ */
+pid_t start_job(char **argv, int state, char *cmdline, struct spawn_attr *attr, struct job_t *slot,
+                struct redir *r)
+{
+    struct spawn_attr sattr;
+    char **stages[MAXPIPE];
+    pid_t pids[MAXPIPE];
+    int keep[MAXSUBST + 1];
+    struct subst *sub;
+    int nstages = 1, npids = 0, nkeep;
+    int fds[3], pd[2];
+    int cap[2] = { -1, -1 };
+    int in = STDIN_FILENO;
+    pid_t pgid = 0;
+    struct job_t *job;
+    sigset_t set, prev;
+
+    // 按 "|" 切分管道的各个阶段
+    stages[0] = argv;
+    for (int i = 0; argv[i]; i++)
+    {
+        if (strcmp(argv[i], "|"))
+            continue;
+        if (nstages == MAXPIPE)
+        {
+            printf("Too many pipeline stages\n");
+            if (r)
+                redir_close(r);
+            return 0;
+        }
+        argv[i] = NULL;
+        stages[nstages++] = &argv[i + 1];
+    }
+    for (int i = 0; i < nstages; i++)
+    {
+        if (stages[i][0] == NULL)
+        {
+            printf("syntax error near unexpected token `|'\n");
+            if (r)
+                redir_close(r);
+            return 0;
+        }
+    }
+    if (r && nstages + r->nsub > MAXPIPE)
+    {
+        printf("Too many processes in one job\n");
+        redir_close(r);
+        return 0;
+    }
+
+    if (sigemptyset(&set) < 0)
+        unix_error("sigemptyset error");
+    if (sigaddset(&set, SIGINT) < 0 || sigaddset(&set, SIGTSTP) < 0 || sigaddset(&set, SIGCHLD) < 0)
+        unix_error("sigaddset error");
+    // 在fork前，将SIGCHLD信号阻塞，防止并发错误-竞争的发生
+    if (sigprocmask(SIG_BLOCK, &set, &prev) < 0)
+        unix_error("sigprocmask error");
+
+    // 后台作业的输出写入捕获管道, 由zsh读入作业的环形缓冲区
+    if (state == BG && capture_on && pipe2(cap, O_CLOEXEC) < 0)
+        cap[0] = cap[1] = -1;
+
+    // 进程替换的命令先启动, 各个阶段通过 /dev/fd/N 使用管道的另一端
+    for (int k = 0; r && k < r->nsub; k++)
+    {
+        sub = &r->sub[k];
+        fds[0] = sub->out ? sub->subfd : STDIN_FILENO;
+        fds[1] = sub->out ? (cap[1] >= 0 ? cap[1] : STDOUT_FILENO) : sub->subfd;
+        fds[2] = cap[1] >= 0 ? cap[1] : STDERR_FILENO;
+        pids[npids++] = spawn(sub->argv, fds, pgid, &set, NULL, NULL);
+        if (!pgid)
+            pgid = pids[0];
+        close(sub->subfd);
+        sub->subfd = -1;
+    }
 
-        if ((pid = fork()) < 0)
-            unix_error("fork error");
-        else if (pid == 0)
+    for (int i = 0; i < nstages; i++)
+    {
+        fds[0] = r && r->in[i] >= 0 ? r->in[i] : in;
+        fds[1] = cap[1] >= 0 ? cap[1] : STDOUT_FILENO;
+        fds[2] = cap[1] >= 0 ? cap[1] : STDERR_FILENO;
+        if (i == nstages - 1 && r && r->out >= 0)
+            fds[1] = r->out;
+        if (i < nstages - 1)
         {
-            /*  把新建立的进程添加到新的进程组:
-                当从bash运行zsh时，zsh在bash前台进程组中运行。
-                如果zsh随后创建了一个子进程，默认情况下，该子进程也将是bash前台进程组的成员。
-                由于输入ctrl-c将向bash前台组中的每个进程发送一个SIGINT，
-                因此输入ctrl-c将向zsh以及zsh创建的每个进程发送一个SIGINT，这显然是不正确的。
-                这里有一个解决方案:在fork之后，但在execve之前，子进程应该调用setpgid(0,0)，
-                这将把子进程放入一个新的进程组中，该进程组的ID与子进程的PID相同。
-                这确保bash前台进程组中只有一个进程，即zsh进程。
-                当您键入ctrl-c时，zsh应该捕获结果SIGINT，然后将其转发到适当的前台作业
-            */
-            // 子进程的控制流开始
-            if (sigprocmask(SIG_UNBLOCK, &set, NULL) < 0)
-                unix_error("sigprocmask error");
-            if (setpgid(0, 0) < 0)
-                unix_error("setpgid error");
-            if (env_eval(argv[0], argv, environ) < 0)
-            {
-                printf("%s: command not found\n", argv[0]);
-                exit(0);
-            }
+            // 管道两端都设置 close-on-exec, 子进程只保留 dup2 后的副本
+            if (pipe2(pd, O_CLOEXEC) < 0)
+                unix_error("pipe error");
+            fds[1] = pd[1];
         }
-        // 将当前进程添加进job中，无论是前台进程还是后台进程
-        addjob(jobs, pid, state, cmdline);
-        // 恢复受阻塞的信号 SIGINT SIGTSTP SIGCHLD
-        if (sigprocmask(SIG_UNBLOCK, &set, NULL) < 0)
-            unix_error("sigprocmask error");
 
-        // 判断子进程类型并做处理
-        if (state == FG)
-            waitfg(pid);
-        else
-            printf("[%d] (%d) %s", pid2jid(pid), pid, cmdline);
+        // 这个阶段用到的进程替换管道, 在 exec 后仍要打开
+        for (nkeep = 0, sub = r ? r->sub : NULL; r && sub < r->sub + r->nsub; sub++)
+            if (sub->stage == i)
+                keep[nkeep++] = sub->fd;
+        keep[nkeep] = -1;
+
+        if (attr)
+            stage_attr(attr, i, &sattr);
+        pids[npids++] = spawn(stages[i], fds, pgid, &set, attr ? &sattr : NULL, nkeep ? keep : NULL);
+        if (!pgid)
+            pgid = pids[0];
+
+        if (in != STDIN_FILENO)
+            close(in);
+        if (i < nstages - 1)
+        {
+            close(pd[1]);
+            in = pd[0];
+        }
     }
-    return;
+
+    if (cap[1] >= 0)
+        close(cap[1]);
+    if (r)
+        redir_close(r);
+
+    // 将当前作业添加进job中，无论是前台进程还是后台进程; 排队的作业沿用原来的位置
+    if (slot)
+        startjob(job = slot, pgid, state);
+    else
+        job = newjob(jobs, pgid, state, cmdline);
+    if (job)
+    {
+        if (cap[0] >= 0)
+            capture_attach(job, cap[0]);
+        for (int i = 1; i < npids; i++)
+            addjobproc(job, pids[i]);
+        if (attr && attr->timeout > 0)
+            set_deadline(job, attr->timeout, attr->grace);
+    }
+    else if (cap[0] >= 0)
+        close(cap[0]);
+    // 恢复受阻塞的信号 SIGINT SIGTSTP SIGCHLD
+    if (sigprocmask(SIG_SETMASK, &prev, NULL) < 0)
+        unix_error("sigprocmask error");
+    return pgid;
+}
+
+/*
+ * spawn - Start argv with stdin, stdout and stderr taken from fds[0..2],
+ *     in process group pgid (0: a new group led by the child). Uses the
+ *     launcher when it is running and forks the shell otherwise. The
+ *     caller blocks the signals in set around the call, as eval() does.
+ *     attr, if not NULL, is applied in the child before execve(). keep,
+ *     if not NULL, lists fds (ending with -1) the command inherits, too.
+ */
+pid_t spawn(char **argv, int fds[3], pid_t pgid, sigset_t *set, struct spawn_attr *attr,
+            const int *keep)
+{
+    struct timespec started;
+    pid_t pid;
+    int text;
+
+    // read 预读过的文件, 把偏移量还给命令
+    io_sync();
+
+    // launcher 只拿到标准输入输出, 需要额外保留 fd 时直接 fork;
+    // wc, head 和 grep -F 在 fork 出的子进程中直接执行, 不需要 execve
+    clock_gettime(CLOCK_MONOTONIC, &started);
+    text = text_cmd(argv);
+    if (launcher_pid && !keep && !text
+        && (pid = launcher_spawn(argv, environ, fds, pgid, cur_dir, attr)) > 0)
+    {
+        /* the child is ours (CLONE_PARENT): put it in its group before the
+         * next stage tries to join it */
+        setpgid(pid, pgid ? pgid : pid);
+        metrics_spawned(pid, argv[0], &started);
+        return pid;
+    }
+
+    if ((pid = fork()) < 0)
+        unix_error("fork error");
+    else if (pid == 0)
+    {
+        /*  把新建立的进程添加到新的进程组:
+            当从bash运行zsh时，zsh在bash前台进程组中运行。
+            如果zsh随后创建了一个子进程，默认情况下，该子进程也将是bash前台进程组的成员。
+            由于输入ctrl-c将向bash前台组中的每个进程发送一个SIGINT，
+            因此输入ctrl-c将向zsh以及zsh创建的每个进程发送一个SIGINT，这显然是不正确的。
+            这里有一个解决方案:在fork之后，但在execve之前，子进程应该调用setpgid(0,0)，
+            这将把子进程放入一个新的进程组中，该进程组的ID与子进程的PID相同。
+            这确保bash前台进程组中只有一个进程，即zsh进程。
+            当您键入ctrl-c时，zsh应该捕获结果SIGINT，然后将其转发到适当的前台作业
+            管道的后续阶段加入第一个阶段的进程组 pgid。
+        */
+        // 子进程的控制流开始
+        if (sigprocmask(SIG_UNBLOCK, set, NULL) < 0)
+            unix_error("sigprocmask error");
+        if (setpgid(0, pgid) < 0)
+        {
+            printf("setpgid error: %s\n", strerror(errno));
+            fflush(stdout);
+            _exit(1);
+        }
+        for (int i = 0; i < 3; i++)
+            if (fds[i] != i)
+                dup2(fds[i], i);
+        for (; keep && *keep >= 0; keep++)
+            fcntl(*keep, F_SETFD, 0);
+        if (attr)
+            apply_attr(attr);
+        if (text)
+        {
+            Signal(SIGINT, SIG_DFL);
+            Signal(SIGTSTP, SIG_DFL);
+            Signal(SIGCHLD, SIG_DFL);
+            Signal(SIGQUIT, SIG_DFL);
+            _exit(text_exec(argv));
+        }
+        if (env_eval(argv[0], argv, environ) < 0)
+        {
+            printf("%s: command not found\n", argv[0]);
+            fflush(stdout);
+            _exit(127);     /* exit() would flush the shell's stdio */
+        }
+    }
+    /* in the parent too: the next stage may join the group before the
+     * first one got to its own setpgid() */
+    setpgid(pid, pgid ? pgid : pid);
+    metrics_spawned(pid, argv[0], &started);
+    return pid;
 }
 
 /*
@@ -248,20 +708,39 @@ int env_eval(char *pathname, char **argv, char **environ)
     char* envs;
     char* env;
     const char* delim = ":";
+    const char *hashed;
 
     /* find environ[i], the environment variable PATH. */
     for (int i = 0; environ[i] != NULL; i++)
     {
-        if (!strncmp(environ[i], "PATH", 4))
+        if (!strncmp(environ[i], "PATH=", 5))
         {
             ind = i;
             break;
         }
     }
 
+    /* a path is run as it is, not looked up in $PATH */
+    if (strchr(pathname, '/'))
+        return execve(pathname, argv, environ) < 0 ? -1 : 0;
+
+    /* a command the startup snapshot hashed needs one execve() */
+    if (ind >= 0 && !strchr(pathname, '/')
+        && (hashed = rc_which(pathname, environ[ind] + 5)) != NULL)
+    {
+        argv[0] = (char *)hashed;
+        execve(hashed, argv, environ);
+        argv[0] = pathname;     /* gone since, search $PATH */
+    }
+
     /* loop env+pathname to execute. */
-    envs = strchr(environ[ind], '=') + 1;
-    env = strtok(envs, delim);
+    env = NULL;
+    if (ind >= 0)
+    {
+        /* strtok() on a copy, the program must still see the whole PATH */
+        envs = strdup(strchr(environ[ind], '=') + 1);
+        env = strtok(envs, delim);
+    }
     while (env && flag)
     {
         char* old_path = argv[0];
@@ -307,15 +786,19 @@ int parseline(const char *cmdline, char **argv)
     char *delim;                /* points to first space delimiter */
     int argc;                   /* number of args */
     int bg;                     /* background job? */
+    int quoted;                 /* is the arg in quotes? */
 
     strcpy(buf, cmdline);
     //buf[strlen(buf) - 1] = ' '; /* replace trailing '\n' with space */
+    /* the last arg needs a delimiter too, cmdlines split at ';' lack it */
+    if (*buf && buf[strlen(buf) - 1] != ' ' && strlen(buf) < MAXLINE - 1)
+        strcat(buf, " ");
     while (*buf && (*buf == ' ')) /* ignore leading spaces */
         buf++;
 
     /* Build the argv list */
     argc = 0;
-    if (*buf == '\'')
+    if ((quoted = (*buf == '\'')) != 0)
     {
         buf++;
         delim = strchr(buf, '\'');
@@ -327,13 +810,21 @@ int parseline(const char *cmdline, char **argv)
 
     while (delim)
     {
+        if (argc == MAXARGS - 1)
+        {
+            /* argv and parse_quoted[] hold MAXARGS words */
+            printf("%s: Argument list too long\n", argv[0]);
+            argv[0] = NULL;
+            return 1;
+        }
+        parse_quoted[argc] = quoted;
         argv[argc++] = buf;
         *delim = '\0';
         buf = delim + 1;
         while (*buf && (*buf == ' ')) /* ignore spaces */
             buf++;
 
-        if (*buf == '\'')
+        if ((quoted = (*buf == '\'')) != 0)
         {
             buf++;
             delim = strchr(buf, '\'');
@@ -364,11 +855,17 @@ int parseline(const char *cmdline, char **argv)
 int builtin_cmd(char **argv)
 {
     int argc = count_argv(argv);
+
+    builtin_status = 0;
     if (!strcmp(argv[0], "exit"))
     {
+        if (!exit_hook)     /* an embedded shell is not a session */
+            metrics_exit();
         puts("\033[1;32mGood bye from zsh!\033[00m");
         fflush(stdout);
-        exit(0);
+        if (exit_hook)
+            exit_hook(argc > 1 ? atoi(argv[1]) : last_status);
+        exit(argc > 1 ? atoi(argv[1]) : last_status);
     }
     else if (strchr(argv[0], '='))  /* set environ variable content */
     {
@@ -383,26 +880,41 @@ int builtin_cmd(char **argv)
             //printf("var: %s\n", var);
             //printf("val: %s\n", val);
             setenv(var, val, 1);
+            env_gen++;
         }
     }
-    else if (is_pipe(argv))  /* judge whether is a pipe command or not. */
-    {
-        char buf[MAXLINE] = {0};
-        for (int i = 0; argv[i]; i++)  /* combine into cmdline */
-        {
-            strcat(buf, argv[i]);
-            strcat(buf, " ");
-        }
-        command_pipe(buf);
-    }
+    else if (is_pipe(argv))  /* pipelines are started by launch_job() */
+        return 0;
     else if (!strcmp(argv[0], "bg") || !strcmp(argv[0], "fg"))
         do_bgfg(argv);
     else if (!strcmp(argv[0], "jobs"))
-        listjobs(jobs);
+        do_jobs(argc, argv);
     else if (!strcmp(argv[0], "pwd"))
         pwd(argc, argv);
     else if (!strcmp(argv[0], "cd"))
         cd(argc, argv);
+    else if (!strcmp(argv[0], "pushd"))
+        do_pushd(argc, argv);
+    else if (!strcmp(argv[0], "popd"))
+        do_popd(argc, argv);
+    else if (!strcmp(argv[0], "dirs"))
+        do_dirs(argc, argv);
+    else if (!strcmp(argv[0], "alias"))
+        do_alias(argc, argv);
+    else if (!strcmp(argv[0], "unalias"))
+        do_unalias(argc, argv);
+    else if (!strcmp(argv[0], "ulimit"))
+        do_ulimit(argc, argv);
+    else if (!strcmp(argv[0], "deadline"))
+        do_deadline(argc, argv);
+    else if (!strcmp(argv[0], "read"))
+        do_read(argc, argv);
+    else if (!strcmp(argv[0], "mapfile") || !strcmp(argv[0], "readarray"))
+        do_mapfile(argc, argv);
+    else if (!strcmp(argv[0], "printf"))
+        do_printf(argc, argv);
+    else if (!strcmp(argv[0], "stats"))
+        do_stats(argc, argv);
     else
     {
 #ifdef DEBUG
@@ -420,7 +932,7 @@ int is_pipe(char** argv)
 {
     for (int i = 0; argv[i]; i++)
     {
-        if (strchr(argv[i], '|'))
+        if (!strcmp(argv[i], "|"))
         {
             return 1;
         }
@@ -481,6 +993,13 @@ void do_bgfg(char **argv)
         }
     }
 
+    // 排队的作业还没有进程, 由 after 调度器启动
+    if (job->state == QU)
+    {
+        printf("%%%d: job is queued\n", job->jid);
+        return;
+    }
+
     if (!strcmp(argv[0], "bg"))
     {
         // bg会启动子进程，并将其放置于后台执行
@@ -506,19 +1025,74 @@ void do_bgfg(char **argv)
     return;
 }
 
+/*
+ * do_jobs - Execute the builtin jobs command:
+ *     jobs            list the jobs
+ *     jobs -l         list the jobs with CPU, memory, I/O and threads
+ *                     (also jobs --stats)
+ *     jobs -w N       the same, redrawn every N seconds until Enter
+ *     jobs -o %N [K]  print the last K bytes captured from job N (zsh -b),
+ *                     which may have finished already
+ */
+void do_jobs(int argc, char **argv)
+{
+    struct job_t *job;
+    sigset_t mask, prev;
+    double secs;
+
+    if (argc == 1)
+    {
+        listjobs(jobs);
+        capture_list();
+        return;
+    }
+    if (!strcmp(argv[1], "-l") || !strcmp(argv[1], "--stats"))
+    {
+        stats_list();
+        return;
+    }
+    if (!strcmp(argv[1], "-w") && argc > 2 && (secs = parse_duration(argv[2])) > 0)
+    {
+        stats_watch(secs);
+        return;
+    }
+    if (strcmp(argv[1], "-o") || argc < 3 || argv[2][0] != '%')
+    {
+        printf("usage: jobs [-l | -w secs | -o %%jobid [bytes]]\n");
+        return;
+    }
+
+    sigemptyset(&mask);
+    sigaddset(&mask, SIGCHLD);
+    sigprocmask(SIG_BLOCK, &mask, &prev);
+    // 已结束的作业, 它的输出仍保存在原来的作业槽中
+    if ((job = getjobjid(jobs, atoi(argv[2] + 1))) == NULL
+        && (job = capture_find(atoi(argv[2] + 1))) == NULL)
+        printf("%s: No such job\n", argv[2]);
+    else
+        capture_show(job, argc > 3 ? strtoul(argv[3], NULL, 10) : 0);
+    sigprocmask(SIG_SETMASK, &prev, NULL);
+}
+
 /*
  * waitfg - Block until process pid is no longer the foreground process
  */
 void waitfg(pid_t pid)
 {
-    struct job_t *job = getjobpid(jobs, pid);
-    if (!job)
-        return;
+    sigset_t mask, prev;
+    struct job_t *job;
 
-    // 如果当前子进程的状态没有发生改变，则zsh继续休眠
-    while (job->state == FG)
-        // 使用sleep的这段代码会比较慢，最好使用sigsuspend
-        sleep(1);
+    // 阻塞SIGCHLD后再检查作业状态，避免检查与休眠之间丢失信号
+    sigemptyset(&mask);
+    sigaddset(&mask, SIGCHLD);
+    sigprocmask(SIG_BLOCK, &mask, &prev);
+
+    // 如果当前子进程的状态没有发生改变，则zsh休眠，直到下一个信号或作业截止时间
+    job = getjobpid(jobs, pid);
+    while (job && job->pid == pid && job->state == FG)
+        wait_event(&prev);
+
+    sigprocmask(SIG_SETMASK, &prev, NULL);
 
     if (verbose)
         printf("waitfg: Process (%d) no longer the fg process\n", pid);
@@ -557,6 +1131,18 @@ void sigchld_handler(int sig)
     */
     while ((pid = waitpid(-1, &status, WNOHANG | WUNTRACED)) > 0)
     {
+        // 记录命令的耗时和退出状态
+        if (!WIFSTOPPED(status))
+            metrics_exited(pid, status);
+        // launcher 退出后，后续的命令直接 fork
+        if (pid == launcher_pid)
+        {
+            launcher_lost();
+            continue;
+        }
+        // 提示符的 git 助手进程, xargs 启动的命令
+        if (prompt_reaped(pid) || xargs_reaped(pid, status))
+            continue;
 
         // 如果当前这个子进程的job已经删除了，则表示有错误发生
         if ((job = getjobpid(jobs, pid)) == NULL)
@@ -569,11 +1155,30 @@ void sigchld_handler(int sig)
         // 如果这个子进程收到了一个暂停信号（还没退出
         if (WIFSTOPPED(status))
         {
-            printf("Job [%d] (%d) stopped by signal %d\n", jid, job->pid, WSTOPSIG(status));
+            // 管道的每个阶段都会停止，只报告一次
+            if (job->state != ST)
+                printf("Job [%d] (%d) stopped by signal %d\n", jid, job->pid, WSTOPSIG(status));
             job->state = ST;
+            continue;
         }
+
+        // 作业的退出状态取管道最后一个阶段的状态
+        if (pid == job->pids[job->nprocs - 1])
+            job->status = status;
+        // 管道中还有未退出的阶段，作业继续存在
+        if (--job->nlive > 0)
+            continue;
+
+        pid = job->pid;
+        status = job->status;
+        if (job->state == FG)
+            last_status = WIFEXITED(status) ? WEXITSTATUS(status) : 128 + WTERMSIG(status);
+        if (job->notify_fd >= 0)
+            server_notify(job);
+        // 等待这个作业的排队作业可以启动了 (或者要取消)
+        sched_done(job, WIFEXITED(status) && WEXITSTATUS(status) == 0);
         // 如果这个子进程正常退出
-        else if (WIFEXITED(status))
+        if (WIFEXITED(status))
         {
             if (deletejob(jobs, pid))
                 if (verbose)
@@ -590,7 +1195,9 @@ void sigchld_handler(int sig)
                 if (verbose)
                     printf("sigchld_handler: Job [%d] (%d) deleted\n", jid, pid);
             }
-            printf("Job [%d] (%d) terminated by signal %d\n", jid, pid, WTERMSIG(status));
+            // 和 bash 一样, 读者先退出而收到 SIGPIPE 的作业不报告
+            if (WTERMSIG(status) != SIGPIPE)
+                printf("Job [%d] (%d) terminated by signal %d\n", jid, pid, WTERMSIG(status));
         }
     }
 
@@ -629,6 +1236,12 @@ void sigint_handler(int sig)
             printf("sigint_handler: Job (%d) killed\n", pid);
         }
     }
+    // xargs 启动的命令不是作业, 也要收到 SIGINT
+    xargs_kill(SIGINT);
+    // zsh 自己执行的 wc, head 和 grep -F 也要停下
+    text_kill();
+    // on-change 不再等待下一次改动
+    onchange_kill();
 
     if (verbose)
         puts("sigint_handler: exiting");
@@ -672,22 +1285,41 @@ void sigtstp_handler(int sig)
  * Helper routines that manipulate the job list
  **********************************************/
 
-/* clearjob - Clear the entries in a job struct */
+/* clearjob - Clear the entries in a job struct. Capture state outlives
+ * the job until its pipe is drained, see capture.c */
 void clearjob(struct job_t *job)
 {
     job->pid = 0;
     job->jid = 0;
     job->state = UNDEF;
-    job->cmdline[0] = '\0';
+    job->nprocs = 0;
+    job->nlive = 0;
+    job->status = 0;
+    job->notify_fd = -1;
+    job->seq = 0;
+    job->scheduled = 0;
+    job->sched = NULL;
+    free(job->cmdline);
+    job->cmdline = NULL;
 }
 
-/* initjobs - Initialize the job list */
+/*
+ * initjobs - Initialize the job list. Slots are initialized by newjob()
+ *     when first used: clearing all of the table up front would cost the
+ *     shell's start a page fault per 4KB. Until then a slot is all
+ *     zeros, a free slot to every loop that only looks at jid, pid or
+ *     ring; loops that look at capfd or notify_fd stop at jobs_used.
+ */
 void initjobs(struct job_t *jobs)
 {
     int i;
 
-    for (i = 0; i < MAXJOBS; i++)
+    for (i = 0; i < jobs_used; i++)
+    {
         clearjob(&jobs[i]);
+        jobs[i].capfd = -1;
+        jobs[i].ring = NULL;
+    }
 }
 
 /* maxjid - Returns largest allocated job ID */
@@ -704,30 +1336,72 @@ int maxjid(struct job_t *jobs)
 /* addjob - Add a job to the job list */
 int addjob(struct job_t *jobs, pid_t pid, int state, char *cmdline)
 {
-    int i;
-
     if (pid < 1)
         return 0;
+    return newjob(jobs, pid, state, cmdline) != NULL;
+}
+
+/* newjob - Add a job to the job list and return it; a queued (QU) job
+ * has no process yet and pid 0 */
+struct job_t *newjob(struct job_t *jobs, pid_t pid, int state, char *cmdline)
+{
+    static unsigned long seq = 0;
+    int i;
 
+    /* prefer a slot that does not keep the output of a finished job */
     for (i = 0; i < MAXJOBS; i++)
     {
-        if (jobs[i].pid == 0)
+        if (i == jobs_used)
+        {
+            clearjob(&jobs[i]);
+            jobs[i].capfd = -1;
+            jobs[i].ring = NULL;
+            jobs_used++;
+        }
+        if (jobs[i].jid == 0 && jobs[i].ring == NULL)
+            break;
+    }
+    for (i = i < MAXJOBS ? i : 0; i < jobs_used; i++)
+    {
+        if (jobs[i].jid == 0)
         {
-            jobs[i].pid = pid;
-            jobs[i].state = state;
+            capture_release(&jobs[i]);
+            startjob(&jobs[i], pid, state);
+            jobs[i].seq = ++seq;
             jobs[i].jid = nextjid++;
             if (nextjid > MAXJOBS)
                 nextjid = 1;
-            strcpy(jobs[i].cmdline, cmdline);
+            if ((jobs[i].cmdline = strdup(cmdline)) == NULL)
+                unix_error("strdup error");
             if (verbose)
             {
                 printf("Added job [%d] %d %s\n", jobs[i].jid, jobs[i].pid, jobs[i].cmdline);
             }
-            return 1;
+            return &jobs[i];
         }
     }
     printf("Tried to create too many jobs\n");
-    return 0;
+    return NULL;
+}
+
+/* startjob - Give a job its first process, which leads its process group */
+void startjob(struct job_t *job, pid_t pid, int state)
+{
+    job->pid = pid;
+    job->pids[0] = pid;
+    job->nprocs = pid ? 1 : 0;
+    job->nlive = pid ? 1 : 0;
+    job->state = state;
+}
+
+/* addjobproc - Add another pipeline stage to a job */
+void addjobproc(struct job_t *job, pid_t pid)
+{
+    if (job->nprocs < MAXPIPE)
+    {
+        job->pids[job->nprocs++] = pid;
+        job->nlive++;
+    }
 }
 
 /* deletejob - Delete a job whose PID=pid from the job list */
@@ -750,6 +1424,17 @@ int deletejob(struct job_t *jobs, pid_t pid)
     return 0;
 }
 
+/* freejobs - Return the number of free slots in the job list */
+int freejobs(struct job_t *jobs)
+{
+    int i, n = 0;
+
+    for (i = 0; i < MAXJOBS; i++)
+        if (jobs[i].jid == 0)
+            n++;
+    return n;
+}
+
 /* fgpid - Return PID of current foreground job, 0 if no such job */
 pid_t fgpid(struct job_t *jobs)
 {
@@ -761,16 +1446,17 @@ pid_t fgpid(struct job_t *jobs)
     return 0;
 }
 
-/* getjobpid  - Find a job (by PID) on the job list */
+/* getjobpid  - Find a job (by the PID of any of its processes) on the job list */
 struct job_t *getjobpid(struct job_t *jobs, pid_t pid)
 {
-    int i;
+    int i, j;
 
     if (pid < 1)
         return NULL;
     for (i = 0; i < MAXJOBS; i++)
-        if (jobs[i].pid == pid)
-            return &jobs[i];
+        for (j = 0; j < jobs[i].nprocs; j++)
+            if (jobs[i].pids[j] == pid)
+                return &jobs[i];
     return NULL;
 }
 
@@ -809,7 +1495,7 @@ void listjobs(struct job_t *jobs)
 
     for (i = 0; i < MAXJOBS; i++)
     {
-        if (jobs[i].pid != 0)
+        if (jobs[i].jid != 0)
         {
             printf("[%d] (%d) ", jobs[i].jid, jobs[i].pid);
             switch (jobs[i].state)
@@ -823,6 +1509,9 @@ void listjobs(struct job_t *jobs)
             case ST:
                 printf("Stopped ");
                 break;
+            case QU:
+                printf("Queued ");
+                break;
             default:
                 printf("listjobs: Internal error: job[%d].state=%d ",
                        i, jobs[i].state);
@@ -844,10 +1533,18 @@ void listjobs(struct job_t *jobs)
  */
 void usage(void)
 {
-    printf("Usage: zsh [-hvp]\n");
+    printf("Usage: zsh [-hvpzbfs] [-S socket] [-R file] [--replay file [--timed]]\n");
     printf("   -h   print this message\n");
     printf("   -v   print additional diagnostic information\n");
     printf("   -p   do not emit a command prompt\n");
+    printf("   -z   spawn commands through a pre-forked launcher\n");
+    printf("   -b   capture output of background jobs, see jobs -o\n");
+    printf("   -f   do not read ~/.zshrc (~/.zshenv with -p or -S)\n");
+    printf("   -s   read the startup file and write a snapshot of it\n");
+    printf("   -S   serve scripts sent by zshc on a Unix socket\n");
+    printf("   -R   record the input lines, their times and statuses into file\n");
+    printf("   --replay  run the lines of a recording, and report on the times\n");
+    printf("   --timed   with --replay, each line at the time it was recorded\n");
     exit(1);
 }
 
@@ -901,193 +1598,3 @@ void sigquit_handler(int sig)
  * End other helper routines
  **************************/
 
-
-/***********************
- * More builtin commands
- **********************/
-
-/*
- * get_pwd - Check PWD in environ and store it to global cur_dir.
- */
-void get_pwd(void)
-{
-    char* temp;
-
-    for (int i = 0; environ[i]; i++)
-    {
-        if (!strncmp(environ[i], "PWD", 3))
-        {
-            temp = strchr(environ[i], '=') + 1;
-            memset(cur_dir, 0, MAXLINE);
-            strcpy(cur_dir, temp);
-            break;
-        }
-    }
-}
-
-void pwd(int argc, char** argv)
-{
-    get_pwd();
-    // getcwd(cur_dir, sizeof(cur_dir));
-    printf("%s\n", cur_dir);
-}
-
-void cd(int argc, char** argv) {
-    struct passwd *username;
-    username = getpwuid(getuid());
-
-    if (argc == 1) {  /* cd: change directory to /home/username */
-        if (!strcmp(username->pw_name, "root")) {
-            strcpy(prev_dir, cur_dir);
-            #ifdef CD_DEBUG
-            printf("previous: %s\n", previous);
-            #endif
-            chdir("/root");
-        } else {
-            char home[MAXLINE];
-            sprintf(home, "/home/%s", username->pw_name);
-            strcpy(prev_dir, cur_dir);
-            #ifdef CD_DEBUG
-            printf("previous: %s\n", previous);
-            #endif
-            chdir(home);
-        }
-    }
-
-    if (argc == 2) {
-        if (!strcmp(argv[1], "~")) {
-            char home[MAXLINE];
-            sprintf(home, "/home/%s", username->pw_name);
-
-            strcpy(prev_dir, cur_dir);
-            #ifdef CD_DEBUG
-            printf("previous: %s\n", previous);
-            #endif
-            chdir(home);
-        } else if (!strcmp(argv[1], "-")) {
-            char temp[MAXLINE];
-            strcpy(temp, cur_dir);
-
-            #ifdef CD_DEBUG
-            printf("previous: %s\n", previous);
-            #endif
-            chdir(prev_dir);
-            strcpy(prev_dir, temp);
-        } else {
-            #ifdef CD_DEBUG
-            printf("previous: %s\n", previous);
-            #endif
-            chdir(argv[1]);
-            strcpy(prev_dir, argv[1]);
-        }
-    }
-
-    /* Update environ variable PWD. */
-    getcwd(cur_dir, sizeof(cur_dir));
-    setenv("PWD", cur_dir, 1);
-}
-
-int command_pipe(char buf[MAXLINE]) {
-    int i, j;
-    // 获取管道符号的位置索引
-    for(j = 0; buf[j] != '\0'; j++) {
-        if (buf[j] == '|')
-            break;
-    }
-
-    //printf("[*] this is command_pip, buf: %s\n", buf);
-
-    // 分离指令, 将管道符号前后的指令存放在两个数组中
-    // outputBuf存放管道前的命令, inputBuf存放管道后的命令
-    char outputBuf[j+1];
-    memset(outputBuf, 0x00, j+1);
-    char inputBuf[strlen(buf) - j];
-    memset(inputBuf, 0x00, strlen(buf) - j);
-    for (i = 0; i < j - 1; i++) {
-        outputBuf[i] = buf[i];
-    }
-    outputBuf[j - 1] = ' ';
-    for (i = 0; i < strlen(buf) - j - 1; i++) {
-        inputBuf[i] = buf[j + 2 + i];
-    }
-
-    // printf("[*] |_left: %s, |_right: %s\n", outputBuf, inputBuf);
-    // char* temp[MAXARGS];
-    // parseline(outputBuf, temp);
-    // for (int i = 0; temp[i]; i++)
-    //     printf("[!] temp[%d] = %s\n", i, temp[i]);
-
-    // char* temp2[MAXARGS];
-    // parseline(inputBuf, temp2);
-    // for (int i = 0; temp2[i]; i++)
-    //     printf("[!] temp2[%d] = %s\n", i, temp2[i]);
-
-    int pd[2];
-    pid_t pid;
-    if (pipe(pd) < 0) {
-        perror("pipe()");
-        exit(1);
-    }
-
-    pid = fork();
-    if (pid < 0) {
-        perror("fork()");
-        exit(1);
-    }
-
-    if (pid == 0) {                     // 子进程写管道
-        //printf("[*] (left) entering subprocess\n");
-
-        char* argv[MAXARGS];
-
-        close(pd[0]);                   // 关闭子进程的读端
-        dup2(pd[1], STDOUT_FILENO);     // 将子进程的写端作为标准输出
-        parseline(outputBuf, argv);
-
-        // for (int i = 0; argv[i]; i++)
-        //     printf("[*] (left) argv[0] = %s\n", argv[0]);
-
-        //execvp(argv[0], argv);
-        env_eval(argv[0], argv, environ);
-
-        if (pd[1] != STDOUT_FILENO) {
-            close(pd[1]);
-        }
-
-        //printf("[*] (left) exiting subprocess\n");
-    } else {                              // 父进程读管道
-        //printf("[*] (right) entering process\n");
-        /** 关键代码
-         *  子进程写管道完毕后再执行父进程读管道, 
-         *  所以需要用wait函数等待子进程返回后再操作
-         */
-        char* argv[MAXARGS];
-        int status;
-        waitpid(pid, &status, 0);       // 等待子进程返回
-        int err = WEXITSTATUS(status);  // 读取子进程的返回码
-        if (err) { 
-            printf("Error: %s\n", strerror(err));
-        }
-
-        close(pd[1]);                    // 关闭父进程管道的写端
-        dup2(pd[0], STDIN_FILENO);       // 管道读端读到的重定向为标准输入
-        parseline(inputBuf, argv);
-
-        // for (int i = 0; argv[i]; i++)
-        //     printf("[*] (right) argv[0] = %s\n", argv[0]);
-
-        //execvp(argv[0], argv);
-        env_eval(argv[0], argv, environ);
-
-        if (pd[0] != STDIN_FILENO) {
-            close(pd[0]);
-        }
-
-        //sprintf("[*] (right) exiting subprocess\n");
-    }
-    return 0;
-}
-
-/***************************
- * End more builtin commands
- **************************/
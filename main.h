@@ -5,6 +5,7 @@
 *
 * file: main.h
 */
+#define _GNU_SOURCE
 #include <stdio.h>
 #include <stdlib.h>
 #include <unistd.h>
@@ -16,44 +17,101 @@
 #include <sys/wait.h>
 #include <errno.h>
 #include <pwd.h>
+#include <fcntl.h>
+#include <sched.h>
+#include <sys/resource.h>
+#include <time.h>
 
 /* Misc manifest constants */
-#define MAXLINE    1024   /* max line size */
+#define MAXLINE   16384   /* max line size */
+#define MAXPATH    4096   /* max path size */
 #define MAXARGS     128   /* max args on a command line */
-#define MAXJOBS      16   /* max jobs at any point in time */
+#define MAXJOBS    1024   /* max jobs at any point in time */
 #define MAXJID    1<<16   /* max job ID */
+#define MAXPIPE      16   /* max stages in a pipeline */
 
 /* Job states */
 #define UNDEF 0 /* undefined */
 #define FG 1    /* running in foreground */
 #define BG 2    /* running in background */
 #define ST 3    /* stopped */
+#define QU 4    /* queued by after, no process yet */
 
 /*
-* Jobs states: FG (foreground), BG (background), ST (stopped)
+* Jobs states: FG (foreground), BG (background), ST (stopped), QU (queued)
 * Job state transitions and enabling actions:
 *     FG -> ST  : ctrl-z
 *     ST -> FG  : fg command
 *     ST -> BG  : bg command
 *     BG -> FG  : fg command
+*     QU -> BG  : the jobs it waits for succeeded (after command)
 * At most 1 job can be in the FG state.
 */
 
 /* Definition of job */
 struct job_t {              /* The job struct */
-    pid_t pid;              /* job PID */
+    pid_t pid;              /* job PID, also the process group ID */
     int jid;                /* job ID [1, 2, ...] */
-    int state;              /* UNDEF, BG, FG, or ST */
-    char cmdline[MAXLINE];  /* command line */
+    int state;              /* UNDEF, BG, FG, ST or QU */
+    int nprocs;             /* number of processes (pipeline stages) */
+    int nlive;              /* processes not reaped yet */
+    pid_t pids[MAXPIPE];    /* every process of the job, pids[0] == pid */
+    int status;             /* wait status of the last stage */
+    int notify_fd;          /* server client waiting for the status, or -1 */
+    int capfd;              /* pipe with the job's captured output, or -1 */
+    struct ring *ring;      /* last bytes of the captured output */
+    unsigned long seq;      /* never reused, unlike jid and pid */
+    int scheduled;          /* started by the after scheduler */
+    struct sched *sched;    /* the queued command of a QU job */
+    char *cmdline;          /* command line, malloc'd; NULL in a free slot */
+};
+
+/* Resource limits and CPU placement for the processes of one job */
+#define NLIMITS      4              /* cpu time, address space, files, procs */
+#define ATTR_NICE   (1 << NLIMITS)  /* spawn_attr.set: nice is valid */
+#define ATTR_CPUS   (2 << NLIMITS)  /* spawn_attr.set: cpus is valid */
+
+struct spawn_attr {
+    int set;                    /* bit i: rlim[i] is valid, plus ATTR_* */
+    struct rlimit rlim[NLIMITS];
+    int nice;                   /* nice increment */
+    cpu_set_t cpus;             /* allowed CPUs */
+    int spread;                 /* pin stage i to the i-th CPU of cpus */
+    double timeout;             /* job deadline in seconds, 0 for none */
+    double grace;               /* seconds from SIGTERM to SIGKILL */
+};
+
+/* Here-documents and process substitution of one command line */
+#define MAXSUBST      8   /* max <(cmd) and >(cmd) per command line */
+#define MAXSUBARGS   32   /* max args of the cmd of one of them */
+
+struct subst {
+    int stage;                  /* pipeline stage that names it */
+    int out;                    /* >(cmd): cmd reads what the stage writes */
+    int fd;                     /* the stage's end of the pipe */
+    int subfd;                  /* cmd's end of the pipe */
+    int argc;
+    char *argv[MAXSUBARGS];
+    char path[24];              /* /dev/fd/N, the stage's argument */
+};
+
+struct redir {
+    int in[MAXPIPE];            /* stdin of stage i: a file or here-document, or -1 */
+    int out;                    /* stdout of the last stage (coproc), or -1 */
+    int nsub;
+    struct subst sub[MAXSUBST];
 };
 
 /* Function prototypes */
 
 /* Key functions */
 void eval(char *cmdline);
+void eval_words(char **argv, int state, char *cmdline);
+void eval_lines(char *cmdlines);
 int env_eval(char *pathname, char **argv, char **environ);
 int  builtin_cmd(char **argv);
 void do_bgfg(char **argv);
+void do_jobs(int argc, char **argv);
 void waitfg(pid_t pid);
 
 void sigchld_handler(int sig);
@@ -61,23 +119,178 @@ void sigtstp_handler(int sig);
 void sigint_handler(int sig);
 
 /* Builtin commands */
-void pwd(int argc, char** argv);
-void get_pwd(void);
-void print_prompt(void);
-void cd(int argc, char** argv);
 int count_argv(char** argv);
-int command_pipe(char buf[MAXLINE]);
 int is_pipe(char** argv);
 
+/* Working directory and directory stack */
+void dirs_init(void);
+const char *home_dir(void);
+void pwd(int argc, char **argv);
+void cd(int argc, char **argv);
+void do_pushd(int argc, char **argv);
+void do_popd(int argc, char **argv);
+void do_dirs(int argc, char **argv);
+
+/* Process launching */
+pid_t launch_job(char **argv, int state, char *cmdline, struct spawn_attr *attr,
+                 struct job_t *slot, struct redir *r);
+pid_t start_job(char **argv, int state, char *cmdline, struct spawn_attr *attr,
+                struct job_t *slot, struct redir *r);
+int stage_input(char **argv, int at, char *cmdline, struct redir *r, pid_t *pgid);
+char **job_prefixes(char **argv, struct spawn_attr *attr);
+pid_t spawn(char **argv, int fds[3], pid_t pgid, sigset_t *set, struct spawn_attr *attr,
+            const int *keep);
+void launcher_start(void);
+void launcher_lost(void);
+pid_t launcher_spawn(char **argv, char **envp, int fds[3], pid_t pgid, const char *cwd,
+                     struct spawn_attr *attr);
+void launcher_limit(struct spawn_attr *attr);
+extern pid_t launcher_pid;
+extern int env_gen;          /* bump after every change to environ */
+
+/* Resource limits */
+int limit_prefix(char **argv, struct spawn_attr *attr);
+void stage_attr(const struct spawn_attr *attr, int i, struct spawn_attr *out);
+void apply_attr(const struct spawn_attr *attr);
+void do_ulimit(int argc, char **argv);
+
+/* Here-documents and process substitution */
+int redir_parse(char **argv, struct redir *r);
+int redir_used(struct redir *r);
+void redir_close(struct redir *r);
+void redir_input(char *(*fn)(char *buf, int size));
+
+/* Prompt segments */
+struct pollfd;
+void print_prompt(void);
+const char *prompt_string(void);
+void prompt_update(void);
+void prompt_begin(void);
+void prompt_end(void);
+int prompt_pollfds(struct pollfd *pfd);
+void prompt_drain(void);
+int prompt_reaped(pid_t pid);
+
+/* Line editor */
+int edit_line(const char *(*prompt)(void), char *buf, int size);
+
+/* Coprocesses, read, mapfile, printf and arrays */
+void do_coproc(char **argv, char *cmdline, struct redir *r);
+void io_own(int fd);
+void io_forget(int fd);
+void io_sync(void);
+void do_read(int argc, char **argv);
+void do_mapfile(int argc, char **argv);
+int array_set(const char *name, char *data, char **items, size_t n);
+const char *array_expand(const char *word);
+void do_printf(int argc, char **argv);
+
+/* xargs */
+int xargs_stage(char **argv);
+void do_xargs(char **argv, int at, char *cmdline, struct redir *r);
+int xargs_reaped(pid_t pid, int status);
+void xargs_kill(int sig);
+
+/* wc, head and grep -F */
+int text_cmd(char **argv);
+int text_exec(char **argv);
+int text_stage(char **argv);
+void do_text(char **argv, int at, char *cmdline, struct redir *r);
+void text_kill(void);
+
+/* on-change */
+void do_onchange(char **argv, char *cmdline, struct redir *r);
+void onchange_kill(void);
+
+/* Aliases */
+int alias_define(const char *name, const char *value);
+void alias_each(void (*fn)(const char *name, const char *value, void *arg), void *arg);
+int alias_expand(char **argv, char *quoted);
+void do_alias(int argc, char **argv);
+void do_unalias(int argc, char **argv);
+
+/* Pathname expansion */
+char **glob_argv(char **argv, const char *quoted);
+
+/* Job deadlines */
+double parse_duration(const char *s);
+void set_deadline(struct job_t *job, double secs, double grace);
+void clear_deadline(struct job_t *job);
+void timers_run(void);
+void service_events(void);
+void wait_event(sigset_t *prev);
+int wait_input(int fd, int ms);
+int timeout_prefix(char **argv, struct spawn_attr *attr);
+void do_deadline(int argc, char **argv);
+
+/* The shell's own stdin */
+char *in_gets(char *buf, int size);
+size_t in_buffered(void);
+size_t in_take(char *buf, size_t size);
+
+/* Output capture of background jobs */
+void capture_attach(struct job_t *job, int fd);
+void capture_release(struct job_t *job);
+int capture_pollfds(struct pollfd *pfd);
+void capture_drain(void);
+void capture_show(struct job_t *job, size_t k);
+struct job_t *capture_find(int jid);
+void capture_list(void);
+extern int capture_on;
+
+/* Job dependencies */
+void do_after(char **argv, char *cmdline);
+void sched_done(struct job_t *job, int ok);
+void sched_run(void);
+int sched_queued(void);
+void sched_wait(void);
+void sched_forget(void);
+
+/* Job statistics */
+void stats_list(void);
+void stats_watch(double secs);
+
+/* Session recording and replay */
+void record_open(const char *path);
+void replay_open(const char *path, int timed);
+int replay_next(char *buf, int size);
+void record_begin(const char *line);
+void record_end(int status);
+
+/* Command metrics */
+void metrics_spawned(pid_t pid, const char *name, const struct timespec *started);
+void metrics_exited(pid_t pid, int status);
+void metrics_exit(void);
+void do_stats(int argc, char **argv);
+
+/* Startup files and their snapshots */
+int rc_map(int interactive);
+void rc_load(int interactive, int snapshot);
+const char *rc_which(const char *name, const char *path);
+
+/* Command server */
+void server_run(const char *path);
+void server_notify(struct job_t *job);
+int eval_script(char *script);
+extern int last_status;      /* exit status of the last foreground job */
+extern int builtin_status;   /* set by a builtin that fails */
+extern int builtin_in;       /* stdin of the builtin, from < or <<, or -1 */
+extern void (*exit_hook)(int status);   /* the exit builtin leaves here, if set */
+
 /* Here are more helper routines */
 int  parseline(const char *cmdline, char **argv);
 void sigquit_handler(int sig);
 
+extern int jobs_used;         /* slots of the job list initialized so far */
 void clearjob(struct job_t *job);
 void initjobs(struct job_t *jobs);
 int maxjid(struct job_t *jobs);
 int addjob(struct job_t *jobs, pid_t pid, int state, char *cmdline);
+struct job_t *newjob(struct job_t *jobs, pid_t pid, int state, char *cmdline);
+void startjob(struct job_t *job, pid_t pid, int state);
+void addjobproc(struct job_t *job, pid_t pid);
 int deletejob(struct job_t *jobs, pid_t pid);
+int freejobs(struct job_t *jobs);
 pid_t fgpid(struct job_t *jobs);
 struct job_t *getjobpid(struct job_t *jobs, pid_t pid);
 struct job_t *getjobjid(struct job_t *jobs, int jid);
@@ -0,0 +1,373 @@
+/*
+ * zsh - A mini shell program
+ * NKU OS Course
+ * Shuhao Zhang
+ *
+ * file: metrics.c
+ *
+ * Always-on command metrics: for every command name the shell started
+ * (its argv[0] after aliases, without the directory), how many runs, a
+ * histogram of the time from fork to exit, the counts of each exit
+ * status (128+N for signal N) and how many runs failed to find the
+ * command. The child reports a failed lookup, env_eval() returning -1,
+ * by exiting with 127, so those are the runs that exit 127; they are
+ * left out of the latency histogram.
+ *
+ *     stats               p50, p99 and max latency per command
+ *     stats -j [file]     everything as JSON, to stdout or file
+ *     stats -r            forget what was recorded
+ *
+ * At exit (the exit builtin and end of input) the shell writes the JSON
+ * to $ZSH_STATS, or ~/.zsh_stats.json, if it ran any command.
+ *
+ * The histograms are HDR-style: 16 linear buckets per power of two of
+ * microseconds, so every value is kept to within 1/16 (about 6%) from
+ * 1us to days, in a fixed array of counters. Recording a run is a table
+ * lookup and two increments done by the SIGCHLD handler, with nothing
+ * allocated: the entry of a command is made by spawn(), with SIGCHLD
+ * blocked.
+ */
+#include "main.h"
+#include <time.h>
+
+#define SUB_BITS   4                        /* 16 buckets per power of two */
+#define SUB        (1 << SUB_BITS)
+#define MAX_BITS   40                       /* 2^40us, 12 days */
+#define NBUCKET    ((MAX_BITS - SUB_BITS + 1) * SUB)
+#define NCMD       256                      /* command names, then "(other)" */
+#define NLIVE      1024                     /* processes not reaped yet */
+#define NOT_FOUND  127
+
+/* The metrics of one command name */
+struct cmdstat {
+    char name[64];
+    unsigned long runs;
+    unsigned long not_found;
+    unsigned long long max_us;
+    unsigned long long sum_us;
+    unsigned int codes[256];                /* runs by exit status */
+    unsigned int hist[NBUCKET];             /* runs by latency bucket */
+};
+
+/* A process started by spawn(), until it is reaped */
+struct live {
+    pid_t pid;                              /* 0: free, -1: was used */
+    struct cmdstat *cmd;
+    struct timespec started;
+};
+
+static struct cmdstat *cmds[NCMD + 1];      /* hashed by name, [NCMD] is "(other)" */
+static struct live live[NLIVE];
+static int recorded;                        /* a run was recorded */
+
+/* bucket - The histogram bucket of us microseconds */
+static int bucket(unsigned long long us)
+{
+    int shift;
+
+    if (us < SUB)
+        return us;
+    shift = 63 - __builtin_clzll(us) - SUB_BITS;
+    if (shift >= MAX_BITS - SUB_BITS)
+        return NBUCKET - 1;
+    return (shift + 1) * SUB + (us >> shift) - SUB;
+}
+
+/* bucket_top - The largest value that falls into bucket i */
+static unsigned long long bucket_top(int i)
+{
+    int shift = i / SUB - 1;
+
+    if (i < SUB)
+        return i;
+    return (((unsigned long long)(i % SUB + SUB + 1)) << shift) - 1;
+}
+
+/* percentile - The latency that p of the runs of c stay within */
+static unsigned long long percentile(const struct cmdstat *c, double p)
+{
+    unsigned long long n = 0, want;
+    unsigned long found = c->runs - c->not_found;
+    unsigned long long top;
+
+    if (!found)
+        return 0;
+    want = (unsigned long long)(p * found + 0.999999);
+    if (want < 1)
+        want = 1;
+    for (int i = 0; i < NBUCKET; i++)
+        if ((n += c->hist[i]) >= want)
+        {
+            top = bucket_top(i);
+            return top < c->max_us ? top : c->max_us;
+        }
+    return c->max_us;
+}
+
+/* lookup - The entry of command name, made if need be */
+static struct cmdstat *lookup(const char *name)
+{
+    const char *slash = strrchr(name, '/');
+    unsigned h = 2166136261u;
+    int i;
+
+    if (slash && slash[1])
+        name = slash + 1;
+    for (const char *p = name; *p; p++)
+        h = (h ^ (unsigned char)*p) * 16777619u;
+    for (int n = 0; n < NCMD; n++)
+    {
+        i = (h + n) % NCMD;
+        if (!cmds[i])
+        {
+            if ((cmds[i] = calloc(1, sizeof(struct cmdstat))) == NULL)
+                break;
+            snprintf(cmds[i]->name, sizeof(cmds[i]->name), "%s", name);
+            return cmds[i];
+        }
+        if (!strncmp(cmds[i]->name, name, sizeof(cmds[i]->name) - 1))
+            return cmds[i];
+    }
+    /* the table is full */
+    if (!cmds[NCMD] && (cmds[NCMD] = calloc(1, sizeof(struct cmdstat))) != NULL)
+        strcpy(cmds[NCMD]->name, "(other)");
+    return cmds[NCMD];
+}
+
+/*
+ * metrics_spawned - spawn() started argv[0] as pid at started. Called
+ *     with SIGCHLD blocked.
+ */
+void metrics_spawned(pid_t pid, const char *name, const struct timespec *started)
+{
+    struct cmdstat *c;
+    int i;
+
+    if (pid <= 0 || (c = lookup(name)) == NULL)
+        return;
+    for (int n = 0; n < NLIVE; n++)
+    {
+        i = (pid + n) % NLIVE;
+        if (live[i].pid <= 0)
+        {
+            live[i].pid = pid;
+            live[i].cmd = c;
+            live[i].started = *started;
+            return;
+        }
+    }
+}
+
+/*
+ * metrics_exited - Record the run of pid, which exited or was killed
+ *     with wait status status. Called by the SIGCHLD handler for every
+ *     child it reaps; pids spawn() did not start are ignored.
+ */
+void metrics_exited(pid_t pid, int status)
+{
+    struct timespec now;
+    struct cmdstat *c;
+    unsigned long long us;
+    int i, code;
+
+    for (int n = 0; n < NLIVE; n++)
+    {
+        i = (pid + n) % NLIVE;
+        if (live[i].pid == 0)
+            return;
+        if (live[i].pid == pid)
+            break;
+    }
+    if (live[i].pid != pid)
+        return;
+    live[i].pid = -1;
+    c = live[i].cmd;
+
+    code = WIFEXITED(status) ? WEXITSTATUS(status) : 128 + WTERMSIG(status);
+    c->runs++;
+    c->codes[code & 255]++;
+    recorded = 1;
+    if (code == NOT_FOUND)
+    {
+        c->not_found++;
+        return;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    us = (now.tv_sec - live[i].started.tv_sec) * 1000000ULL
+         + (now.tv_nsec - live[i].started.tv_nsec) / 1000;
+    c->hist[bucket(us)]++;
+    c->sum_us += us;
+    if (us > c->max_us)
+        c->max_us = us;
+}
+
+/* fmt_us - Format microseconds: 850us, 3.2ms, 1.50s */
+static char *fmt_us(char *buf, unsigned long long us)
+{
+    if (us < 1000)
+        sprintf(buf, "%lluus", us);
+    else if (us < 1000000)
+        sprintf(buf, us < 10000 ? "%.1fms" : "%.0fms", us / 1e3);
+    else
+        sprintf(buf, "%.2fs", us / 1e6);
+    return buf;
+}
+
+/* json_string - Write s as a JSON string */
+static void json_string(FILE *f, const char *s)
+{
+    fputc('"', f);
+    for (; *s; s++)
+    {
+        if (*s == '"' || *s == '\\')
+            fprintf(f, "\\%c", *s);
+        else if ((unsigned char)*s < 0x20)
+            fprintf(f, "\\u%04x", *s);
+        else
+            fputc(*s, f);
+    }
+    fputc('"', f);
+}
+
+/* write_json - Write the metrics of every command to f */
+static void write_json(FILE *f)
+{
+    const struct cmdstat *c;
+    unsigned long found;
+    int first = 1, sep;
+
+    fprintf(f, "{\"unit\": \"us\", \"commands\": [");
+    for (int i = 0; i <= NCMD; i++)
+    {
+        if ((c = cmds[i]) == NULL || !c->runs)
+            continue;
+        found = c->runs - c->not_found;
+        fprintf(f, "%s\n  {\"name\": ", first ? "" : ",");
+        first = 0;
+        json_string(f, c->name);
+        fprintf(f, ", \"runs\": %lu, \"not_found\": %lu, \"p50\": %llu, \"p99\": %llu, "
+                "\"max\": %llu, \"mean\": %llu,\n   \"exit\": {",
+                c->runs, c->not_found, percentile(c, 0.5), percentile(c, 0.99),
+                c->max_us, found ? c->sum_us / found : 0);
+        sep = 0;
+        for (int j = 0; j < 256; j++)
+            if (c->codes[j])
+                fprintf(f, "%s\"%d\": %u", sep++ ? ", " : "", j, c->codes[j]);
+        /* [largest value of the bucket, runs] for the buckets used */
+        fprintf(f, "},\n   \"histogram\": [");
+        sep = 0;
+        for (int j = 0; j < NBUCKET; j++)
+            if (c->hist[j])
+                fprintf(f, "%s[%llu, %u]", sep++ ? ", " : "", bucket_top(j), c->hist[j]);
+        fprintf(f, "]}");
+    }
+    fprintf(f, "\n]}\n");
+}
+
+/* list - Print p50, p99 and max latency of every command */
+static void list(void)
+{
+    char p50[16], p99[16], max[16];
+    const struct cmdstat *c;
+
+    printf("%-20s %7s %7s %7s %8s %8s %8s\n",
+           "COMMAND", "RUNS", "FAILED", "NOTFND", "P50", "P99", "MAX");
+    for (int i = 0; i <= NCMD; i++)
+    {
+        if ((c = cmds[i]) == NULL || !c->runs)
+            continue;
+        printf("%-20s %7lu %7lu %7lu ", c->name, c->runs,
+               c->runs - c->codes[0] - c->not_found, c->not_found);
+        if (c->runs == c->not_found)
+            printf("%8s %8s %8s\n", "-", "-", "-");
+        else
+            printf("%8s %8s %8s\n", fmt_us(p50, percentile(c, 0.5)),
+                   fmt_us(p99, percentile(c, 0.99)), fmt_us(max, c->max_us));
+    }
+}
+
+/* dump - Write the JSON to path, replacing it at once. 0 or -1. */
+static int dump(const char *path)
+{
+    char tmp[MAXPATH + 16];
+    FILE *f;
+
+    /* per process: two shells exiting at once must not share it */
+    snprintf(tmp, sizeof(tmp), "%s.%d", path, getpid());
+    if ((f = fopen(tmp, "w")) == NULL)
+        return -1;
+    write_json(f);
+    if (fclose(f) == EOF || rename(tmp, path) < 0)
+    {
+        unlink(tmp);
+        return -1;
+    }
+    return 0;
+}
+
+/*
+ * do_stats - Execute the builtin stats command
+ */
+void do_stats(int argc, char **argv)
+{
+    sigset_t mask, prev;
+
+    sigemptyset(&mask);
+    sigaddset(&mask, SIGCHLD);
+    sigprocmask(SIG_BLOCK, &mask, &prev);
+
+    if (argc == 1)
+        list();
+    else if (!strcmp(argv[1], "-j") && argc == 2)
+        write_json(stdout);
+    else if (!strcmp(argv[1], "-j") && argc == 3)
+    {
+        if (dump(argv[2]) < 0)
+        {
+            printf("stats: %s: %s\n", argv[2], strerror(errno));
+            builtin_status = 1;
+        }
+    }
+    else if (!strcmp(argv[1], "-r") && argc == 2)
+    {
+        for (int i = 0; i <= NCMD; i++)
+            if (cmds[i])
+            {
+                /* keep the name: running processes point at the entry */
+                memset((char *)cmds[i] + sizeof(cmds[i]->name), 0,
+                       sizeof(struct cmdstat) - sizeof(cmds[i]->name));
+            }
+        recorded = 0;
+    }
+    else
+    {
+        printf("usage: stats [-j [file] | -r]\n");
+        builtin_status = 2;
+    }
+
+    sigprocmask(SIG_SETMASK, &prev, NULL);
+}
+
+/*
+ * metrics_exit - Called when the shell exits: write the JSON to
+ *     $ZSH_STATS or ~/.zsh_stats.json if any command ran
+ */
+void metrics_exit(void)
+{
+    char path[MAXPATH];
+    const char *env = getenv("ZSH_STATS");
+    sigset_t mask, prev;
+
+    sigemptyset(&mask);
+    sigaddset(&mask, SIGCHLD);
+    sigprocmask(SIG_BLOCK, &mask, &prev);
+    if (recorded)
+    {
+        if (env && *env)
+            snprintf(path, sizeof(path), "%s", env);
+        else
+            snprintf(path, sizeof(path), "%s/.zsh_stats.json", home_dir());
+        dump(path);
+    }
+    sigprocmask(SIG_SETMASK, &prev, NULL);
+}
@@ -0,0 +1,71 @@
+/*
+ * zsh - A mini shell program
+ * NKU OS Course
+ * Shuhao Zhang
+ *
+ * file: minishell.h
+ *
+ * Embedding API of libminishell.a / libminishell.so: run shell snippets
+ * from a host process without starting a zsh binary for each.
+ *
+ * A context holds what a shell session would: the working directory and
+ * the environment, variables included. msh_run() starts a snippet (any
+ * number of lines) in a forked copy of the shell that uses the context's
+ * state; what the snippet writes to stdout and stderr is handed to the
+ * output callback, and its exit status to the done callback, from
+ * msh_poll(). When it finishes, its directory and environment become the
+ * context's, so `cd` and `X=1` carry over to the next msh_run(). Neither
+ * the host's working directory nor its environment is touched.
+ *
+ * The host must not reap the children of a context itself (waitpid(-1)
+ * or SIGCHLD set to SIG_IGN). A context is not thread-safe; use one per
+ * thread.
+ */
+#ifndef MINISHELL_H
+#define MINISHELL_H
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define MSH_API __attribute__((visibility("default")))
+
+struct msh;
+
+struct msh_events {
+    /* fd is 1 or 2; buf is not '\0'-terminated */
+    void (*output)(void *arg, int id, int fd, const char *buf, size_t len);
+    /* status as in `$?`: the exit code, or 128 + signal */
+    void (*done)(void *arg, int id, int status);
+};
+
+/* Create a context with the host's cwd and environment. NULL on error. */
+MSH_API struct msh *msh_new(const struct msh_events *ev, void *arg);
+/* Kill what is still running and free the context */
+MSH_API void msh_free(struct msh *m);
+
+/* Start a snippet, return its id (> 0), or -1 with errno set */
+MSH_API int msh_run(struct msh *m, const char *script);
+/* Deliver callbacks, waiting up to ms milliseconds (-1: until something
+ * happens). Returns how many snippets are still running. */
+MSH_API int msh_poll(struct msh *m, int ms);
+/* Deliver callbacks until snippet id is done, return its status (-1 if
+ * there is no such snippet). Without a done callback, a finished
+ * snippet's status is kept until msh_wait() takes it; with one, the
+ * callback takes it and msh_wait() is only good while it runs. */
+MSH_API int msh_wait(struct msh *m, int id);
+/* Send sig to every process of snippet id */
+MSH_API int msh_kill(struct msh *m, int id, int sig);
+
+/* The context's working directory and variables */
+MSH_API const char *msh_cwd(struct msh *m);
+MSH_API const char *msh_getenv(struct msh *m, const char *name);
+MSH_API int msh_setenv(struct msh *m, const char *name, const char *value);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* MINISHELL_H */
@@ -0,0 +1,381 @@
+/*
+ * zsh - A mini shell program
+ * NKU OS Course
+ * Shuhao Zhang
+ *
+ * file: onchange.c
+ *
+ * `on-change [-d DELAY] PATH... -- cmd ...` runs cmd as a foreground
+ * job, and again every time something under the PATHs changes, until
+ * C-c:
+ *
+ *     on-change src include -- make test
+ *     on-change -d 1s notes.md -- pandoc -o notes.html notes.md
+ *
+ * A directory is watched with everything below it (directories made
+ * later too), a file by watching its directory for that name, so editors
+ * that save by renaming a new file over it are seen. Names starting with
+ * '.' or ending with '~' (.git, swap and backup files) are ignored. The
+ * watches are inotify ones, and the shell sleeps in wait_input() on the
+ * inotify fd between changes, so an idle on-change takes no CPU and
+ * wakes up for a change or C-c only.
+ *
+ * Changes come in bursts (a save is several events, `git checkout` many
+ * files). At the first change the run that is still going is cancelled:
+ * its process group gets SIGTERM, and SIGKILL 2 seconds later, through
+ * the job deadlines of timers.c. The next run starts once nothing changed
+ * for DELAY (100ms if left out), so a burst is one run.
+ *
+ * A command that writes into the watched directories (make with its
+ * objects next to the sources) would start itself again and again: watch
+ * the sources only. The limit and timeout prefixes may come before cmd.
+ */
+#include "main.h"
+#include <dirent.h>
+#include <sys/inotify.h>
+#include <sys/stat.h>
+
+#define DEBOUNCE    0.1         /* seconds without changes before a run */
+#define GRACE       2.0         /* seconds from SIGTERM to SIGKILL */
+#define EVENTS      (IN_CLOSE_WRITE | IN_ATTRIB | IN_CREATE | IN_DELETE | IN_MOVED_FROM \
+                     | IN_MOVED_TO | IN_ONLYDIR)
+
+extern struct job_t jobs[MAXJOBS];
+extern int input_wake;
+
+/* A watched directory, by watch descriptor */
+struct watch {
+    char *path;                 /* NULL: not used */
+    int all;                    /* every name in it, and its subdirectories */
+    char **names;               /* else only these */
+    int nnames;
+};
+
+static struct watch *watches;
+static int nwatches;
+static int ifd = -1;
+static volatile sig_atomic_t active, stop;
+static char changed[MAXPATH];   /* the first change of a burst */
+
+/*
+ * onchange_kill - C-c: stop on-change after its run. Called by the
+ *     SIGINT handler, which sends the run (the foreground job) SIGINT.
+ */
+void onchange_kill(void)
+{
+    if (!active)
+        return;
+    stop = 1;
+    input_wake = 1;
+}
+
+/* ignored - Is name one that is never watched? */
+static int ignored(const char *name)
+{
+    size_t len = strlen(name);
+
+    return name[0] == '.' || (len && name[len - 1] == '~');
+}
+
+/*
+ * add_watch - Watch directory dir: every name in it if name is NULL, or
+ *     else name too. Returns the watch descriptor, or -1.
+ */
+static int add_watch(const char *dir, const char *name)
+{
+    struct watch *w, *more;
+    char **names;
+    int wd;
+
+    if ((wd = inotify_add_watch(ifd, dir, EVENTS)) < 0)
+        return -1;
+    if (wd >= nwatches)
+    {
+        if ((more = realloc(watches, (wd + 64) * sizeof(*watches))) == NULL)
+            unix_error("on-change");
+        memset(more + nwatches, 0, (wd + 64 - nwatches) * sizeof(*watches));
+        watches = more;
+        nwatches = wd + 64;
+    }
+    w = &watches[wd];
+    if (!w->path && (w->path = strdup(dir)) == NULL)
+        unix_error("on-change");
+    if (!name)
+        w->all = 1;
+    else if (!w->all)
+    {
+        if ((names = realloc(w->names, (w->nnames + 1) * sizeof(char *))) == NULL
+            || (names[w->nnames] = strdup(name)) == NULL)
+            unix_error("on-change");
+        w->names = names;
+        w->nnames++;
+    }
+    return wd;
+}
+
+/* forget - Drop the watch wd, which inotify removed */
+static void forget(int wd)
+{
+    struct watch *w = &watches[wd];
+
+    for (int i = 0; i < w->nnames; i++)
+        free(w->names[i]);
+    free(w->names);
+    free(w->path);
+    memset(w, 0, sizeof(*w));
+}
+
+/*
+ * watch_tree - Watch directory dir and the directories below it, without
+ *     following symbolic links. Returns 0, or -1 if dir itself could not
+ *     be watched.
+ */
+static int watch_tree(const char *dir)
+{
+    char path[MAXPATH];
+    struct dirent *d;
+    struct stat st;
+    DIR *dp;
+
+    if (add_watch(dir, NULL) < 0)
+        return -1;
+    if ((dp = opendir(dir)) == NULL)
+        return 0;
+    while ((d = readdir(dp)) != NULL)
+    {
+        if (ignored(d->d_name))
+            continue;
+        snprintf(path, sizeof(path), "%s/%s", dir, d->d_name);
+        if (d->d_type == DT_DIR
+            || (d->d_type == DT_UNKNOWN && lstat(path, &st) == 0 && S_ISDIR(st.st_mode)))
+        {
+            if (watch_tree(path) < 0 && errno == ENOSPC)
+                break;
+        }
+    }
+    closedir(dp);
+    return 0;
+}
+
+/* watch_path - Watch a PATH of on-change. Returns 0, or -1 with errno. */
+static int watch_path(const char *path)
+{
+    char dir[MAXPATH];
+    const char *slash;
+    struct stat st;
+
+    if (stat(path, &st) < 0)
+        return -1;
+    if (S_ISDIR(st.st_mode))
+        return watch_tree(path);
+    if ((slash = strrchr(path, '/')) == NULL)
+        return add_watch(".", path) < 0 ? -1 : 0;
+    snprintf(dir, sizeof(dir), "%.*s", slash == path ? 1 : (int)(slash - path), path);
+    return add_watch(dir, slash + 1) < 0 ? -1 : 0;
+}
+
+/* wanted - Is name in w one of the watched ones? */
+static int wanted(const struct watch *w, const char *name)
+{
+    if (ignored(name))
+        return 0;
+    if (w->all)
+        return 1;
+    for (int i = 0; i < w->nnames; i++)
+        if (!strcmp(w->names[i], name))
+            return 1;
+    return 0;
+}
+
+/*
+ * drain - Read the events that came in, watching new directories.
+ *     Returns the number of changes among them.
+ */
+static int drain(void)
+{
+    char buf[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+    char path[MAXPATH];
+    const struct inotify_event *ev;
+    struct watch *w;
+    int n = 0;
+    ssize_t len;
+
+    while ((len = read(ifd, buf, sizeof(buf))) > 0)
+    {
+        for (char *p = buf; p < buf + len; p += sizeof(*ev) + ev->len)
+        {
+            ev = (const struct inotify_event *)p;
+            if (ev->mask & IN_Q_OVERFLOW)
+            {
+                /* events were lost: something changed */
+                if (!n++ && !changed[0])
+                    snprintf(changed, sizeof(changed), "(many files)");
+                continue;
+            }
+            if (ev->wd < 0 || ev->wd >= nwatches || !(w = &watches[ev->wd])->path)
+                continue;
+            if (ev->mask & IN_IGNORED)
+            {
+                forget(ev->wd);
+                continue;
+            }
+            if (!ev->len || !wanted(w, ev->name))
+                continue;
+            snprintf(path, sizeof(path), "%s/%s", w->path, ev->name);
+            if (w->all && (ev->mask & IN_ISDIR) && (ev->mask & (IN_CREATE | IN_MOVED_TO)))
+                watch_tree(path);
+            if (!n++ && !changed[0])
+                snprintf(changed, sizeof(changed), "%s", path);
+        }
+    }
+    return n;
+}
+
+/*
+ * cancel - Stop the run pgid if it is still going, and wait until it is
+ *     reaped
+ */
+static void cancel(pid_t pgid)
+{
+    sigset_t mask, prev;
+    struct job_t *job;
+
+    sigemptyset(&mask);
+    sigaddset(&mask, SIGCHLD);
+    sigprocmask(SIG_BLOCK, &mask, &prev);
+    if (pgid && (job = getjobpid(jobs, pgid)) != NULL)
+    {
+        set_deadline(job, 0, GRACE);
+        while (getjobpid(jobs, pgid) != NULL)
+            wait_event(&prev);
+    }
+    sigprocmask(SIG_SETMASK, &prev, NULL);
+}
+
+/* run - Start args as a foreground job. Returns its process group. */
+static pid_t run(char **args, char *cmdline, struct spawn_attr *attr)
+{
+    struct spawn_attr a = *attr;
+    char **argv;
+    pid_t pgid;
+    int n;
+
+    /* start_job() cuts its argv at the "|"s */
+    for (n = 0; args[n]; n++)
+        ;
+    if ((argv = malloc((n + 1) * sizeof(*argv))) == NULL)
+        unix_error("on-change");
+    memcpy(argv, args, (n + 1) * sizeof(*argv));
+    pgid = start_job(argv, FG, cmdline, &a, NULL, NULL);
+    free(argv);
+    return pgid;
+}
+
+/* ms_left - Milliseconds until secs after from, rounded up; 0 if past */
+static int ms_left(const struct timespec *from, double secs)
+{
+    struct timespec now;
+    double left;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    left = secs - (now.tv_sec - from->tv_sec) - (now.tv_nsec - from->tv_nsec) / 1e9;
+    return left > 0 ? (int)(left * 1000) + 1 : 0;
+}
+
+/*
+ * do_onchange - Execute on-change [-d DELAY] PATH... -- cmd ...
+ */
+void do_onchange(char **argv, char *cmdline, struct redir *r)
+{
+    struct spawn_attr attr;
+    struct timespec last;       /* of the latest change of a burst */
+    double delay = DEBOUNCE;
+    char **args;
+    int i = 1, dashes, failed = 0;
+    pid_t pgid;
+
+    if (argv[1] && !strcmp(argv[1], "-d"))
+    {
+        if (!argv[2] || (delay = parse_duration(argv[2])) < 0)
+            goto usage;
+        i = 3;
+    }
+    for (dashes = i; argv[dashes] && strcmp(argv[dashes], "--"); dashes++)
+        ;
+    if (dashes == i || !argv[dashes] || !argv[dashes + 1])
+        goto usage;
+    if (redir_used(r))
+    {
+        printf("on-change: redirections are not supported\n");
+        redir_close(r);
+        last_status = 2;
+        return;
+    }
+    if ((args = job_prefixes(argv + dashes + 1, &attr)) == NULL)
+    {
+        last_status = 2;
+        return;
+    }
+
+    if ((ifd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC)) < 0)
+    {
+        printf("on-change: %s\n", strerror(errno));
+        last_status = 1;
+        return;
+    }
+    for (; i < dashes; i++)
+    {
+        if (watch_path(argv[i]) == 0)
+            continue;
+        if (errno == ENOSPC)
+            printf("on-change: %s: too many directories to watch (fs.inotify.max_user_watches)\n", argv[i]);
+        else
+            printf("on-change: %s: %s\n", argv[i], strerror(errno));
+        failed = 1;
+        break;
+    }
+
+    stop = 0;
+    active = !failed;
+    pgid = failed ? 0 : run(args, cmdline, &attr);
+    while (active && !stop)
+    {
+        /* asleep until something changes */
+        changed[0] = '\0';
+        if (!wait_input(ifd, -1) || !drain())
+            continue;
+        cancel(pgid);
+        pgid = 0;
+        /*
+         * the rest of the burst, until DELAY passed without a change;
+         * wait_input() may also return early for input_wake
+         */
+        clock_gettime(CLOCK_MONOTONIC, &last);
+        for (int ms; !stop && (ms = ms_left(&last, delay)) > 0; )
+            if (wait_input(ifd, ms) && drain())
+                clock_gettime(CLOCK_MONOTONIC, &last);
+        if (stop)
+            break;
+        printf("on-change: %s changed\n", changed);
+        fflush(stdout);
+        pgid = run(args, cmdline, &attr);
+    }
+    cancel(pgid);
+    active = 0;
+
+    close(ifd);
+    ifd = -1;
+    for (int wd = 0; wd < nwatches; wd++)
+        if (watches[wd].path)
+            forget(wd);
+    if (failed)
+        last_status = 1;
+    else if (stop)
+        last_status = 128 + SIGINT;
+    return;
+
+usage:
+    printf("usage: on-change [-d DELAY] PATH... -- command [args...]\n");
+    redir_close(r);
+    last_status = 2;
+}
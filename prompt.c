@@ -0,0 +1,357 @@
+/*
+ * zsh - A mini shell program
+ * NKU OS Course
+ * Shuhao Zhang
+ *
+ * file: prompt.c
+ *
+ * The prompt: user@host:cwd, then the segments named in $PROMPT_SEGMENTS
+ * (default "status jobs time git"), then the arrow:
+ *     status   exit status of the last foreground job, if not 0
+ *     jobs     number of jobs, if any
+ *     time     how long the last command line ran, from one second on
+ *     git      branch of the git work tree, '*' if it has changes
+ *
+ * The git segment runs `git status`, which takes a long time in a large
+ * work tree, so it never runs on the input path: prompt_update() starts
+ * it as a helper process and the prompt shows what is cached for the
+ * directory meanwhile ("(…)" the first time). The helper's output is
+ * read whenever the shell waits anyway (see wait_input()); when it
+ * changes the prompt, input_wake is set and the line editor repaints the
+ * prompt in place, keeping what was typed.
+ */
+#include "main.h"
+#include <poll.h>
+#include <spawn.h>
+#include <sys/stat.h>
+#include <time.h>
+
+#define GITCACHE   8            /* directories whose git status is kept */
+#define MAXHELPER  4            /* helpers not reaped yet */
+
+extern char **environ;
+extern char user[], host[], cur_dir[];
+extern struct job_t jobs[MAXJOBS];
+extern int last_status;
+extern int input_wake;
+
+enum { SEG_STATUS, SEG_JOBS, SEG_TIME, SEG_GIT };
+static const char *seg_names[] = { "status", "jobs", "time", "git" };
+
+/* The git status of one directory */
+static struct git {
+    char dir[MAXPATH];          /* "" for a free entry */
+    int repo;                   /* dir is inside a work tree */
+    int known;                  /* text holds an answer */
+    char text[128];             /* branch, '*' if dirty */
+    unsigned long used;         /* for evicting the oldest */
+} cache[GITCACHE];
+static unsigned long uses;
+
+/* The running helper */
+static int helper_fd = -1;      /* its stdout, -1 if none runs */
+static char helper_dir[MAXPATH];
+static char reply[512];         /* the start of its output */
+static size_t nreply, total;
+static char pending[MAXPATH];   /* run for this directory next, or "" */
+static pid_t helpers[MAXHELPER];    /* started and not reaped yet */
+
+static struct timespec started; /* the current command line */
+static double last_secs;        /* how long the last one ran */
+
+/* work_tree - Is dir inside a git work tree, does it or a parent have .git? */
+static int work_tree(const char *dir)
+{
+    char path[MAXPATH + 8];
+    struct stat st;
+
+    snprintf(path, sizeof(path), "%s", dir);
+    while (1)
+    {
+        size_t n = strlen(path);
+
+        snprintf(path + n, sizeof(path) - n, "%s.git", n && path[n - 1] == '/' ? "" : "/");
+        if (stat(path, &st) == 0)
+            return 1;
+        path[n] = '\0';
+        while (n > 1 && path[n - 1] == '/')
+            path[--n] = '\0';
+        char *slash = strrchr(path, '/');
+        if (!slash || n <= 1)
+            return 0;
+        slash[slash == path] = '\0';
+    }
+}
+
+/*
+ * lookup - The cache entry of dir, made (oldest evicted) if create. With
+ *     create, a directory that was not in a work tree is looked at again:
+ *     `git init` or a clone may have made one since.
+ */
+static struct git *lookup(const char *dir, int create)
+{
+    struct git *g, *old = &cache[0];
+
+    for (g = cache; g < cache + GITCACHE; g++)
+    {
+        if (!strcmp(g->dir, dir))
+        {
+            g->used = ++uses;
+            if (create && !g->repo)
+                g->repo = work_tree(dir);
+            return g;
+        }
+        if (g->used < old->used)
+            old = g;
+    }
+    if (!create)
+        return NULL;
+
+    g = old;
+    snprintf(g->dir, sizeof(g->dir), "%s", dir);
+    g->known = 0;
+    g->repo = work_tree(dir);
+    g->used = ++uses;
+    return g;
+}
+
+/* start - Run git status for dir in a helper process */
+static void start(const char *dir)
+{
+    static char *argv[] = { "git", "--no-optional-locks", "status", "--porcelain",
+                            "-b", "--untracked-files=no", NULL };
+    posix_spawn_file_actions_t fa;
+    posix_spawnattr_t attr;
+    sigset_t none, mask, prev;
+    pid_t pid;
+    int fds[2], slot;
+
+    for (slot = 0; slot < MAXHELPER && helpers[slot]; slot++)
+        ;
+    if (slot == MAXHELPER || pipe2(fds, O_CLOEXEC) < 0)
+        return;
+    posix_spawn_file_actions_init(&fa);
+    posix_spawn_file_actions_addchdir_np(&fa, dir);
+    posix_spawn_file_actions_adddup2(&fa, fds[1], STDOUT_FILENO);
+    posix_spawn_file_actions_addopen(&fa, STDERR_FILENO, "/dev/null", O_WRONLY, 0);
+    posix_spawn_file_actions_addopen(&fa, STDIN_FILENO, "/dev/null", O_RDONLY, 0);
+    /* its own process group: C-c on the terminal is not for it */
+    posix_spawnattr_init(&attr);
+    sigemptyset(&none);
+    posix_spawnattr_setsigmask(&attr, &none);
+    posix_spawnattr_setpgroup(&attr, 0);
+    posix_spawnattr_setflags(&attr, POSIX_SPAWN_SETPGROUP | POSIX_SPAWN_SETSIGMASK);
+    /* the handler must know the pid when it reaps the helper */
+    sigemptyset(&mask);
+    sigaddset(&mask, SIGCHLD);
+    sigprocmask(SIG_BLOCK, &mask, &prev);
+    if (posix_spawnp(&pid, "git", &fa, &attr, argv, environ) == 0)
+    {
+        helpers[slot] = pid;
+        helper_fd = fds[0];
+        fcntl(helper_fd, F_SETFL, O_NONBLOCK);
+        snprintf(helper_dir, sizeof(helper_dir), "%s", dir);
+        nreply = total = 0;
+    }
+    else
+        close(fds[0]);
+    sigprocmask(SIG_SETMASK, &prev, NULL);
+    close(fds[1]);
+    posix_spawn_file_actions_destroy(&fa);
+    posix_spawnattr_destroy(&attr);
+}
+
+/* finish - The helper is done: cache what it said */
+static void finish(void)
+{
+    struct git *g;
+    char text[128], *p, *end;
+    size_t n;
+
+    close(helper_fd);
+    helper_fd = -1;
+    if ((g = lookup(helper_dir, 0)) == NULL)
+        goto next;
+    reply[nreply < sizeof(reply) ? nreply : sizeof(reply) - 1] = '\0';
+    text[0] = '\0';
+    if (!strncmp(reply, "## ", 3))
+    {
+        /* "## main...origin/main [ahead 1]" or "## No commits yet on main" */
+        p = reply + 3;
+        if (!strncmp(p, "No commits yet on ", 18))
+            p += 18;
+        n = strcspn(p, " \n");
+        if ((end = strstr(p, "...")) != NULL && (size_t)(end - p) < n)
+            n = end - p;
+        if (n > 100)
+            n = 100;
+        snprintf(text, sizeof(text), "%.*s%s", (int)n, p,
+                 total > strcspn(reply, "\n") + 1 ? "*" : "");
+    }
+    /* git gave no answer: not a work tree after all */
+    g->repo = text[0] != '\0';
+    if (!g->known || strcmp(g->text, text))
+        input_wake = 1;
+    g->known = 1;
+    strcpy(g->text, text);
+next:
+    if (pending[0])
+    {
+        start(pending);
+        pending[0] = '\0';
+    }
+}
+
+/*
+ * prompt_pollfds - Add the helper's pipe to pfd, return how many (0 or 1)
+ */
+int prompt_pollfds(struct pollfd *pfd)
+{
+    if (helper_fd < 0)
+        return 0;
+    pfd->fd = helper_fd;
+    pfd->events = POLLIN;
+    pfd->revents = 0;
+    return 1;
+}
+
+/*
+ * prompt_drain - Read what the helper wrote, without blocking
+ */
+void prompt_drain(void)
+{
+    char discard[4096];
+    ssize_t n;
+
+    while (helper_fd >= 0)
+    {
+        if (nreply < sizeof(reply))
+            n = read(helper_fd, reply + nreply, sizeof(reply) - nreply);
+        else
+            n = read(helper_fd, discard, sizeof(discard));
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n < 0 && errno == EAGAIN)
+            return;
+        if (n <= 0)
+        {
+            finish();
+            continue;
+        }
+        if (nreply < sizeof(reply))
+            nreply += n;
+        total += n;
+    }
+}
+
+/*
+ * prompt_reaped - Is pid a git helper? Called by the SIGCHLD handler for
+ *     every child it reaps, like it checks for the launcher.
+ */
+int prompt_reaped(pid_t pid)
+{
+    for (int i = 0; i < MAXHELPER; i++)
+        if (helpers[i] == pid)
+        {
+            helpers[i] = 0;
+            return 1;
+        }
+    return 0;
+}
+
+/* enabled - Is segment seg in $PROMPT_SEGMENTS? */
+static int enabled(int seg)
+{
+    const char *list = getenv("PROMPT_SEGMENTS"), *p;
+    size_t n = strlen(seg_names[seg]);
+
+    if (!list)
+        return 1;
+    for (p = list; (p = strstr(p, seg_names[seg])) != NULL; p += n)
+        if ((p == list || p[-1] == ' ' || p[-1] == ',')
+            && (p[n] == '\0' || p[n] == ' ' || p[n] == ','))
+            return 1;
+    return 0;
+}
+
+/*
+ * prompt_update - Called before the prompt of every command line: ask
+ *     git again about the working directory, in the background
+ */
+void prompt_update(void)
+{
+    struct git *g;
+
+    if (!enabled(SEG_GIT) || !(g = lookup(cur_dir, 1))->repo)
+        return;
+    if (helper_fd < 0)
+        start(cur_dir);
+    else if (strcmp(helper_dir, cur_dir))
+        snprintf(pending, sizeof(pending), "%s", cur_dir);
+}
+
+/*
+ * prompt_begin/prompt_end - Called around every command line, for the
+ *     time segment
+ */
+void prompt_begin(void)
+{
+    clock_gettime(CLOCK_MONOTONIC, &started);
+}
+
+void prompt_end(void)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    last_secs = (now.tv_sec - started.tv_sec) + (now.tv_nsec - started.tv_nsec) / 1e9;
+}
+
+/*
+ * prompt_string - The prompt, as it is now
+ */
+const char *prompt_string(void)
+{
+    static char buf[2 * MAXPATH];
+    static int known = 0;   /* user and host are looked up once */
+    struct git *g;
+    size_t n;
+    int njobs = 0;
+
+    /* Get username and hostname, cur_dir is kept up to date by cd */
+    if (!known) {
+        struct passwd* username;
+        if ((username = getpwuid(getuid())) != NULL)
+            strcpy(user, username->pw_name);
+        gethostname(host, MAXLINE);
+        known = 1;
+    }
+
+    n = snprintf(buf, sizeof(buf), "\033[01;32m%s@%s\033[00m:\033[01;34m%s\033[00m",
+                 user, host, cur_dir);
+    if (enabled(SEG_STATUS) && last_status)
+        n += snprintf(buf + n, sizeof(buf) - n, " \033[31m[%d]\033[00m", last_status);
+    if (enabled(SEG_JOBS))
+    {
+        for (int i = 0; i < jobs_used; i++)
+            njobs += jobs[i].jid != 0;
+        if (njobs)
+            n += snprintf(buf + n, sizeof(buf) - n, " \033[36m%d job%s\033[00m",
+                          njobs, njobs > 1 ? "s" : "");
+    }
+    if (enabled(SEG_TIME) && last_secs >= 1)
+        n += snprintf(buf + n, sizeof(buf) - n, " \033[35m%.1fs\033[00m", last_secs);
+    if (enabled(SEG_GIT) && (g = lookup(cur_dir, 0)) != NULL && g->repo)
+        n += snprintf(buf + n, sizeof(buf) - n, " \033[33m(%s)\033[00m",
+                      g->known ? g->text : "…");
+    snprintf(buf + n, sizeof(buf) - n, " %s ",
+             strcmp(user, "root") ? "\033[01;32m➤\033[00m" : "\033[01;31m➤\033[00m");
+    return buf;
+}
+
+/*
+* print_prompt - print prompt information into stdout
+*/
+void print_prompt(void) {
+    fputs(prompt_string(), stdout);
+}
@@ -0,0 +1,559 @@
+/*
+ * zsh - A mini shell program
+ * NKU OS Course
+ * Shuhao Zhang
+ *
+ * file: rc.c
+ *
+ * Startup files: an interactive shell reads ~/.zshrc, a shell started
+ * with -p (or -S) reads ~/.zshenv, -f reads neither. The file is
+ * evaluated line by line like a script.
+ *
+ * With -s the shell also writes what the file left behind into a
+ * snapshot, FILE.snap: the variables it set or unset, its aliases and a
+ * hash of the commands on the resulting $PATH. As long as the file is unchanged
+ * (inode, size, mtime), later starts map the snapshot instead of reading
+ * the file: the variables go into environ as pointers into the mapping,
+ * and env_eval() looks commands up in the mapped hash instead of trying
+ * execve() on every $PATH entry. The hash also keeps the mtime of every
+ * $PATH directory; once one of them changed (a program was installed or
+ * removed), it is not used any more. Commands the file runs for their
+ * output or other side effects are not repeated from a snapshot.
+ */
+#include "main.h"
+#include <dirent.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define SNAP_MAGIC "zshsnap2"
+
+/* A snapshot is the header and then nsect sections, each 8-byte aligned */
+struct snap_head {
+    char magic[8];
+    uint64_t ino, size, mtime;  /* of the startup file it was made from */
+    uint32_t nsect, pad;
+};
+
+struct snap_sect {
+    uint32_t kind;
+    uint32_t len;               /* of the data that follows */
+};
+
+enum { SNAP_VARS = 1, SNAP_PATH = 2, SNAP_ALIAS = 3 };
+
+/*
+ * SNAP_VARS: "NAME=VALUE\0" for a variable the file set, "NAME\0" for one
+ *     it unset.
+ * SNAP_ALIAS: "name\0value\0" for every alias.
+ * SNAP_PATH: the header below, the $PATH value it was made for, the
+ *     mtimes of its ndirs directories, nbuckets offsets (0: empty bucket)
+ *     into the section of "name\0/dir/name\0".
+ */
+struct snap_path {
+    uint32_t nbuckets;          /* a power of 2 */
+    uint32_t pathlen;           /* of the $PATH value, with '\0', 8-aligned */
+    uint32_t ndirs, pad;
+};
+
+static const char *map;         /* the snapshot in use, or NULL */
+static size_t map_len;
+static const struct snap_path *hashed;
+static const char *hashed_path;
+static const uint64_t *dir_mtimes;
+static const uint32_t *buckets;
+
+/* hash_n - FNV-1a of the n bytes at s */
+static uint32_t hash_n(const char *s, size_t n)
+{
+    uint32_t h = 2166136261u;
+
+    while (n--)
+        h = (h ^ (unsigned char)*s++) * 16777619u;
+    return h;
+}
+
+/* hash - FNV-1a of string s */
+static uint32_t hash(const char *s)
+{
+    return hash_n(s, strlen(s));
+}
+
+/* dir_mtime - The mtime of directory dir in ns, 0 if there is none */
+static uint64_t dir_mtime(const char *dir)
+{
+    struct stat st;
+
+    if (stat(dir, &st) < 0 || !S_ISDIR(st.st_mode))
+        return 0;
+    return (uint64_t)st.st_mtim.tv_sec * 1000000000 + st.st_mtim.tv_nsec;
+}
+
+/*
+ * dirs_changed - Did a directory of the hashed $PATH change since the
+ *     snapshot? One stat() per directory, still far less than the
+ *     execve()s of a $PATH walk.
+ */
+static int dirs_changed(void)
+{
+    char dir[MAXPATH];
+    const char *p, *end;
+    uint32_t k = 0;
+
+    for (p = hashed_path; *p; p = *end ? end + 1 : end)
+    {
+        end = p + strcspn(p, ":");
+        if (end == p)
+            continue;           /* skipped when it was written too */
+        if (k == hashed->ndirs)
+            return 1;
+        snprintf(dir, sizeof(dir), "%.*s", (int)(end - p), p);
+        if (dir_mtime(dir) != dir_mtimes[k++])
+            return 1;
+    }
+    return k != hashed->ndirs;
+}
+
+/*
+ * rc_which - The hashed full path of command name, if $PATH is still the
+ *     path the snapshot was made for and none of its directories changed.
+ *     NULL if the snapshot does not know.
+ */
+const char *rc_which(const char *name, const char *path)
+{
+    const char *base = (const char *)hashed;
+    uint32_t i, mask;
+
+    if (!hashed || strcmp(path, hashed_path))
+        return NULL;
+    if (dirs_changed())
+    {
+        hashed = NULL;          /* stale for good, search $PATH from now on */
+        return NULL;
+    }
+    mask = hashed->nbuckets - 1;
+    for (i = hash(name) & mask; buckets[i]; i = (i + 1) & mask)
+        if (!strcmp(base + buckets[i], name))
+            return base + buckets[i] + strlen(name) + 1;
+    return NULL;
+}
+
+/* var_name_len - Length of the name of "NAME=VALUE" or "NAME" */
+static size_t var_name_len(const char *v)
+{
+    return strcspn(v, "=");
+}
+
+/*
+ * apply_vars - Set and unset the variables of a SNAP_VARS section. One
+ *     putenv() each would scan environ each time, so a new environ is
+ *     built in one pass, with a hash of the names the snapshot has. Its
+ *     strings point into the mapping, which stays.
+ */
+static void apply_vars(const char *data, const char *end)
+{
+    const char *p, **names;
+    char **env;
+    uint32_t n = 0, size = 16, mask, i;
+    int k = 0, nenv = 0;
+
+    for (p = data; p < end; p += strlen(p) + 1)
+        n++;
+    while (size < 2 * n)
+        size *= 2;
+    mask = size - 1;
+    while (environ[nenv])
+        nenv++;
+    if ((names = calloc(size, sizeof(*names))) == NULL
+        || (env = malloc((nenv + n + 1) * sizeof(*env))) == NULL)
+    {
+        free(names);
+        return;
+    }
+
+    /* a later entry of the same name wins, as with putenv() */
+    for (p = data; p < end; p += strlen(p) + 1)
+    {
+        size_t len = var_name_len(p);
+
+        for (i = hash_n(p, len) & mask; names[i]; i = (i + 1) & mask)
+            if (var_name_len(names[i]) == len && !strncmp(names[i], p, len))
+                break;
+        names[i] = p;
+    }
+    for (char **e = environ; *e; e++)
+    {
+        size_t len = var_name_len(*e);
+
+        for (i = hash_n(*e, len) & mask; names[i]; i = (i + 1) & mask)
+            if (var_name_len(names[i]) == len && !strncmp(names[i], *e, len))
+                break;
+        if (!names[i])
+            env[k++] = *e;
+    }
+    for (i = 0; i < size; i++)
+        if (names[i] && names[i][var_name_len(names[i])] == '=')
+            env[k++] = (char *)names[i];
+    env[k] = NULL;
+    free(names);
+    environ = env;
+    env_gen++;
+}
+
+/* rc_file - The startup file of an interactive shell or not, in buf */
+static const char *rc_file(int interactive, char *buf)
+{
+    snprintf(buf, MAXPATH, "%s/%s", home_dir(), interactive ? ".zshrc" : ".zshenv");
+    return buf;
+}
+
+/*
+ * snap_load - Map the snapshot for the startup file with status st and
+ *     apply it. Returns 0, or -1 if there is none that is up to date.
+ */
+static int snap_load(const char *file, const struct stat *st)
+{
+    const struct snap_head *h;
+    const struct snap_sect *s;
+    char name[MAXPATH + 8];
+    struct stat sst;
+    size_t off;
+    int fd;
+
+    snprintf(name, sizeof(name), "%s.snap", file);
+    if ((fd = open(name, O_RDONLY | O_CLOEXEC)) < 0)
+        return -1;
+    if (fstat(fd, &sst) < 0 || sst.st_size < (off_t)sizeof(*h)
+        || (map = mmap(NULL, sst.st_size, PROT_READ, MAP_PRIVATE, fd, 0)) == MAP_FAILED)
+    {
+        map = NULL;
+        close(fd);
+        return -1;
+    }
+    close(fd);
+    map_len = sst.st_size;
+
+    h = (const struct snap_head *)map;
+    if (memcmp(h->magic, SNAP_MAGIC, 8) || h->ino != (uint64_t)st->st_ino
+        || h->size != (uint64_t)st->st_size
+        || h->mtime != (uint64_t)st->st_mtim.tv_sec * 1000000000 + st->st_mtim.tv_nsec)
+        goto stale;
+
+    /* check the layout first, nothing is applied from a broken file */
+    off = sizeof(*h);
+    for (uint32_t i = 0; i < h->nsect; i++)
+    {
+        if (off + sizeof(*s) > map_len)
+            goto stale;
+        s = (const struct snap_sect *)(map + off);
+        if (s->len > map_len - off - sizeof(*s) || (s->len && map[off + sizeof(*s) + s->len - 1]))
+            goto stale;
+        off += sizeof(*s) + ((s->len + 7) & ~7u);
+    }
+
+    off = sizeof(*h);
+    for (uint32_t i = 0; i < h->nsect; i++)
+    {
+        const char *p, *data, *end;
+
+        s = (const struct snap_sect *)(map + off);
+        data = map + off + sizeof(*s);
+        end = data + s->len;
+        off += sizeof(*s) + ((s->len + 7) & ~7u);
+        switch (s->kind)
+        {
+        case SNAP_VARS:
+            apply_vars(data, end);
+            break;
+        case SNAP_ALIAS:
+            for (p = data; p < end; p += strlen(p) + 1)
+            {
+                const char *value = p + strlen(p) + 1;
+
+                if (value >= end)
+                    break;
+                alias_define(p, value);
+                p = value;
+            }
+            break;
+        case SNAP_PATH:
+            hashed = (const struct snap_path *)data;
+            if (s->len < sizeof(*hashed) || (hashed->nbuckets & (hashed->nbuckets - 1))
+                || (hashed->pathlen & 7) || (uint64_t)sizeof(*hashed) + hashed->pathlen
+                   + 8ull * hashed->ndirs + 4ull * hashed->nbuckets > s->len)
+            {
+                hashed = NULL;      /* broken, look commands up on $PATH */
+                break;
+            }
+            hashed_path = data + sizeof(*hashed);
+            dir_mtimes = (const uint64_t *)(hashed_path + hashed->pathlen);
+            buckets = (const uint32_t *)(dir_mtimes + hashed->ndirs);
+            break;
+        }
+    }
+    return 0;
+
+stale:
+    munmap((void *)map, map_len);
+    map = NULL;
+    return -1;
+}
+
+/* sect_begin - Start a section of kind in f, return where it starts */
+static long sect_begin(FILE *f, uint32_t kind)
+{
+    struct snap_sect s = {kind, 0};
+    long at = ftell(f);
+
+    fwrite(&s, sizeof(s), 1, f);
+    return at;
+}
+
+/* sect_end - Fill in the length of the section at at, pad it */
+static void sect_end(FILE *f, long at)
+{
+    static const char zero[8];
+    uint32_t len = ftell(f) - at - sizeof(struct snap_sect);
+
+    fwrite(zero, 1, ((len + 7) & ~7u) - len, f);
+    fseek(f, at + offsetof(struct snap_sect, len), SEEK_SET);
+    fwrite(&len, sizeof(len), 1, f);
+    fseek(f, 0, SEEK_END);
+}
+
+/* write_vars - Write the variables changed since before */
+static void write_vars(FILE *f, char **before)
+{
+    long at = sect_begin(f, SNAP_VARS);
+    char **e, **b;
+
+    for (e = environ; *e; e++)
+    {
+        for (b = before; *b && strcmp(*b, *e); b++)
+            ;
+        if (!*b)
+            fwrite(*e, 1, strlen(*e) + 1, f);
+    }
+    for (b = before; *b; b++)
+    {
+        size_t n = var_name_len(*b);
+
+        for (e = environ; *e && (var_name_len(*e) != n || strncmp(*e, *b, n)); e++)
+            ;
+        if (!*e)
+        {
+            fwrite(*b, 1, n, f);
+            fputc('\0', f);
+        }
+    }
+    sect_end(f, at);
+}
+
+/* write_alias - Write one alias as "name\0value\0" */
+static void write_alias(const char *name, const char *value, void *f)
+{
+    fwrite(name, 1, strlen(name) + 1, f);
+    fwrite(value, 1, strlen(value) + 1, f);
+}
+
+/*
+ * write_path - Hash every command on $PATH, the first one of a name wins.
+ *     Returns the number of sections written.
+ */
+static int write_path(FILE *f)
+{
+    const char *path = getenv("PATH");
+    char *copy, *dir, *save;
+    struct snap_path hp = {1024, 0, 0, 0};
+    uint32_t *table, off, nstr = 0, cap = 1 << 16, n = 0, mask;
+    uint64_t *mtimes;
+    char *str;
+    long at;
+
+    if (!path)
+        return 0;
+    hp.pathlen = (strlen(path) + 1 + 7) & ~7u;
+    str = malloc(cap);
+    copy = strdup(path);
+    mtimes = malloc((strlen(path) / 2 + 1) * sizeof(*mtimes));
+    if (!str || !copy || !mtimes)
+    {
+        free(str);
+        free(copy);
+        free(mtimes);
+        return 0;
+    }
+
+    /* names and paths first, the table size follows from their number */
+    for (dir = strtok_r(copy, ":", &save); dir; dir = strtok_r(NULL, ":", &save))
+    {
+        DIR *d;
+        struct dirent *de;
+        struct stat st;
+
+        /* before the reading: a change while it reads is a change later */
+        mtimes[hp.ndirs++] = dir_mtime(dir);
+        if ((d = opendir(dir)) == NULL)
+            continue;
+        while ((de = readdir(d)) != NULL)
+        {
+            size_t need = 2 * strlen(de->d_name) + strlen(dir) + 3;
+
+            if (de->d_name[0] == '.' || fstatat(dirfd(d), de->d_name, &st, 0) < 0
+                || !S_ISREG(st.st_mode) || faccessat(dirfd(d), de->d_name, X_OK, 0) < 0)
+                continue;
+            if (nstr + need > cap)
+            {
+                char *p;
+
+                while (nstr + need > cap)
+                    cap *= 2;
+                if ((p = realloc(str, cap)) == NULL)
+                    break;
+                str = p;
+            }
+            nstr += sprintf(str + nstr, "%s", de->d_name) + 1;
+            nstr += sprintf(str + nstr, "%s/%s", dir, de->d_name) + 1;
+            n++;
+        }
+        closedir(d);
+    }
+    free(copy);
+
+    while (hp.nbuckets < 2 * n)
+        hp.nbuckets *= 2;
+    mask = hp.nbuckets - 1;
+    if ((table = calloc(hp.nbuckets, sizeof(*table))) == NULL)
+    {
+        free(str);
+        free(mtimes);
+        return 0;
+    }
+    /* strings follow the buckets */
+    off = sizeof(hp) + hp.pathlen + hp.ndirs * sizeof(*mtimes) + hp.nbuckets * sizeof(*table);
+    for (uint32_t p = 0; p < nstr; )
+    {
+        const char *name = str + p;
+        uint32_t i;
+
+        for (i = hash(name) & mask; table[i]; i = (i + 1) & mask)
+            if (!strcmp(str + table[i] - off, name))
+                break;
+        if (!table[i])
+            table[i] = off + p;
+        p += strlen(name) + 1;
+        p += strlen(str + p) + 1;
+    }
+
+    at = sect_begin(f, SNAP_PATH);
+    fwrite(&hp, sizeof(hp), 1, f);
+    fwrite(path, 1, strlen(path), f);
+    for (size_t i = strlen(path); i < hp.pathlen; i++)
+        fputc('\0', f);
+    fwrite(mtimes, sizeof(*mtimes), hp.ndirs, f);
+    fwrite(table, sizeof(*table), hp.nbuckets, f);
+    fwrite(str, 1, nstr, f);
+    sect_end(f, at);
+    free(table);
+    free(str);
+    free(mtimes);
+    return 1;
+}
+
+/* snap_write - Write the snapshot of file (status st) */
+static void snap_write(const char *file, const struct stat *st, char **before)
+{
+    struct snap_head h = {SNAP_MAGIC, 0, 0, 0, 2, 0};
+    char name[MAXPATH + 8], tmp[MAXPATH + 32];
+    FILE *f;
+    long at;
+
+    snprintf(name, sizeof(name), "%s.snap", file);
+    snprintf(tmp, sizeof(tmp), "%s.snap.%d", file, getpid());
+    if ((f = fopen(tmp, "w")) == NULL)
+    {
+        printf("%s: %s\n", tmp, strerror(errno));
+        return;
+    }
+    h.ino = st->st_ino;
+    h.size = st->st_size;
+    h.mtime = (uint64_t)st->st_mtim.tv_sec * 1000000000 + st->st_mtim.tv_nsec;
+    fwrite(&h, sizeof(h), 1, f);
+    write_vars(f, before);
+    at = sect_begin(f, SNAP_ALIAS);
+    alias_each(write_alias, f);
+    sect_end(f, at);
+    if (write_path(f))
+    {
+        h.nsect++;
+        rewind(f);
+        fwrite(&h, sizeof(h), 1, f);
+    }
+
+    /* readers see the old snapshot or the new one, never half of it */
+    if (fclose(f) != 0 || rename(tmp, name) < 0)
+    {
+        printf("%s: %s\n", name, strerror(errno));
+        unlink(tmp);
+    }
+}
+
+/*
+ * rc_map - Apply the snapshot of the startup file if it is up to date.
+ *     Returns 0, or -1 if the file has to be read with rc_load(). Runs no
+ *     commands, so it can be done before the launcher is forked.
+ */
+int rc_map(int interactive)
+{
+    char file[MAXPATH];
+    struct stat st;
+
+    if (stat(rc_file(interactive, file), &st) < 0)
+        return 0;           /* no startup file, nothing to do */
+    return snap_load(file, &st);
+}
+
+/*
+ * rc_load - Evaluate the startup file. With snapshot set, write what it
+ *     left behind into a new snapshot.
+ */
+void rc_load(int interactive, int snapshot)
+{
+    char file[MAXPATH], **before = NULL;
+    struct stat st;
+    char *script;
+    ssize_t n;
+    int fd, i;
+
+    if ((fd = open(rc_file(interactive, file), O_RDONLY | O_CLOEXEC)) < 0)
+        return;
+    if (fstat(fd, &st) < 0 || (script = malloc(st.st_size + 1)) == NULL)
+    {
+        close(fd);
+        return;
+    }
+    for (n = 0; n < st.st_size; n += i)
+        if ((i = read(fd, script + n, st.st_size - n)) <= 0)
+            break;
+    close(fd);
+    script[n] = '\0';
+
+    if (snapshot)
+    {
+        for (i = 0; environ[i]; i++)
+            ;
+        if ((before = calloc(i + 1, sizeof(*before))) != NULL)
+            for (i = 0; environ[i]; i++)
+                before[i] = strdup(environ[i]);
+    }
+    eval_script(script);
+    free(script);
+    if (before)
+    {
+        snap_write(file, &st, before);
+        for (i = 0; before[i]; i++)
+            free(before[i]);
+        free(before);
+    }
+}
@@ -0,0 +1,234 @@
+/*
+ * zsh - A mini shell program
+ * NKU OS Course
+ * Shuhao Zhang
+ *
+ * file: record.c
+ *
+ * Session recording and replay, for turning real script runs into
+ * benchmarks:
+ *     zsh -R file              record every input line
+ *     zsh --replay file        run a recording again, as fast as it goes
+ *     zsh --replay file --timed    ... each line at the time it came
+ *
+ * A recording is text, one line per input line:
+ *     arrival<TAB>duration<TAB>status<TAB>line
+ * with the arrival time since the shell started and how long the line
+ * ran, in microseconds, and the status it left. The line is what
+ * was read, without its newline.
+ *
+ * A replay hands the recorded lines to the main loop in place of stdin,
+ * so they go through eval() like typed ones (and can be recorded again
+ * with -R). With --timed a line is not handed out before its recorded
+ * arrival time; the shell services jobs meanwhile, see wait_input(). At
+ * the end the replay reports on stderr the total time against the
+ * recorded one, how much slower or faster than recorded each line ran
+ * (p50, p99 and the worst lines) and the lines whose status changed.
+ */
+#include "main.h"
+
+#define WORST      5                    /* lines reported by the replay */
+
+/* A line of a recording, and how it ran in the replay */
+struct entry {
+    long long arrival, duration;        /* us, recorded */
+    int status;
+    char *line;
+    long long took;                     /* us, replayed */
+    int now_status;
+};
+
+static FILE *rec;                       /* -R, or NULL */
+static struct timespec origin;          /* when the shell started */
+static struct timespec begun;           /* the current line */
+static long long arrived;
+static char current[MAXLINE];
+
+static struct entry *entries;           /* --replay */
+static int nentries, next, replaying, timed;
+static struct timespec replay_start;
+
+/* since - Microseconds from t to now */
+static long long since(const struct timespec *t)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - t->tv_sec) * 1000000LL + (now.tv_nsec - t->tv_nsec) / 1000;
+}
+
+/*
+ * record_open - -R path: record the session into path
+ */
+void record_open(const char *path)
+{
+    if ((rec = fopen(path, "w")) == NULL)
+    {
+        printf("zsh: %s: %s\n", path, strerror(errno));
+        exit(1);
+    }
+    fcntl(fileno(rec), F_SETFD, FD_CLOEXEC);
+    clock_gettime(CLOCK_MONOTONIC, &origin);
+}
+
+/*
+ * replay_open - --replay path: read the recording, whose lines the main
+ *     loop then takes from replay_next(). timed: at the recorded times.
+ */
+void replay_open(const char *path, int at_times)
+{
+    char buf[MAXLINE + 128], *p;
+    struct entry e, *more;
+    int cap = 0, lineno = 0;
+    FILE *f;
+
+    if ((f = fopen(path, "r")) == NULL)
+    {
+        printf("zsh: %s: %s\n", path, strerror(errno));
+        exit(1);
+    }
+    while (fgets(buf, sizeof(buf), f))
+    {
+        lineno++;
+        buf[strcspn(buf, "\n")] = '\0';
+        e.arrival = strtoll(buf, &p, 10);
+        if (*p == '\t')
+            e.duration = strtoll(p + 1, &p, 10);
+        if (*p == '\t')
+            e.status = strtol(p + 1, &p, 10);
+        if (*p != '\t' || p == buf)
+        {
+            printf("zsh: %s:%d: not a recording\n", path, lineno);
+            exit(1);
+        }
+        if (nentries == cap)
+        {
+            cap = cap ? 2 * cap : 256;
+            if ((more = realloc(entries, cap * sizeof(*entries))) == NULL)
+                unix_error("replay");
+            entries = more;
+        }
+        if ((e.line = strdup(p + 1)) == NULL)
+            unix_error("replay");
+        entries[nentries++] = e;
+    }
+    fclose(f);
+    replaying = 1;
+    timed = at_times;
+    clock_gettime(CLOCK_MONOTONIC, &replay_start);
+}
+
+/* by_deviation - qsort() order of entries, the most slowed down first */
+static int by_deviation(const void *a, const void *b)
+{
+    const struct entry *x = a, *y = b;
+    long long dx = x->took - x->duration, dy = y->took - y->duration;
+
+    return dx < dy ? 1 : dx > dy ? -1 : 0;
+}
+
+/* ms - Format microseconds as signed milliseconds */
+static char *ms(char *buf, long long us)
+{
+    sprintf(buf, "%+.2fms", us / 1000.0);
+    return buf;
+}
+
+/* report - The replay is over: how did it go? */
+static void report(void)
+{
+    char a[32], b[32], c[32];
+    struct entry *sorted;
+    long long total = since(&replay_start), recorded = 0, sum = 0;
+    int changed = 0, shown = 0;
+
+    if (nentries)
+        recorded = entries[nentries - 1].arrival + entries[nentries - 1].duration - entries[0].arrival;
+    fprintf(stderr, "replay: %d lines in %.3fs, recorded %.3fs\n", next, total / 1e6, recorded / 1e6);
+    if (next == 0)
+        return;
+
+    for (int i = 0; i < next; i++)
+    {
+        sum += entries[i].took - entries[i].duration;
+        changed += entries[i].now_status != entries[i].status;
+    }
+    if ((sorted = malloc(next * sizeof(*sorted))) == NULL)
+        return;
+    memcpy(sorted, entries, next * sizeof(*sorted));
+    qsort(sorted, next, sizeof(*sorted), by_deviation);
+    fprintf(stderr, "replay: deviation per line: mean %s, p50 %s, p99 %s\n",
+            ms(a, sum / next), ms(b, sorted[next / 2].took - sorted[next / 2].duration),
+            ms(c, sorted[next / 100].took - sorted[next / 100].duration));
+    for (int i = 0; i < next && i < WORST; i++)
+        fprintf(stderr, "replay:   %s (%.2fms, was %.2fms)  %s\n",
+                ms(a, sorted[i].took - sorted[i].duration), sorted[i].took / 1e3,
+                sorted[i].duration / 1e3, sorted[i].line);
+    free(sorted);
+
+    if (changed)
+        fprintf(stderr, "replay: %d line%s left another status:\n", changed, changed > 1 ? "s" : "");
+    for (int i = 0; i < next && shown < WORST; i++)
+        if (entries[i].now_status != entries[i].status)
+        {
+            fprintf(stderr, "replay:   line %d: %d, was %d  %s\n", i + 1,
+                    entries[i].now_status, entries[i].status, entries[i].line);
+            shown++;
+        }
+}
+
+/*
+ * replay_next - The next line of the replay, with its newline, into buf
+ *     (size bytes). Returns 0, or -1 when the replay is over.
+ */
+int replay_next(char *buf, int size)
+{
+    long long wait;
+
+    if (next == nentries)
+    {
+        report();
+        replaying = 0;
+        return -1;
+    }
+    /* --timed: not before the line came in the recording */
+    while (timed && (wait = entries[next].arrival - entries[0].arrival - since(&replay_start)) > 0)
+        wait_input(-1, wait / 1000 + 1);
+    snprintf(buf, size, "%s\n", entries[next].line);
+    return 0;
+}
+
+/*
+ * record_begin - A line was read and is about to run
+ */
+void record_begin(const char *line)
+{
+    if (!rec && !replaying)
+        return;
+    arrived = since(&origin);
+    snprintf(current, sizeof(current), "%.*s", (int)strcspn(line, "\n"), line);
+    clock_gettime(CLOCK_MONOTONIC, &begun);
+}
+
+/*
+ * record_end - The line ran and left status
+ */
+void record_end(int status)
+{
+    long long took;
+
+    if (!rec && !replaying)
+        return;
+    took = since(&begun);
+    if (replaying && next < nentries)
+    {
+        entries[next].took = took;
+        entries[next].now_status = status;
+        next++;
+    }
+    if (rec)
+    {
+        fprintf(rec, "%lld\t%lld\t%d\t%s\n", arrived, took, status, current);
+        fflush(rec);
+    }
+}
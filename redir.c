@@ -0,0 +1,303 @@
+/*
+ * zsh - A mini shell program
+ * NKU OS Course
+ * Shuhao Zhang
+ *
+ * file: redir.c
+ *
+ * Input redirection, here-documents, here-strings and process
+ * substitution:
+ *     cmd < file      file is the stdin of cmd
+ *     cmd <<EOF       the lines up to EOF are the stdin of cmd
+ *     cmd <<< word    word and a newline are the stdin of cmd
+ *     cmd <(cmd2)     cmd2's stdout, as a file name (/dev/fd/N)
+ *     cmd >(cmd2)     cmd2's stdin, as a file name
+ *
+ * redir_parse() takes these out of argv before eval() looks at the
+ * command. Here-document bodies and here-strings are written into a
+ * memfd, so even a body of many MB costs no temp file and no helper
+ * process; the memfd becomes the stdin of its pipeline stage, like a
+ * file opened for `<`. The builtins read and mapfile take it, too. Process
+ * substitutions get a pipe: launch_job() starts cmd2 with its end of the
+ * pipe, and the stage inherits the other end under the /dev/fd name put
+ * in its argv. cmd2 joins the job's process group, so it is reaped and
+ * signalled with the job.
+ */
+#include "main.h"
+#include <sys/mman.h>
+
+static char *(*input_line)(char *buf, int size) = NULL;
+
+/*
+ * redir_input - Set where here-document bodies are read from, like
+ *     fgets() with a size; NULL reads stdin.
+ */
+void redir_input(char *(*fn)(char *buf, int size))
+{
+    input_line = fn;
+}
+
+/* next_line - Read the next line of input, or part of a long one */
+static char *next_line(char *buf, int size)
+{
+    if (input_line)
+        return input_line(buf, size);
+    return in_gets(buf, size);
+}
+
+/* memfd_open - Create an empty memfd */
+static int memfd_open(const char *name)
+{
+    int fd;
+
+    if ((fd = memfd_create(name, MFD_CLOEXEC)) < 0)
+        printf("%s: %s\n", name, strerror(errno));
+    return fd;
+}
+
+/* memfd_flush - Write buf[0..*n) to fd and empty the buffer */
+static int memfd_flush(int fd, char *buf, size_t *n)
+{
+    size_t done;
+    ssize_t w;
+
+    for (done = 0; done < *n; done += w)
+        if ((w = write(fd, buf + done, *n - done)) < 0)
+        {
+            printf("here-document: %s\n", strerror(errno));
+            return -1;
+        }
+    *n = 0;
+    return 0;
+}
+
+/* heredoc - Read a here-document body up to the line delim into a memfd */
+static int heredoc(const char *delim)
+{
+    static char buf[64 * 1024];     /* batches many short lines per write */
+    char line[MAXLINE];
+    size_t n = 0, len;
+    int fd, bol = 1;                /* at the start of a line */
+
+    if ((fd = memfd_open("here-document")) < 0)
+        return -1;
+    while (1)
+    {
+        if (bol && isatty(STDIN_FILENO) && !input_line)
+        {
+            printf("> ");
+            fflush(stdout);
+        }
+        if (next_line(line, sizeof(line)) == NULL)
+            break;                  /* end of input ends the body, too */
+        len = strlen(line);
+        if (bol && !strncmp(line, delim, strlen(delim))
+            && (line[strlen(delim)] == '\n' || line[strlen(delim)] == '\0'))
+            break;
+        bol = len > 0 && line[len - 1] == '\n';
+
+        if (n + len > sizeof(buf) && memfd_flush(fd, buf, &n) < 0)
+            goto fail;
+        memcpy(buf + n, line, len);
+        n += len;
+    }
+    if (memfd_flush(fd, buf, &n) < 0)
+        goto fail;
+    lseek(fd, 0, SEEK_SET);
+    return fd;
+
+fail:
+    close(fd);
+    return -1;
+}
+
+/* herestring - Put word and a newline into a memfd */
+static int herestring(const char *word)
+{
+    size_t n = strlen(word);
+    char *buf;
+    int fd;
+
+    if ((fd = memfd_open("here-string")) < 0)
+        return -1;
+    if ((buf = malloc(n + 1)) == NULL)
+    {
+        close(fd);
+        return -1;
+    }
+    memcpy(buf, word, n);
+    buf[n++] = '\n';
+    if (memfd_flush(fd, buf, &n) < 0)
+    {
+        free(buf);
+        close(fd);
+        return -1;
+    }
+    free(buf);
+    lseek(fd, 0, SEEK_SET);
+    return fd;
+}
+
+/*
+ * redir_parse - Take the input redirections, here-documents, here-strings
+ *     and process substitutions out of argv (ending with NULL) into r. Returns 0, or
+ *     -1 after printing an error and releasing what r held.
+ */
+int redir_parse(char **argv, struct redir *r)
+{
+    struct subst *s;
+    char *word;
+    int i, w, stage = 0, fd, pd[2];
+
+    memset(r, 0, sizeof(*r));
+    for (i = 0; i < MAXPIPE; i++)
+        r->in[i] = -1;
+    r->out = -1;
+
+    for (i = 0, w = 0; argv[i]; i++)
+    {
+        if (!strcmp(argv[i], "|"))
+            stage++;
+        if (stage >= MAXPIPE)
+        {
+            argv[w++] = argv[i];
+            continue;
+        }
+
+        if (!strncmp(argv[i], "<<", 2))
+        {
+            /* <<<word, <<< word, <<WORD, << WORD */
+            int str = argv[i][2] == '<';
+
+            word = argv[i] + (str ? 3 : 2);
+            if (!*word && (word = argv[++i]) == NULL)
+            {
+                printf("syntax error near unexpected token `newline'\n");
+                goto fail;
+            }
+            if ((fd = str ? herestring(word) : heredoc(word)) < 0)
+                goto fail;
+            if (r->in[stage] >= 0)
+                close(r->in[stage]);
+            r->in[stage] = fd;
+            continue;
+        }
+
+        if (argv[i][0] == '<' && argv[i][1] != '(')
+        {
+            /* <file, < file */
+            word = argv[i] + 1;
+            if (!*word && (word = argv[++i]) == NULL)
+            {
+                printf("syntax error near unexpected token `newline'\n");
+                goto fail;
+            }
+            if ((fd = open(word, O_RDONLY | O_CLOEXEC)) < 0)
+            {
+                printf("%s: %s\n", word, strerror(errno));
+                goto fail;
+            }
+            if (r->in[stage] >= 0)
+                close(r->in[stage]);
+            r->in[stage] = fd;
+            continue;
+        }
+
+        if ((argv[i][0] == '<' || argv[i][0] == '>') && argv[i][1] == '(')
+        {
+            if (r->nsub == MAXSUBST)
+            {
+                printf("Too many process substitutions\n");
+                goto fail;
+            }
+            s = &r->sub[r->nsub];
+            s->out = argv[i][0] == '>';
+            s->stage = stage;
+            s->argc = 0;
+
+            /* the command runs up to the word that ends with ')' */
+            word = argv[i] + 2;
+            while (1)
+            {
+                size_t n = strlen(word);
+                int last = n > 0 && word[n - 1] == ')';
+
+                if (last)
+                    word[n - 1] = '\0';
+                if (*word && s->argc < MAXSUBARGS - 1)
+                    s->argv[s->argc++] = word;
+                if (last)
+                    break;
+                if ((word = argv[++i]) == NULL)
+                {
+                    printf("syntax error: missing `)'\n");
+                    goto fail;
+                }
+            }
+            s->argv[s->argc] = NULL;
+            if (s->argc == 0)
+            {
+                printf("syntax error near unexpected token `)'\n");
+                goto fail;
+            }
+
+            if (pipe2(pd, O_CLOEXEC) < 0)
+                unix_error("pipe error");
+            s->fd = s->out ? pd[1] : pd[0];     /* the stage's end */
+            s->subfd = s->out ? pd[0] : pd[1];  /* the command's end */
+            r->nsub++;
+            sprintf(s->path, "/dev/fd/%d", s->fd);
+            argv[w++] = s->path;
+            continue;
+        }
+        argv[w++] = argv[i];
+    }
+    argv[w] = NULL;
+    return 0;
+
+fail:
+    argv[w] = NULL;
+    redir_close(r);
+    return -1;
+}
+
+/*
+ * redir_used - Does r hold anything?
+ */
+int redir_used(struct redir *r)
+{
+    if (r->nsub || r->out >= 0)
+        return 1;
+    for (int i = 0; i < MAXPIPE; i++)
+        if (r->in[i] >= 0)
+            return 1;
+    return 0;
+}
+
+/*
+ * redir_close - Close what the shell still holds of r, once the job is
+ *     started (or not started at all).
+ */
+void redir_close(struct redir *r)
+{
+    for (int i = 0; i < MAXPIPE; i++)
+    {
+        if (r->in[i] >= 0)
+        {
+            io_forget(r->in[i]);
+            close(r->in[i]);
+        }
+        r->in[i] = -1;
+    }
+    if (r->out >= 0)
+        close(r->out);
+    r->out = -1;
+    for (int i = 0; i < r->nsub; i++)
+    {
+        if (r->sub[i].fd >= 0)
+            close(r->sub[i].fd);
+        if (r->sub[i].subfd >= 0)
+            close(r->sub[i].subfd);
+    }
+    r->nsub = 0;
+}
@@ -0,0 +1,284 @@
+/*
+ * zsh - A mini shell program
+ * NKU OS Course
+ * Shuhao Zhang
+ *
+ * file: sched.c
+ *
+ * Job dependencies: `after %1 %3 -- cmd` queues cmd as a job in the QU
+ * state until jobs 1 and 3 have finished successfully, then starts it in
+ * the background. If one of them fails, cmd is cancelled, and so is
+ * everything queued after it. `after -j N` caps how many queued jobs run
+ * at once (default: one per CPU, 0 for no cap).
+ *
+ * A job is named by its jid only when it is queued; the dependency
+ * itself is on the job's seq number, which is never reused. When
+ * sigchld_handler() reaps the last process of a job it calls
+ * sched_done(), which ticks the dependency off every queued job. The
+ * jobs are then started from the main flow by sched_run(), which runs
+ * from the shell's wait path (see service_events()), so nothing is
+ * forked from inside the signal handler.
+ */
+#include "main.h"
+
+extern struct job_t jobs[MAXJOBS];
+extern int nextjid;
+
+/* A queued command */
+struct sched {
+    int ndeps;                  /* jobs it still waits for */
+    int failed;                 /* one of them failed */
+    unsigned long *deps;        /* their seq numbers */
+    char **argv;                /* the command; deps and strings follow */
+};
+
+static int sched_cap = -1;          /* max running queued jobs, 0: no cap */
+static volatile int sched_pending;  /* a job finished or was queued */
+static int nqueued = 0;             /* jobs in the QU state */
+
+/*
+ * sched_queued - Return true if some job is waiting in the queue.
+ */
+int sched_queued(void)
+{
+    return nqueued > 0;
+}
+
+/*
+ * sched_wait - Before the shell exits, wait until the queued jobs have
+ *     been started or cancelled. Gives up when only stopped jobs are
+ *     left to wait for.
+ */
+void sched_wait(void)
+{
+    sigset_t mask, prev;
+    int live, i;
+
+    sigemptyset(&mask);
+    sigaddset(&mask, SIGCHLD);
+    sigprocmask(SIG_BLOCK, &mask, &prev);
+    while (1)
+    {
+        sched_run();
+        for (live = 0, i = 0; nqueued && i < MAXJOBS; i++)
+            if (jobs[i].state == BG || jobs[i].state == FG)
+                live = 1;
+        if (!live)
+            break;
+        wait_event(&prev);
+    }
+    sigprocmask(SIG_SETMASK, &prev, NULL);
+}
+
+/*
+ * sched_forget - Drop the queue in a forked copy of the shell that starts
+ *     over with an empty job list.
+ */
+void sched_forget(void)
+{
+    nqueued = 0;
+    sched_pending = 0;
+}
+
+/*
+ * sched_done - Tick job off the dependencies of the queued jobs, ok
+ *     tells whether it succeeded. Called from sigchld_handler() when
+ *     the last process of job is reaped, and by sched_run() for jobs
+ *     it cancels.
+ */
+void sched_done(struct job_t *job, int ok)
+{
+    struct sched *s;
+
+    if (job->scheduled)
+        sched_pending = 1;
+    if (nqueued == 0)
+        return;
+
+    for (int i = 0; i < MAXJOBS; i++)
+    {
+        if (jobs[i].state != QU || (s = jobs[i].sched) == NULL)
+            continue;
+        for (int d = 0; d < s->ndeps; d++)
+        {
+            if (s->deps[d] != job->seq)
+                continue;
+            s->deps[d--] = s->deps[--s->ndeps];
+            if (!ok)
+                s->failed = 1;
+            sched_pending = 1;
+        }
+    }
+}
+
+/* dequeue - Free the queued command of job, it is started or cancelled */
+static void dequeue(struct job_t *job)
+{
+    free(job->sched);
+    job->sched = NULL;
+    nqueued--;
+}
+
+/* start - Launch the command queued in job, in that same job slot */
+static void start(struct job_t *job)
+{
+    struct sched *s = job->sched;
+    struct spawn_attr attr;
+    char **args;
+
+    job->scheduled = 1;
+    if ((args = job_prefixes(s->argv, &attr)) != NULL)
+        launch_job(args, BG, job->cmdline, &attr, job, NULL);
+    dequeue(job);
+
+    /* launch_job() refused the command, e.g. a bad pipeline */
+    if (job->state == QU)
+    {
+        sched_done(job, 0);
+        clearjob(job);
+        nextjid = maxjid(jobs) + 1;
+    }
+}
+
+/*
+ * sched_run - Cancel queued jobs whose dependencies failed and start the
+ *     ones that are ready, oldest first, as far as the cap allows.
+ */
+void sched_run(void)
+{
+    struct job_t *next;
+    sigset_t mask, prev;
+    int running, i, again;
+
+    if (!sched_pending)
+        return;
+
+    sigemptyset(&mask);
+    sigaddset(&mask, SIGCHLD);
+    sigprocmask(SIG_BLOCK, &mask, &prev);
+    sched_pending = 0;
+
+    /* a cancelled job fails the jobs queued after it, too */
+    do
+    {
+        again = 0;
+        for (i = 0; i < MAXJOBS; i++)
+        {
+            if (jobs[i].state != QU || !jobs[i].sched || !jobs[i].sched->failed)
+                continue;
+            printf("[%d] Cancelled, a job it waits for failed: %s\n", jobs[i].jid, jobs[i].cmdline);
+            dequeue(&jobs[i]);
+            sched_done(&jobs[i], 0);
+            clearjob(&jobs[i]);
+            nextjid = maxjid(jobs) + 1;
+            again = 1;
+        }
+    } while (again);
+
+    if (sched_cap < 0)
+        sched_cap = sysconf(_SC_NPROCESSORS_ONLN);
+    for (running = 0, i = 0; i < MAXJOBS; i++)
+        if (jobs[i].jid && jobs[i].scheduled && jobs[i].state != QU)
+            running++;
+
+    while (nqueued && (sched_cap == 0 || running < sched_cap))
+    {
+        next = NULL;
+        for (i = 0; i < MAXJOBS; i++)
+            if (jobs[i].state == QU && jobs[i].sched->ndeps == 0
+                && (!next || jobs[i].seq < next->seq))
+                next = &jobs[i];
+        if (!next)
+            break;
+        start(next);
+        running++;
+    }
+
+    fflush(stdout);
+    sigprocmask(SIG_SETMASK, &prev, NULL);
+}
+
+/*
+ * do_after - Execute the builtin after command:
+ *     after -j N                      cap the running queued jobs
+ *     after [%jobid|pid ...] -- cmd   queue cmd until the jobs succeed
+ */
+void do_after(char **argv, char *cmdline)
+{
+    struct spawn_attr attr;
+    struct job_t *job, *deps[MAXARGS];
+    sigset_t mask, prev;
+    struct sched *s;
+    size_t size;
+    char *p;
+    int ndeps = 0, argc, i, id;
+
+    if (argv[1] && !strcmp(argv[1], "-j"))
+    {
+        if (!argv[2])
+            printf("%d\n", sched_cap < 0 ? (int)sysconf(_SC_NPROCESSORS_ONLN) : sched_cap);
+        else if ((sched_cap = atoi(argv[2])) < 0)
+            sched_cap = 0;
+        sched_pending = 1;
+        return;
+    }
+
+    sigemptyset(&mask);
+    sigaddset(&mask, SIGCHLD);
+    sigprocmask(SIG_BLOCK, &mask, &prev);
+
+    for (i = 1; argv[i] && strcmp(argv[i], "--"); i++)
+    {
+        if (argv[i][0] == '%')
+            job = (id = atoi(argv[i] + 1)) > 0 ? getjobjid(jobs, id) : NULL;
+        else
+            job = (id = atoi(argv[i])) > 0 ? getjobpid(jobs, id) : NULL;
+        if (!job)
+        {
+            printf("after: %s: No such job\n", argv[i]);
+            goto out;
+        }
+        if (ndeps == MAXARGS)
+        {
+            printf("after: too many jobs\n");
+            goto out;
+        }
+        deps[ndeps++] = job;
+    }
+    if (!argv[i] || !argv[i + 1])
+    {
+        printf("usage: after [%%jobid|pid ...] -- cmd | after -j N\n");
+        goto out;
+    }
+    argv += i + 1;
+    if (job_prefixes(argv, &attr) == NULL)
+        goto out;
+
+    /* one block: the struct, the deps, argv and its strings */
+    for (argc = 0, size = 0; argv[argc]; argc++)
+        size += strlen(argv[argc]) + 1;
+    size += sizeof(*s) + ndeps * sizeof(unsigned long) + (argc + 1) * sizeof(char *);
+    if ((s = malloc(size)) == NULL || (job = newjob(jobs, 0, QU, cmdline)) == NULL)
+    {
+        free(s);
+        goto out;
+    }
+    s->ndeps = ndeps;
+    s->failed = 0;
+    s->deps = (unsigned long *)(s + 1);
+    s->argv = (char **)(s->deps + ndeps);
+    for (i = 0; i < ndeps; i++)
+        s->deps[i] = deps[i]->seq;
+    p = (char *)(s->argv + argc + 1);
+    for (i = 0; i < argc; i++, p += strlen(p) + 1)
+        s->argv[i] = strcpy(p, argv[i]);
+    s->argv[argc] = NULL;
+
+    job->sched = s;
+    nqueued++;
+    sched_pending = 1;
+    printf("[%d] Queued %s\n", job->jid, cmdline);
+
+out:
+    sigprocmask(SIG_SETMASK, &prev, NULL);
+}
@@ -0,0 +1,355 @@
+/*
+ * zsh - A mini shell program
+ * NKU OS Course
+ * Shuhao Zhang
+ *
+ * file: server.c
+ *
+ * Command server mode (zsh -S sock). A long-lived shell accepts scripts
+ * over a Unix domain socket, so batch runners do not pay for a new
+ * interpreter per script. Each script runs in a forked copy of the warm
+ * server, which gives it its own variables, with the client's stdin,
+ * stdout and stderr passed in as SCM_RIGHTS. The copies are ordinary
+ * background jobs of the server; when one is reaped, sigchld_handler()
+ * calls server_notify() to send its exit status back to the client.
+ *
+ * Protocol (see zshc.c): the client sends an int holding the script's
+ * length, with its three stdio fds attached, then the script itself. The
+ * server answers with one int, the script's exit status, or -1 if it
+ * could not run it.
+ */
+#include "main.h"
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+extern struct job_t jobs[MAXJOBS];
+extern int verbose;
+
+#define MAXPENDING 64            /* connections still sending their script */
+
+/* A connection whose request has not fully arrived yet */
+static struct pending {
+    int conn;                   /* -1: free */
+    int fds[3];                 /* the client's stdio */
+    int len;                    /* of the script, -1 until the header came */
+    size_t got;
+    char *script;
+} pending[MAXPENDING];
+
+static int listen_fd = -1;
+
+static void accept_client(void);
+static void read_client(struct pending *p);
+static void start_script(struct pending *p);
+static void run_script(char *script);
+
+/*
+ * server_run - Accept scripts on the socket at path forever. Connections
+ *     are non-blocking and polled along with the socket, so a client that
+ *     is slow to send its script holds up no other.
+ */
+void server_run(const char *path)
+{
+    struct sockaddr_un addr;
+    struct pollfd pfd[MAXPENDING + 1];
+    struct pending *from[MAXPENDING + 1];
+    sigset_t mask, prev;
+    int n;
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (strlen(path) >= sizeof(addr.sun_path))
+        app_error("server socket path too long");
+    strcpy(addr.sun_path, path);
+
+    if ((listen_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0)) < 0)
+        unix_error("socket error");
+    unlink(path);
+    if (bind(listen_fd, (struct sockaddr *)&addr, sizeof(addr)) < 0)
+        unix_error("bind error");
+    if (listen(listen_fd, SOMAXCONN) < 0)
+        unix_error("listen error");
+    if (verbose)
+        printf("server: listening on %s\n", path);
+    for (int i = 0; i < MAXPENDING; i++)
+        pending[i].conn = -1;
+
+    sigemptyset(&mask);
+    sigaddset(&mask, SIGCHLD);
+    while (1)
+    {
+        /* with a full job table, wait for a script to finish first */
+        sigprocmask(SIG_BLOCK, &mask, &prev);
+        while (freejobs(jobs) == 0)
+            wait_event(&prev);
+        sigprocmask(SIG_SETMASK, &prev, NULL);
+
+        /* the socket, unless every pending slot is taken, and the
+         * connections still sending */
+        n = 0;
+        for (int i = 0; i < MAXPENDING; i++)
+        {
+            if (pending[i].conn < 0)
+                continue;
+            pfd[n].fd = pending[i].conn;
+            pfd[n].events = POLLIN;
+            from[n++] = &pending[i];
+        }
+        if (n < MAXPENDING)
+        {
+            pfd[n].fd = listen_fd;
+            pfd[n].events = POLLIN;
+            from[n++] = NULL;
+        }
+        /* SIGCHLD interrupts the poll: reaped scripts are answered by
+         * the handler */
+        if (poll(pfd, n, -1) < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            unix_error("poll error");
+        }
+        for (int i = 0; i < n; i++)
+        {
+            if (!pfd[i].revents)
+                continue;
+            if (from[i])
+                read_client(from[i]);
+            else
+                accept_client();
+        }
+        fflush(stdout);
+    }
+}
+
+/* accept_client - Take a new connection into a free pending slot */
+static void accept_client(void)
+{
+    struct pending *p = pending;
+    int conn;
+
+    if ((conn = accept4(listen_fd, NULL, NULL, SOCK_CLOEXEC | SOCK_NONBLOCK)) < 0)
+    {
+        if (errno == EINTR || errno == ECONNABORTED || errno == EAGAIN)
+            return;
+        unix_error("accept error");
+    }
+    while (p->conn >= 0)
+        p++;
+    p->conn = conn;
+    p->fds[0] = p->fds[1] = p->fds[2] = -1;
+    p->len = -1;
+    p->got = 0;
+    p->script = NULL;
+}
+
+/*
+ * drop - Forget the pending connection p, answering fail (-1) first if
+ *     answer is set
+ */
+static void drop(struct pending *p, int answer)
+{
+    int fail = -1;
+
+    free(p->script);
+    for (int i = 0; i < 3; i++)
+        if (p->fds[i] >= 0)
+            close(p->fds[i]);
+    if (p->conn >= 0)
+    {
+        /* the client may be gone: no SIGPIPE for the server */
+        if (answer)
+            send(p->conn, &fail, sizeof(fail), MSG_NOSIGNAL);
+        close(p->conn);
+    }
+    p->conn = -1;
+}
+
+/*
+ * read_client - Read what arrived of p's request: the header with the
+ *     stdio fds, then the script. Starts the script once all of it came.
+ */
+static void read_client(struct pending *p)
+{
+    int len;
+    struct iovec iov = { &len, sizeof(len) };
+    struct msghdr msg;
+    union {
+        struct cmsghdr hdr;
+        char buf[CMSG_SPACE(3 * sizeof(int))];
+    } ctl;
+    struct cmsghdr *cmsg;
+    ssize_t r;
+
+    if (p->len < 0)
+    {
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_iov = &iov;
+        msg.msg_iovlen = 1;
+        msg.msg_control = ctl.buf;
+        msg.msg_controllen = sizeof(ctl.buf);
+        if ((r = recvmsg(p->conn, &msg, MSG_CMSG_CLOEXEC)) < 0 && (errno == EAGAIN || errno == EINTR))
+            return;
+        for (cmsg = CMSG_FIRSTHDR(&msg); r > 0 && cmsg; cmsg = CMSG_NXTHDR(&msg, cmsg))
+            if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS)
+                memcpy(p->fds, CMSG_DATA(cmsg), sizeof(p->fds));
+        if (r != sizeof(len) || len < 0)
+        {
+            drop(p, 0);
+            return;
+        }
+        if ((p->script = malloc(len + 1)) == NULL)
+        {
+            drop(p, 1);
+            return;
+        }
+        p->len = len;
+    }
+
+    while (p->got < (size_t)p->len)
+    {
+        if ((r = read(p->conn, p->script + p->got, p->len - p->got)) < 0
+            && (errno == EAGAIN || errno == EINTR))
+            return;
+        if (r <= 0)
+        {
+            drop(p, 1);
+            return;
+        }
+        p->got += r;
+    }
+    p->script[p->len] = '\0';
+    start_script(p);
+}
+
+/*
+ * start_script - Start the script of p as a background job. Its
+ *     connection stays open until the job is reaped.
+ */
+static void start_script(struct pending *p)
+{
+    struct job_t *job;
+    sigset_t mask;
+    pid_t pid;
+
+    sigemptyset(&mask);
+    sigaddset(&mask, SIGCHLD);
+    sigprocmask(SIG_BLOCK, &mask, NULL);
+
+    fflush(stdout);
+    if ((pid = fork()) < 0)
+    {
+        sigprocmask(SIG_UNBLOCK, &mask, NULL);
+        drop(p, 1);
+        return;
+    }
+    if (pid == 0)
+    {
+        /* the script gets a fresh shell state of its own */
+        for (int i = 0; i < jobs_used; i++)
+            if (jobs[i].notify_fd >= 0)
+                close(jobs[i].notify_fd);
+        initjobs(jobs);
+        sched_forget();
+        close(listen_fd);
+        /* nor does it keep the other clients' connections and stdio */
+        for (int i = 0; i < MAXPENDING; i++)
+        {
+            if (pending[i].conn < 0)
+                continue;
+            close(pending[i].conn);
+            for (int j = 0; &pending[i] != p && j < 3; j++)
+                if (pending[i].fds[j] >= 0)
+                    close(pending[i].fds[j]);
+        }
+        /* the launcher socket belongs to the server */
+        launcher_lost();
+        setpgid(0, 0);
+        sigprocmask(SIG_UNBLOCK, &mask, NULL);
+        for (int i = 0; i < 3; i++)
+            if (p->fds[i] >= 0)
+                dup2(p->fds[i], i);
+        run_script(p->script);
+    }
+
+    if (addjob(jobs, pid, BG, "(server script) ") && (job = getjobpid(jobs, pid)))
+    {
+        job->notify_fd = p->conn;
+        p->conn = -1;
+    }
+    sigprocmask(SIG_UNBLOCK, &mask, NULL);
+    drop(p, 1);
+}
+
+static char *script_pos;    /* next line of the running script */
+
+/* script_line - Read the next line of the running script, like fgets() */
+static char *script_line(char *buf, int size)
+{
+    size_t n;
+
+    if (!*script_pos)
+        return NULL;
+    if ((n = strcspn(script_pos, "\n")) < (size_t)size - 1 && script_pos[n])
+        n++;                    /* the newline, too */
+    else if (n > (size_t)size - 1)
+        n = size - 1;
+    memcpy(buf, script_pos, n);
+    buf[n] = '\0';
+    script_pos += n;
+    return buf;
+}
+
+/*
+ * eval_script - Evaluate every line of script and wait for the jobs it
+ *     queued with after. Returns the status of the last command. Here-
+ *     documents read their bodies from the script, too.
+ */
+int eval_script(char *script)
+{
+    char cmdlines[MAXLINE];
+    size_t n;
+
+    script_pos = script;
+    redir_input(script_line);
+    while (script_line(cmdlines, MAXLINE - 1))
+    {
+        /* eval() expects a trailing space where the newline was */
+        n = strlen(cmdlines);
+        if (n && cmdlines[n - 1] == '\n')
+            n--;
+        cmdlines[n] = ' ';
+        cmdlines[n + 1] = '\0';
+        eval_lines(cmdlines);
+    }
+    sched_wait();
+    redir_input(NULL);
+    return last_status;
+}
+
+/*
+ * run_script - Evaluate script, then exit with the status of the last
+ *     command. Runs in the forked copy of the server.
+ */
+static void run_script(char *script)
+{
+    int status = eval_script(script);
+
+    fflush(stdout);
+    exit(status);
+}
+
+/*
+ * server_notify - Send the exit status of a finished script job to its
+ *     client. Called from sigchld_handler().
+ */
+void server_notify(struct job_t *job)
+{
+    int status = job->status;
+
+    status = WIFEXITED(status) ? WEXITSTATUS(status) : 128 + WTERMSIG(status);
+    send(job->notify_fd, &status, sizeof(status), MSG_NOSIGNAL);
+    close(job->notify_fd);
+    job->notify_fd = -1;
+}
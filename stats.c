@@ -0,0 +1,389 @@
+/*
+ * zsh - A mini shell program
+ * NKU OS Course
+ * Shuhao Zhang
+ *
+ * file: stats.c
+ *
+ * Live job statistics for `jobs -l` and the `jobs -w N` watch mode: CPU
+ * usage, resident memory, disk I/O and threads, summed over every
+ * process in the process group of each job (the pipeline stages and
+ * whatever they started: make -j, xargs -P, scripts), read from
+ * /proc/PID/stat and /proc/PID/io.
+ *
+ * The members of a group are found from the job's stages down:
+ * /proc/PID/task/TID/children lists the children of a process, and a
+ * child still in the group is a member too. The files of a member are
+ * opened when it is first found and kept open in a table; every sample
+ * is a pread() at offset 0, which makes the kernel regenerate the file,
+ * so a known member costs three system calls and no path lookups (a
+ * multi-threaded one also a listing of its threads, each of which has a
+ * children file). Only a new child costs an open, no other process on
+ * the host is looked at. A process whose parent exited before a refresh
+ * saw it is no one's child in the group, and is missed. CPU% is measured
+ * against the previous sample of the same process, or against its whole
+ * lifetime the first time. Entries whose process left its group or is
+ * gone are closed at the refresh that notices.
+ */
+#include "main.h"
+#include <dirent.h>
+#include <time.h>
+
+extern struct job_t jobs[MAXJOBS];
+
+/* Open /proc files of one process, and its previous sample */
+struct pstat {
+    pid_t pid;                  /* 0: unused */
+    pid_t pgid;                 /* the job's group it was found in */
+    int threads;                /* of the previous sample */
+    int statfd, iofd, childfd;  /* -1 if the file could not be opened */
+    unsigned long long ticks;   /* utime + stime of the previous sample */
+    double when;                /* CLOCK_BOOTTIME of the previous sample */
+};
+
+/* What one job uses, summed over its processes */
+struct jstat {
+    double cpu;                 /* percent of one CPU */
+    unsigned long long rss;     /* bytes */
+    unsigned long long rbytes, wbytes;
+    int threads;
+    int io;                     /* /proc/PID/io was readable */
+};
+
+static struct pstat *pst;       /* the group members found so far, pst[0..npst) */
+static int npst, pstcap;
+static struct jstat js[MAXJOBS];        /* by job slot, for a refresh */
+
+/* boottime - Seconds since boot, the clock /proc/PID/stat counts in */
+static double boottime(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_BOOTTIME, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* pst_close - Close the files of a table entry */
+static void pst_close(struct pstat *p)
+{
+    if (p->statfd >= 0)
+        close(p->statfd);
+    if (p->iofd >= 0)
+        close(p->iofd);
+    if (p->childfd >= 0)
+        close(p->childfd);
+    p->pid = 0;
+}
+
+/* pst_add - Append a table entry for member pid of group pgid, whose
+ * stat file is open as statfd */
+static struct pstat *pst_add(pid_t pid, pid_t pgid, int statfd)
+{
+    struct pstat *p, *more;
+    char path[64];
+
+    if (npst == pstcap)
+    {
+        pstcap = pstcap ? 2 * pstcap : 64;
+        if ((more = realloc(pst, pstcap * sizeof(*pst))) == NULL)
+            unix_error("jobs");
+        pst = more;
+    }
+    p = &pst[npst++];
+    p->pid = pid;
+    p->pgid = pgid;
+    p->threads = 1;
+    p->ticks = 0;
+    p->when = 0;
+    p->statfd = statfd;
+    p->childfd = -1;
+    sprintf(path, "/proc/%d/io", pid);
+    p->iofd = open(path, O_RDONLY | O_CLOEXEC);
+    return p;
+}
+
+/*
+ * read_stat - Read fields 4..24 of a /proc/PID/stat file into f (f[5] is
+ *     the process group). Returns 0, or -1 if the process is gone.
+ */
+static int read_stat(int fd, unsigned long long f[25])
+{
+    char buf[1024], *s;
+    ssize_t n;
+    int i;
+
+    if (fd < 0 || (n = pread(fd, buf, sizeof(buf) - 1, 0)) <= 0)
+        return -1;
+    /* the command name may hold spaces, fields 3.. follow its ')' */
+    buf[n] = '\0';
+    if ((s = strrchr(buf, ')')) == NULL)
+        return -1;
+    s += 2;
+    for (i = 3; i < 25 && *s; i++)
+    {
+        f[i] = strtoull(s, &s, 10);
+        while (*s == ' ')
+            s++;
+        if (i == 3)                 /* state is a letter */
+            while (*s && *s != ' ')
+                s++;
+    }
+    return i == 25 ? 0 : -1;
+}
+
+/* io_field - Find "name: value" in the text of /proc/PID/io */
+static unsigned long long io_field(const char *buf, const char *name)
+{
+    const char *s = strstr(buf, name);
+
+    return s ? strtoull(s + strlen(name), NULL, 10) : 0;
+}
+
+/* sample - Add what process p, whose stat fields are f, uses now to js */
+static void sample(struct pstat *p, const unsigned long long f[25], double now, struct jstat *js)
+{
+    static long hz = 0, pagesize = 0;
+    unsigned long long ticks;
+    char buf[1024];
+    ssize_t n;
+
+    if (!hz)
+    {
+        hz = sysconf(_SC_CLK_TCK);
+        pagesize = sysconf(_SC_PAGESIZE);
+    }
+    ticks = f[14] + f[15];
+    if (p->when > 0 && now > p->when)
+        js->cpu += 100.0 * (ticks - p->ticks) / hz / (now - p->when);
+    else if (now > (double)f[22] / hz)
+        js->cpu += 100.0 * ticks / hz / (now - (double)f[22] / hz);
+    p->ticks = ticks;
+    p->when = now;
+    p->threads = f[20];
+    js->threads += f[20];
+    js->rss += f[24] * pagesize;
+
+    if (p->iofd >= 0 && (n = pread(p->iofd, buf, sizeof(buf) - 1, 0)) > 0)
+    {
+        buf[n] = '\0';
+        js->rbytes += io_field(buf, "\nread_bytes: ");
+        js->wbytes += io_field(buf, "\nwrite_bytes: ");
+        js->io = 1;
+    }
+}
+
+/* member - The running job whose process group is pgid, or NULL */
+static struct job_t *member(pid_t pgid)
+{
+    struct job_t *job = getjobpid(jobs, pgid);
+
+    return job && job->state != QU ? job : NULL;
+}
+
+/* known - Is pid in the table? */
+static int known(pid_t pid)
+{
+    for (int i = 0; i < npst; i++)
+        if (pst[i].pid == pid)
+            return 1;
+    return 0;
+}
+
+/* found - Add process pid to the table and sample it, if it is in the
+ * group of a running job and not known yet */
+static void found(pid_t pid, double now)
+{
+    unsigned long long f[25];
+    struct job_t *job;
+    char path[64];
+    int fd;
+
+    if (pid <= 0 || known(pid))
+        return;
+    sprintf(path, "/proc/%d/stat", pid);
+    if ((fd = open(path, O_RDONLY | O_CLOEXEC)) < 0)
+        return;
+    if (read_stat(fd, f) < 0 || (job = member((pid_t)f[5])) == NULL)
+    {
+        close(fd);
+        return;
+    }
+    sample(pst_add(pid, (pid_t)f[5], fd), f, now, &js[job - jobs]);
+}
+
+/* found_list - found() for every pid of a children file, n bytes of
+ * which were read into buf, of size n + 1 or more */
+static void found_list(char *buf, ssize_t n, size_t size, double now)
+{
+    char *s, *end;
+
+    if (n <= 0)
+        return;
+    buf[n] = '\0';
+    if ((size_t)n == size - 1 && (s = strrchr(buf, ' ')))
+        *s = '\0';                 /* full: the last pid may be cut */
+    for (s = buf; *s; s = end)
+    {
+        pid_t pid = strtol(s, &end, 10);
+
+        if (end == s)
+            break;
+        found(pid, now);
+    }
+}
+
+/*
+ * children - Look for new members among the children of pst[i]. A
+ *     single-threaded one keeps its children file open; the children
+ *     of the other threads are in files of their own.
+ */
+static void children(int i, double now)
+{
+    char buf[8192], path[64];
+    struct dirent *d;
+    pid_t pid = pst[i].pid;
+    DIR *dp;
+    int fd, tid;
+
+    if (pst[i].threads <= 1)
+    {
+        if (pst[i].childfd < 0)
+        {
+            sprintf(path, "/proc/%d/task/%d/children", pid, pid);
+            pst[i].childfd = open(path, O_RDONLY | O_CLOEXEC);
+        }
+        /* found() may move the table: fd, not pst[i], after this */
+        if ((fd = pst[i].childfd) >= 0)
+            found_list(buf, pread(fd, buf, sizeof(buf) - 1, 0), sizeof(buf), now);
+        return;
+    }
+    sprintf(path, "/proc/%d/task", pid);
+    if ((dp = opendir(path)) == NULL)
+        return;
+    while ((d = readdir(dp)) != NULL)
+    {
+        if ((tid = atoi(d->d_name)) <= 0)
+            continue;
+        sprintf(path, "/proc/%d/task/%d/children", pid, tid);
+        if ((fd = open(path, O_RDONLY | O_CLOEXEC)) < 0)
+            continue;
+        found_list(buf, read(fd, buf, sizeof(buf) - 1), sizeof(buf), now);
+        close(fd);
+    }
+    closedir(dp);
+}
+
+/*
+ * refresh - Sample every process in the groups of the jobs into js[],
+ *     by the job's slot. Called with SIGCHLD blocked.
+ */
+static void refresh(double now)
+{
+    unsigned long long f[25];
+    struct job_t *job;
+    struct pstat *p;
+    int i, k, n = 0;
+
+    memset(js, 0, jobs_used * sizeof(js[0]));
+
+    /* the known members first, through their open files; the entries
+     * of the others are closed and dropped */
+    for (p = pst; p < pst + npst; p++)
+    {
+        if (read_stat(p->statfd, f) == 0 && (pid_t)f[5] == p->pgid && (job = member(p->pgid)))
+        {
+            sample(p, f, now, &js[job - jobs]);
+            pst[n++] = *p;
+        }
+        else
+            pst_close(p);
+    }
+    npst = n;
+
+    /* then the stages, and the children of every member: those found
+     * are appended, so their children are looked at in the same loop */
+    for (i = 0; i < jobs_used; i++)
+        if (jobs[i].jid && jobs[i].state != QU)
+            for (k = 0; k < jobs[i].nprocs; k++)
+                found(jobs[i].pids[k], now);
+    for (i = 0; i < npst; i++)
+        children(i, now);
+}
+
+/* fmt_bytes - Format a byte count the way top does: 512B, 1.5K, 20M */
+static char *fmt_bytes(char *buf, unsigned long long v)
+{
+    const char *unit = "BKMGT";
+    double d = v;
+
+    while (d >= 1024 && unit[1])
+    {
+        d /= 1024;
+        unit++;
+    }
+    if (*unit == 'B')
+        sprintf(buf, "%lluB", v);
+    else
+        sprintf(buf, d < 10 ? "%.1f%c" : "%.0f%c", d, *unit);
+    return buf;
+}
+
+/*
+ * stats_list - Print the jobs with what their processes use now.
+ */
+void stats_list(void)
+{
+    static const char *names[] = { "Undef", "Foreground", "Running", "Stopped", "Queued" };
+    char rss[16], rd[16], wr[16];
+    struct jstat *j;
+    sigset_t mask, prev;
+    int i;
+
+    sigemptyset(&mask);
+    sigaddset(&mask, SIGCHLD);
+    sigprocmask(SIG_BLOCK, &mask, &prev);
+
+    printf("%-6s %7s %-10s %6s %7s %7s %7s %4s  %s\n",
+           "JID", "PGID", "STATE", "CPU%", "RSS", "READ", "WRITE", "THR", "COMMAND");
+    refresh(boottime());
+    for (i = 0; i < jobs_used; i++)
+    {
+        if (jobs[i].jid == 0)
+            continue;
+        j = &js[i];
+
+        printf("[%d]%*s %7d %-10s ", jobs[i].jid, jobs[i].jid < 10 ? 3 : jobs[i].jid < 100 ? 2 : 1, "",
+               jobs[i].pid, names[jobs[i].state]);
+        if (jobs[i].state == QU)
+            printf("%6s %7s %7s %7s %4s  ", "-", "-", "-", "-", "-");
+        else
+            printf("%6.1f %7s %7s %7s %4d  ", j->cpu, fmt_bytes(rss, j->rss),
+                   j->io ? fmt_bytes(rd, j->rbytes) : "-", j->io ? fmt_bytes(wr, j->wbytes) : "-", j->threads);
+        printf("%s\n", jobs[i].cmdline);
+    }
+
+    sigprocmask(SIG_SETMASK, &prev, NULL);
+}
+
+/*
+ * stats_watch - Redraw the job statistics every secs seconds until a
+ *     line is typed (or stdin ends). Deadlines, job output and queued
+ *     jobs are serviced meanwhile, see wait_input().
+ */
+void stats_watch(double secs)
+{
+    int tty = isatty(STDOUT_FILENO);
+
+    while (1)
+    {
+        if (tty)
+            printf("\033[H\033[2J");
+        stats_list();
+        if (tty)
+            printf("\nEvery %.1fs, press Enter to stop\n", secs);
+        fflush(stdout);
+        /* input the shell already read ahead counts as typed */
+        if (in_buffered() || wait_input(STDIN_FILENO, secs * 1000))
+            break;
+    }
+}
@@ -0,0 +1,917 @@
+/*
+ * zsh - A mini shell program
+ * NKU OS Course
+ * Shuhao Zhang
+ *
+ * file: text.c
+ *
+ * The builtins wc, head and grep -F:
+ *     wc [-lwc] [file ...]             lines, words and bytes
+ *     head [-n N | -N | -c N] [file ...]
+ *     grep -F [-cvqn] pattern [file ...]
+ * Other options (and grep without -F) are left to the real commands.
+ *
+ * Like xargs, the shell runs them itself when they are the last stage of
+ * a foreground pipeline, reading the pipe from the other stages in large
+ * blocks (see stage_input()), or when they are the whole command. head
+ * closes the pipe as soon as it has its lines, so the stages writing it
+ * get SIGPIPE instead of producing the rest. In other stages, and in the
+ * background, spawn() forks as usual and the child runs them without an
+ * execve().
+ *
+ * Counting newlines, finding word starts and searching for the pattern
+ * are done 32 (AVX2) or 16 (SSE2) bytes at a time, whichever the CPU
+ * has, with byte-at-a-time versions for other CPUs; ZSH_SIMD=scalar,
+ * sse2 or avx2 picks one for comparing them. The search compares the
+ * first and the last byte of the pattern at every position of a block at
+ * once and calls memcmp() only where both match. grep prints a match's
+ * line and skips straight to the next line, and with -v writes the lines
+ * between two matches with a single write().
+ */
+#include "main.h"
+#include <dirent.h>
+#include <stdint.h>
+#include <sys/stat.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+#define BLOCK      (256 * 1024)         /* read size */
+#define OUTSIZE    (64 * 1024)
+
+extern struct job_t jobs[MAXJOBS];
+
+enum { WC, HEAD, GREP };
+
+/* A command line of wc, head or grep -F */
+struct text {
+    int tool;
+    const char *name;                   /* argv[0] */
+    int lines, words, bytes;            /* wc: what to count */
+    long long count;                    /* head: lines to print, or bytes */
+    int head_bytes;                     /* head -c */
+    int invert, count_only, quiet, number;  /* grep -v, -c, -q, -n */
+    const char *pattern;
+    size_t plen;
+    char **files;                       /* none: the input of the stage */
+    int nfiles;
+};
+
+/* Output, written in large blocks */
+static struct out {
+    int fd;
+    int failed;                         /* errno of a failed write: stop */
+    size_t n;
+    char buf[OUTSIZE];
+} out;
+
+static volatile sig_atomic_t stop;      /* C-c */
+static int active;                      /* the shell runs a builtin of text.c */
+static int in_shell;                    /* ... itself, not in a child */
+
+/*****************
+ * Vector routines
+ *****************/
+
+static size_t (*count_nl)(const char *p, size_t n);
+static size_t (*count_starts)(const char *p, size_t n, int *in_word);
+static const char *(*search)(const char *h, size_t n, const char *s, size_t m);
+
+static size_t nl_scalar(const char *p, size_t n)
+{
+    size_t c = 0;
+
+    for (size_t i = 0; i < n; i++)
+        c += p[i] == '\n';
+    return c;
+}
+
+/*
+ * starts_scalar - Words starting in p[0..n), as wc counts them in the C
+ *     locale: a printable byte starts a word unless it is in one already,
+ *     a space ends it, other bytes change nothing. *in_word is the state
+ *     before p, and after it on return.
+ */
+static size_t starts_scalar(const char *p, size_t n, int *in_word)
+{
+    size_t c = 0;
+    int w = *in_word;
+    unsigned char b;
+
+    for (size_t i = 0; i < n; i++)
+    {
+        b = p[i];
+        if (b == ' ' || (unsigned char)(b - 9) <= 4)
+            w = 0;
+        else if ((unsigned char)(b - 0x21) <= 0x7e - 0x21)
+        {
+            c += !w;
+            w = 1;
+        }
+    }
+    *in_word = w;
+    return c;
+}
+
+/*
+ * word_starts - The same for the bit masks of one vector: printable and
+ *     space bytes, the others neither. A printable byte continues a word
+ *     if the last printable or space byte before it is printable: that
+ *     is the byte before, or one reached over a run of other bytes, which
+ *     adding a bit at the start of the run carries over.
+ */
+static inline uint64_t word_starts(uint64_t print, uint64_t space, uint64_t all, int *in_word)
+{
+    uint64_t other = ~(print | space) & all;
+    uint64_t after = (print << 1) | *in_word;       /* the byte before is printable */
+    uint64_t filled = other & ~(other + (after & other));
+
+    if (print | space)
+        *in_word = (print >> (63 - __builtin_clzll(print | space))) & 1;
+    return print & ~(after | (filled << 1));
+}
+
+static const char *search_scalar(const char *h, size_t n, const char *s, size_t m)
+{
+    return memmem(h, n, s, m);
+}
+
+#ifdef __SSE2__
+static size_t nl_sse2(const char *p, size_t n)
+{
+    const __m128i nl = _mm_set1_epi8('\n'), zero = _mm_setzero_si128();
+    __m128i acc;
+    size_t c = 0, i = 0, end;
+
+    while (n - i >= 16)
+    {
+        /* -1 per newline into byte counters, summed before they wrap */
+        acc = zero;
+        end = n - i > 255 * 16 ? i + 255 * 16 : n;
+        for (; i + 16 <= end; i += 16)
+            acc = _mm_sub_epi8(acc, _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)(p + i)), nl));
+        acc = _mm_sad_epu8(acc, zero);
+        c += _mm_cvtsi128_si32(acc) + _mm_cvtsi128_si32(_mm_unpackhi_epi64(acc, acc));
+    }
+    return c + nl_scalar(p + i, n - i);
+}
+
+static size_t starts_sse2(const char *p, size_t n, int *in_word)
+{
+    const __m128i nine = _mm_set1_epi8(9), four = _mm_set1_epi8(4), blank = _mm_set1_epi8(' ');
+    const __m128i bang = _mm_set1_epi8(0x21), range = _mm_set1_epi8(0x7e - 0x21);
+    __m128i x, t, u;
+    size_t c = 0, i;
+
+    for (i = 0; i + 16 <= n; i += 16)
+    {
+        /* ' ' or \t..\r is c - 9 <= 4, printable c - 0x21 <= 0x5d, unsigned */
+        x = _mm_loadu_si128((const __m128i *)(p + i));
+        t = _mm_sub_epi8(x, nine);
+        u = _mm_sub_epi8(x, bang);
+        c += __builtin_popcountll(word_starts(
+                 _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_min_epu8(u, range), u)),
+                 _mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(x, blank),
+                                                _mm_cmpeq_epi8(_mm_min_epu8(t, four), t))),
+                 0xffff, in_word));
+    }
+    return c + starts_scalar(p + i, n - i, in_word);
+}
+
+static const char *search_sse2(const char *h, size_t n, const char *s, size_t m)
+{
+    __m128i first, last, eq;
+    unsigned mask;
+    size_t i;
+
+    if (m < 2)
+        return m ? memchr(h, s[0], n) : h;
+    first = _mm_set1_epi8(s[0]);
+    last = _mm_set1_epi8(s[m - 1]);
+    for (i = 0; i + m - 1 + 16 <= n; i += 16)
+    {
+        eq = _mm_and_si128(_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)(h + i)), first),
+                           _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)(h + i + m - 1)), last));
+        for (mask = _mm_movemask_epi8(eq); mask; mask &= mask - 1)
+            if (!memcmp(h + i + __builtin_ctz(mask) + 1, s + 1, m - 2))
+                return h + i + __builtin_ctz(mask);
+    }
+    return i < n ? memmem(h + i, n - i, s, m) : NULL;
+}
+#endif
+
+#if defined(__x86_64__) && defined(__GNUC__)
+__attribute__((target("avx2")))
+static size_t nl_avx2(const char *p, size_t n)
+{
+    const __m256i nl = _mm256_set1_epi8('\n'), zero = _mm256_setzero_si256();
+    __m256i acc;
+    size_t c = 0, i = 0, end;
+
+    while (n - i >= 32)
+    {
+        acc = zero;
+        end = n - i > 255 * 32 ? i + 255 * 32 : n;
+        for (; i + 32 <= end; i += 32)
+            acc = _mm256_sub_epi8(acc, _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i *)(p + i)), nl));
+        acc = _mm256_sad_epu8(acc, zero);
+        c += _mm256_extract_epi64(acc, 0) + _mm256_extract_epi64(acc, 1)
+             + _mm256_extract_epi64(acc, 2) + _mm256_extract_epi64(acc, 3);
+    }
+    return c + nl_scalar(p + i, n - i);
+}
+
+__attribute__((target("avx2,popcnt")))
+static size_t starts_avx2(const char *p, size_t n, int *in_word)
+{
+    const __m256i nine = _mm256_set1_epi8(9), four = _mm256_set1_epi8(4);
+    const __m256i blank = _mm256_set1_epi8(' ');
+    const __m256i bang = _mm256_set1_epi8(0x21), range = _mm256_set1_epi8(0x7e - 0x21);
+    __m256i x, t, u;
+    size_t c = 0, i;
+
+    for (i = 0; i + 32 <= n; i += 32)
+    {
+        x = _mm256_loadu_si256((const __m256i *)(p + i));
+        t = _mm256_sub_epi8(x, nine);
+        u = _mm256_sub_epi8(x, bang);
+        c += __builtin_popcountll(word_starts(
+                 (uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_min_epu8(u, range), u)),
+                 (uint32_t)_mm256_movemask_epi8(_mm256_or_si256(_mm256_cmpeq_epi8(x, blank),
+                                                                _mm256_cmpeq_epi8(_mm256_min_epu8(t, four), t))),
+                 0xffffffff, in_word));
+    }
+    return c + starts_scalar(p + i, n - i, in_word);
+}
+
+__attribute__((target("avx2")))
+static const char *search_avx2(const char *h, size_t n, const char *s, size_t m)
+{
+    __m256i first, last, eq;
+    unsigned mask;
+    size_t i;
+
+    if (m < 2)
+        return m ? memchr(h, s[0], n) : h;
+    first = _mm256_set1_epi8(s[0]);
+    last = _mm256_set1_epi8(s[m - 1]);
+    for (i = 0; i + m - 1 + 32 <= n; i += 32)
+    {
+        eq = _mm256_and_si256(_mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i *)(h + i)), first),
+                              _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i *)(h + i + m - 1)), last));
+        for (mask = _mm256_movemask_epi8(eq); mask; mask &= mask - 1)
+            if (!memcmp(h + i + __builtin_ctz(mask) + 1, s + 1, m - 2))
+                return h + i + __builtin_ctz(mask);
+    }
+    return i < n ? memmem(h + i, n - i, s, m) : NULL;
+}
+#endif
+
+/* pick - Choose the vector routines for this CPU, or $ZSH_SIMD */
+static void pick(void)
+{
+    const char *want = getenv("ZSH_SIMD");
+
+    count_nl = nl_scalar;
+    count_starts = starts_scalar;
+    search = search_scalar;
+    if (want && !strcmp(want, "scalar"))
+        return;
+#ifdef __SSE2__
+    count_nl = nl_sse2;
+    count_starts = starts_sse2;
+    search = search_sse2;
+#endif
+#if defined(__x86_64__) && defined(__GNUC__)
+    if ((!want || !strcmp(want, "avx2")) && __builtin_cpu_supports("avx2"))
+    {
+        count_nl = nl_avx2;
+        count_starts = starts_avx2;
+        search = search_avx2;
+    }
+#endif
+}
+
+/***************
+ * Input, output
+ ***************/
+
+/*
+ * next_block - Read the next block of fd, which pgid (or 0) writes.
+ *     What the shell read ahead of its stdin comes first. -1 on an error,
+ *     on C-c or when the job writing the input is stopped.
+ */
+static ssize_t next_block(const struct text *t, int fd, pid_t pgid, int file, char *buf, size_t size)
+{
+    struct job_t *job;
+    size_t k;
+    ssize_t n;
+
+    if (in_shell && fd == STDIN_FILENO && (k = in_take(buf, size)) > 0)
+        return k;
+    while (!stop)
+    {
+        if (pgid && (job = getjobpid(jobs, pgid)) != NULL && job->state == ST)
+        {
+            fprintf(stderr, "%s: input stopped\n", t->name);
+            return -1;
+        }
+        /* a child has no events to service, a file is always ready */
+        if (in_shell && !file && !wait_input(fd, 100))
+            continue;
+        if ((n = read(fd, buf, size)) >= 0)
+            return n;
+        if (errno != EINTR && errno != EAGAIN)
+        {
+            fprintf(stderr, "%s: %s\n", t->name, strerror(errno));
+            return -1;
+        }
+    }
+    return -1;
+}
+
+/* write_out - Write n bytes; a gone reader stops the command */
+static void write_out(const char *p, size_t n)
+{
+    ssize_t w;
+
+    while (n > 0 && !out.failed)
+    {
+        if ((w = write(out.fd, p, n)) >= 0)
+        {
+            p += w;
+            n -= w;
+        }
+        else if (errno != EINTR)
+            out.failed = errno;
+    }
+}
+
+static void flush(void)
+{
+    write_out(out.buf, out.n);
+    out.n = 0;
+}
+
+static void put(const char *p, size_t n)
+{
+    if (out.n + n > OUTSIZE)
+    {
+        flush();
+        if (n >= OUTSIZE)
+        {
+            write_out(p, n);
+            return;
+        }
+    }
+    memcpy(out.buf + out.n, p, n);
+    out.n += n;
+}
+
+/* open_input - Open file i of t, or give fd for the stage's input */
+static int open_input(const struct text *t, int i, int fd, int *file)
+{
+    struct stat st;
+
+    if (t->nfiles && strcmp(t->files[i], "-")
+        && (fd = open(t->files[i], O_RDONLY | O_CLOEXEC)) < 0)
+    {
+        fprintf(stderr, "%s: %s: %s\n", t->name, t->files[i], strerror(errno));
+        return -1;
+    }
+    *file = fstat(fd, &st) == 0 && S_ISREG(st.st_mode);
+    return fd;
+}
+
+/*****
+ * wc
+ *****/
+
+static void wc_print(const struct text *t, unsigned long long c[3], int width, const char *name)
+{
+    char line[96];
+    const int on[3] = { t->lines, t->words, t->bytes };
+    int k = 0;
+
+    for (int j = 0; j < 3; j++)
+        if (on[j])
+            k += snprintf(line + k, sizeof(line) - k, "%s%*llu", k ? " " : "", width, c[j]);
+    put(line, k);
+    if (name)
+    {
+        put(" ", 1);
+        put(name, strlen(name));
+    }
+    put("\n", 1);
+}
+
+static int wc(const struct text *t, int fd, pid_t pgid)
+{
+    static char buf[BLOCK];
+    unsigned long long c[3], total[3] = { 0, 0, 0 }, size = 0;
+    int n = t->nfiles ? t->nfiles : 1, width = 7, status = 0, file, in, in_word, i;
+    struct stat st;
+    ssize_t got;
+
+    /* the width of the numbers, as GNU wc picks it: one number alone
+     * is not padded, those of regular files are as wide as their total */
+    if (t->lines + t->words + t->bytes == 1 && n == 1)
+        width = 1;
+    else if (t->nfiles)
+    {
+        for (i = 0; i < n; i++)
+            if (strcmp(t->files[i], "-") && stat(t->files[i], &st) == 0 && S_ISREG(st.st_mode))
+                size += st.st_size;
+            else
+                break;
+        for (width = 1; i == n && size >= 10; size /= 10)
+            width++;
+        if (i < n)
+            width = 7;
+    }
+
+    for (i = 0; i < n && !stop && !out.failed; i++)
+    {
+        if ((in = open_input(t, i, fd, &file)) < 0)
+        {
+            status = 1;
+            continue;
+        }
+        memset(c, 0, sizeof(c));
+        in_word = 0;
+        if (file && !t->lines && !t->words && fstat(in, &st) == 0)
+            c[2] = st.st_size - lseek(in, 0, SEEK_CUR);     /* wc -c of a file */
+        else
+        {
+            while ((got = next_block(t, in, pgid, file, buf, sizeof(buf))) > 0)
+            {
+                if (t->lines)
+                    c[0] += count_nl(buf, got);
+                if (t->words)
+                    c[1] += count_starts(buf, got, &in_word);
+                c[2] += got;
+            }
+            if (got < 0)
+                status = 1;
+        }
+        if (in != fd)
+            close(in);
+        if (stop)
+            break;
+        wc_print(t, c, width, t->nfiles ? t->files[i] : NULL);
+        for (int j = 0; j < 3; j++)
+            total[j] += c[j];
+    }
+    if (n > 1 && !stop)
+        wc_print(t, total, width, "total");
+    return status;
+}
+
+/*******
+ * head
+ *******/
+
+static int head(const struct text *t, int fd, pid_t pgid)
+{
+    static char buf[BLOCK];
+    int n = t->nfiles ? t->nfiles : 1, status = 0, file, in;
+    long long left;
+    const char *p;
+    ssize_t got = 0;
+    size_t k = 0, nl;
+
+    for (int i = 0; i < n && !stop && !out.failed; i++)
+    {
+        if ((in = open_input(t, i, fd, &file)) < 0)
+        {
+            status = 1;
+            continue;
+        }
+        if (n > 1)
+        {
+            put(i ? "\n==> " : "==> ", i ? 5 : 4);
+            put(t->files[i], strlen(t->files[i]));
+            put(" <==\n", 5);
+        }
+        for (left = t->count; left > 0 && !out.failed; )
+        {
+            if ((got = next_block(t, in, pgid, file, buf, sizeof(buf))) <= 0)
+                break;
+            k = got;
+            if (t->head_bytes)
+            {
+                if ((long long)k > left)
+                    k = left;
+                left -= k;
+            }
+            else if ((long long)(nl = count_nl(buf, got)) >= left)
+            {
+                /* the block has the last line: find it */
+                for (p = buf; left > 0; left--)
+                    p = (const char *)memchr(p, '\n', buf + got - p) + 1;
+                k = p - buf;
+            }
+            else
+                left -= nl;
+            put(buf, k);
+        }
+        if (got < 0)
+            status = 1;
+        /* what was read ahead of a file is left for the next reader */
+        else if (file && got > 0 && (size_t)got > k)
+            lseek(in, k - got, SEEK_CUR);
+        if (in != fd)
+            close(in);
+    }
+    return status;
+}
+
+/*******
+ * grep
+ *******/
+
+/* grep_line - Print the selected line [a, b), b may have no newline */
+static void grep_line(const struct text *t, const char *label, unsigned long long lineno,
+                      const char *a, const char *b)
+{
+    char num[24];
+
+    if (label)
+    {
+        put(label, strlen(label));
+        put(":", 1);
+    }
+    if (t->number)
+        put(num, snprintf(num, sizeof(num), "%llu:", lineno));
+    put(a, b - a);
+    if (b == a || b[-1] != '\n')
+        put("\n", 1);
+}
+
+/* grep_lines - The lines [a, b) are selected (-v): print them */
+static unsigned long long grep_lines(const struct text *t, const char *label,
+                                     unsigned long long lineno, const char *a, const char *b)
+{
+    unsigned long long n;
+    const char *e;
+
+    if (a == b)
+        return 0;
+    n = count_nl(a, b - a) + (b[-1] != '\n');
+    if (t->count_only || t->quiet)
+        return n;
+    if (!label && !t->number)
+    {
+        /* the lines as they are, in one go */
+        put(a, b - a);
+        if (b[-1] != '\n')
+            put("\n", 1);
+        return n;
+    }
+    for (; a < b; a = e)
+    {
+        e = memchr(a, '\n', b - a);
+        e = e ? e + 1 : b;
+        grep_line(t, label, lineno++, a, e);
+    }
+    return n;
+}
+
+/*
+ * grep_block - Select the lines of [s, end), all complete but the last
+ *     one at the end of the input. Returns the number selected, counts
+ *     *lineno on.
+ */
+static unsigned long long grep_block(const struct text *t, const char *label,
+                                     unsigned long long *lineno, const char *s, const char *end)
+{
+    unsigned long long sel = 0;
+    const char *m, *ls, *le;
+
+    while (s < end)
+    {
+        if ((m = search(s, end - s, t->pattern, t->plen)) == NULL)
+            ls = le = end;
+        else
+        {
+            ls = memrchr(s, '\n', m - s);
+            ls = ls ? ls + 1 : s;
+            le = memchr(m, '\n', end - m);
+            le = le ? le + 1 : end;
+        }
+        /* the lines before the match's line do not match */
+        if (t->invert)
+            sel += grep_lines(t, label, *lineno, s, ls);
+        if (t->number)
+            *lineno += count_nl(s, ls - s);
+        if (m == NULL)
+            break;
+        if (!t->invert)
+        {
+            sel++;
+            if (!t->count_only && !t->quiet)
+                grep_line(t, label, *lineno, ls, le);
+        }
+        (*lineno)++;
+        if (t->quiet && sel)
+            break;
+        s = le;
+    }
+    return sel;
+}
+
+static int grep(const struct text *t, int fd, pid_t pgid)
+{
+    static char *buf;
+    static size_t cap;
+    int n = t->nfiles ? t->nfiles : 1, status = 1, error = 0, file, in;
+    unsigned long long sel, lineno;
+    const char *label, *end;
+    char num[24];
+    size_t have;
+    ssize_t got;
+
+    if (!buf && (buf = malloc(cap = BLOCK)) == NULL)
+        return 2;
+    for (int i = 0; i < n && !stop && !out.failed; i++)
+    {
+        if ((in = open_input(t, i, fd, &file)) < 0)
+        {
+            error = 1;
+            continue;
+        }
+        label = n > 1 ? t->files[i] : NULL;
+        sel = 0;
+        lineno = 1;
+        have = 0;
+        got = 0;
+        while (!(t->quiet && sel) && !out.failed)
+        {
+            /* a line longer than the buffer: make room for it */
+            if (have == cap)
+            {
+                char *p = realloc(buf, 2 * cap);
+
+                if (p == NULL)
+                {
+                    fprintf(stderr, "%s: %s\n", t->name, strerror(errno));
+                    got = -1;
+                    break;
+                }
+                buf = p;
+                cap *= 2;
+            }
+            if ((got = next_block(t, in, pgid, file, buf + have, cap - have)) < 0)
+                break;
+            if (got == 0)
+            {
+                /* the last line, without a newline */
+                sel += grep_block(t, label, &lineno, buf, buf + have);
+                break;
+            }
+            have += got;
+            if ((end = memrchr(buf + have - got, '\n', got)) == NULL)
+                continue;
+            end++;
+            sel += grep_block(t, label, &lineno, buf, end);
+            memmove(buf, end, buf + have - end);
+            have -= end - buf;
+        }
+        if (got < 0)
+            error = 1;
+        if (in != fd)
+            close(in);
+        if (t->count_only && !t->quiet && !stop)
+        {
+            if (label)
+            {
+                put(label, strlen(label));
+                put(":", 1);
+            }
+            put(num, snprintf(num, sizeof(num), "%llu\n", sel));
+        }
+        if (sel)
+        {
+            status = 0;
+            if (t->quiet)
+                break;
+        }
+    }
+    return error && !(t->quiet && status == 0) ? 2 : status;
+}
+
+/*****************
+ * Running them
+ *****************/
+
+/* number - Parse a count of head, N >= 0 */
+static int number(const char *s, long long *n)
+{
+    char *end;
+
+    if (!isdigit((unsigned char)*s))
+        return -1;
+    *n = strtoll(s, &end, 10);
+    return *end ? -1 : 0;
+}
+
+/*
+ * parse - Fill t from argv if it is wc, head or grep -F with options
+ *     this file knows, else -1
+ */
+static int parse(char **argv, struct text *t)
+{
+    int i, fixed = 0;
+    const char *o;
+
+    if (!argv[0])
+        return -1;
+    memset(t, 0, sizeof(*t));
+    t->name = argv[0];
+    if (!strcmp(argv[0], "wc"))
+        t->tool = WC;
+    else if (!strcmp(argv[0], "head"))
+        t->tool = HEAD, t->count = 10;
+    else if (!strcmp(argv[0], "grep"))
+        t->tool = GREP;
+    else
+        return -1;
+
+    for (i = 1; argv[i] && argv[i][0] == '-' && argv[i][1]; i++)
+    {
+        if (!strcmp(argv[i], "--"))
+        {
+            i++;
+            break;
+        }
+        if (t->tool == HEAD)
+        {
+            if (argv[i][1] == 'n' || argv[i][1] == 'c')
+            {
+                t->head_bytes = argv[i][1] == 'c';
+                o = argv[i][2] ? argv[i] + 2 : argv[++i];
+                if (!o || number(o, &t->count) < 0)
+                    return -1;
+            }
+            else if (number(argv[i] + 1, &t->count) < 0)
+                return -1;
+            continue;
+        }
+        for (o = argv[i] + 1; *o; o++)
+        {
+            if (t->tool == WC && (*o == 'l' || *o == 'w' || *o == 'c'))
+                *(*o == 'l' ? &t->lines : *o == 'w' ? &t->words : &t->bytes) = 1;
+            else if (t->tool == GREP && strchr("Fcvqn", *o))
+            {
+                fixed |= *o == 'F';
+                t->invert |= *o == 'v';
+                t->count_only |= *o == 'c';
+                t->quiet |= *o == 'q';
+                t->number |= *o == 'n';
+            }
+            else
+                return -1;
+        }
+    }
+
+    if (t->tool == GREP)
+    {
+        /* a pattern with a newline is several patterns */
+        if (!fixed || !argv[i] || strchr(argv[i], '\n'))
+            return -1;
+        t->pattern = argv[i++];
+        t->plen = strlen(t->pattern);
+    }
+    if (t->tool == WC && !t->lines && !t->words && !t->bytes)
+        t->lines = t->words = t->bytes = 1;
+    t->files = argv + i;
+    for (; argv[i]; i++, t->nfiles++)
+        if (argv[i][0] == '-' && argv[i][1])
+            return -1;              /* an option after the files */
+    return 0;
+}
+
+/*
+ * run - Run t with fd (written by pgid, or 0) as the input if it has no
+ *     files, writing to stdout. Returns its status.
+ */
+static int run(struct text *t, int fd, pid_t pgid)
+{
+    struct timespec zero = { 0, 0 };
+    sigset_t mask, prev;
+    int status;
+
+    if (!count_nl)
+        pick();
+    /* a gone reader is an error, not SIGPIPE */
+    sigemptyset(&mask);
+    sigaddset(&mask, SIGPIPE);
+    sigprocmask(SIG_BLOCK, &mask, &prev);
+    fflush(stdout);
+    out.fd = STDOUT_FILENO;
+    out.failed = 0;
+    out.n = 0;
+    stop = 0;
+    active = 1;
+
+    status = t->tool == WC ? wc(t, fd, pgid) : t->tool == HEAD ? head(t, fd, pgid) : grep(t, fd, pgid);
+    flush();
+
+    active = 0;
+    if (out.failed == EPIPE)
+    {
+        sigtimedwait(&mask, NULL, &zero);
+        status = 128 + SIGPIPE;
+    }
+    sigprocmask(SIG_SETMASK, &prev, NULL);
+    return stop ? 128 + SIGINT : status;
+}
+
+/*
+ * text_cmd - Is argv a command of text.c?
+ */
+int text_cmd(char **argv)
+{
+    struct text t;
+
+    return parse(argv, &t) == 0;
+}
+
+/*
+ * text_exec - Run argv, a command of text.c, in a child spawn() forked;
+ *     returns the status to exit with
+ */
+int text_exec(char **argv)
+{
+    struct text t;
+
+    struct dirent *e;
+    DIR *dir;
+    int fd;
+
+    if (parse(argv, &t) < 0)
+        return 127;
+    /* close what execve() would close: the shell's own fds, among them
+     * the read end of a pipe this child writes */
+    if ((dir = opendir("/proc/self/fd")) != NULL)
+    {
+        while ((e = readdir(dir)) != NULL)
+            if ((fd = atoi(e->d_name)) > 2 && fd != dirfd(dir)
+                && fcntl(fd, F_GETFD) & FD_CLOEXEC)
+                close(fd);
+        closedir(dir);
+    }
+    else
+        for (fd = 3; fd < 1024; fd++)
+            if (fcntl(fd, F_GETFD) & FD_CLOEXEC)
+                close(fd);
+    in_shell = 0;
+    return run(&t, STDIN_FILENO, 0);
+}
+
+/*
+ * text_kill - C-c: stop the builtin the shell is running. Called by the
+ *     SIGINT handler.
+ */
+void text_kill(void)
+{
+    if (active)
+        stop = 1;
+}
+
+/*
+ * text_stage - Index in argv of the last pipeline stage if it is a
+ *     command of text.c, or -1
+ */
+int text_stage(char **argv)
+{
+    int at = 0;
+
+    for (int i = 0; argv[i]; i++)
+        if (!strcmp(argv[i], "|"))
+            at = i + 1;
+    return text_cmd(argv + at) ? at : -1;
+}
+
+/*
+ * do_text - Execute a command line whose last pipeline stage, at
+ *     argv[at], is wc, head or grep -F. Takes over r.
+ */
+void do_text(char **argv, int at, char *cmdline, struct redir *r)
+{
+    struct text t;
+    pid_t pgid;
+    int fd, status;
+
+    if ((fd = stage_input(argv, at, cmdline, r, &pgid)) < 0)
+        return;
+    parse(argv + at, &t);
+    in_shell = 1;
+    status = run(&t, fd, pgid);
+    /* head is done: the stages writing the pipe get SIGPIPE */
+    if (fd != STDIN_FILENO)
+        close(fd);
+    if (pgid)
+        waitfg(pgid);
+    last_status = status;
+}
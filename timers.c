@@ -0,0 +1,426 @@
+/*
+ * zsh - A mini shell program
+ * NKU OS Course
+ * Shuhao Zhang
+ *
+ * file: timers.c
+ *
+ * Job deadlines. All deadlines live in one min-heap ordered by expiry,
+ * and a single timerfd is armed for the earliest one. The shell never
+ * sleeps anywhere else than in wait_event() and wait_input(), which poll
+ * the timerfd along with whatever they wait for (and the capture pipes
+ * of background jobs, see capture.c), so deadlines are
+ * serviced from the wait path without a sleeper thread or process per
+ * job. When a deadline expires the job's process group gets SIGTERM,
+ * and SIGKILL once the grace period is over as well.
+ *
+ * Finished jobs are not removed from the heap: an entry whose job is
+ * gone (or whose slot now holds another job) is dropped when it expires,
+ * or before the heap would grow, so it never holds many more entries
+ * than there are live deadlines.
+ */
+#include "main.h"
+#include <poll.h>
+#include <stdint.h>
+#include <time.h>
+#include <sys/timerfd.h>
+
+extern struct job_t jobs[MAXJOBS];
+extern int verbose;
+
+struct timer {
+    struct timespec when;   /* CLOCK_MONOTONIC expiry */
+    pid_t pgid;             /* job it belongs to */
+    int jid;
+    int sig;                /* SIGTERM first, then SIGKILL */
+    double grace;           /* seconds between SIGTERM and SIGKILL */
+};
+
+static struct timer *heap = NULL;
+static int nheap = 0, heapcap = 0;
+static int timer_fd = -1;
+int input_wake = 0;             /* make wait_input() return early */
+
+/* ts_before - Is time a earlier than time b? */
+static int ts_before(const struct timespec *a, const struct timespec *b)
+{
+    if (a->tv_sec != b->tv_sec)
+        return a->tv_sec < b->tv_sec;
+    return a->tv_nsec < b->tv_nsec;
+}
+
+/* before - Order heap entries by expiry */
+static int before(const struct timer *a, const struct timer *b)
+{
+    return ts_before(&a->when, &b->when);
+}
+
+/* sift_down - Move last down from slot i to where it belongs */
+static void sift_down(int i, struct timer last)
+{
+    int child;
+
+    while ((child = 2 * i + 1) < nheap)
+    {
+        if (child + 1 < nheap && before(&heap[child + 1], &heap[child]))
+            child++;
+        if (!before(&heap[child], &last))
+            break;
+        heap[i] = heap[child];
+        i = child;
+    }
+    heap[i] = last;
+}
+
+/* alive - Does the job of entry t still run with its deadline? */
+static int alive(const struct timer *t)
+{
+    struct job_t *job;
+
+    return t->jid && (job = getjobjid(jobs, t->jid)) != NULL && job->pid == t->pgid;
+}
+
+/* compact - Drop the entries of finished jobs and cleared deadlines */
+static void compact(void)
+{
+    int n = 0;
+
+    for (int i = 0; i < nheap; i++)
+        if (alive(&heap[i]))
+            heap[n++] = heap[i];
+    nheap = n;
+    for (int i = nheap / 2 - 1; i >= 0; i--)
+        sift_down(i, heap[i]);
+}
+
+static void heap_push(const struct timer *t)
+{
+    int i, parent;
+
+    /* full: drop the dead entries first, and grow only if at least half
+     * of them were live */
+    if (nheap == heapcap)
+    {
+        compact();
+        if (!heapcap || nheap > heapcap / 2)
+        {
+            struct timer *h = realloc(heap, (heapcap ? heapcap * 2 : 64) * sizeof(*h));
+            if (!h)
+                app_error("timer: out of memory");
+            heap = h;
+            heapcap = heapcap ? heapcap * 2 : 64;
+        }
+    }
+    for (i = nheap++; i > 0 && before(t, &heap[parent = (i - 1) / 2]); i = parent)
+        heap[i] = heap[parent];
+    heap[i] = *t;
+}
+
+static void heap_pop(void)
+{
+    nheap--;
+    sift_down(0, heap[nheap]);
+}
+
+/* rearm - Point the timerfd at the earliest deadline, or disarm it */
+static void rearm(void)
+{
+    struct itimerspec its;
+
+    memset(&its, 0, sizeof(its));
+    if (nheap)
+        its.it_value = heap[0].when;
+    if (timerfd_settime(timer_fd, TFD_TIMER_ABSTIME, &its, NULL) < 0)
+        unix_error("timerfd_settime error");
+}
+
+/* add_secs - Return now + secs on the monotonic clock */
+static struct timespec add_secs(double secs)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    ts.tv_sec += (time_t)secs;
+    ts.tv_nsec += (long)((secs - (time_t)secs) * 1e9);
+    if (ts.tv_nsec >= 1000000000)
+    {
+        ts.tv_sec++;
+        ts.tv_nsec -= 1000000000;
+    }
+    return ts;
+}
+
+/*
+ * parse_duration - Parse "1.5", "10s", "500ms", "2m", "1h" into seconds.
+ *     Returns -1 if s is not a duration.
+ */
+double parse_duration(const char *s)
+{
+    char *end;
+    double v = strtod(s, &end);
+
+    if (end == s || v < 0)
+        return -1;
+    if (!strcmp(end, "") || !strcmp(end, "s"))
+        return v;
+    if (!strcmp(end, "ms"))
+        return v / 1000;
+    if (!strcmp(end, "m"))
+        return v * 60;
+    if (!strcmp(end, "h"))
+        return v * 3600;
+    return -1;
+}
+
+/*
+ * set_deadline - Give job a deadline secs from now, after which it gets
+ *     SIGTERM, and SIGKILL grace seconds later. Called with SIGCHLD
+ *     blocked.
+ */
+void set_deadline(struct job_t *job, double secs, double grace)
+{
+    struct timer t;
+
+    if (timer_fd < 0 && (timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC)) < 0)
+        unix_error("timerfd_create error");
+
+    t.when = add_secs(secs);
+    t.pgid = job->pid;
+    t.jid = job->jid;
+    t.sig = SIGTERM;
+    t.grace = grace;
+    heap_push(&t);
+    rearm();
+}
+
+/*
+ * clear_deadline - Cancel the deadlines of job. The heap entries stay and
+ *     are dropped when they expire, or when the heap is full.
+ */
+void clear_deadline(struct job_t *job)
+{
+    for (int i = 0; i < nheap; i++)
+        if (heap[i].pgid == job->pid && heap[i].jid == job->jid)
+            heap[i].jid = 0;
+}
+
+/*
+ * timers_run - Act on every expired deadline and rearm the timerfd.
+ *     Called with SIGCHLD blocked, so the job list holds still.
+ */
+void timers_run(void)
+{
+    struct timespec now;
+    struct job_t *job;
+    struct timer t;
+    uint64_t ticks;
+
+    if (timer_fd < 0)
+        return;
+    if (read(timer_fd, &ticks, sizeof(ticks)) < 0 && errno != EAGAIN)
+        unix_error("timerfd read error");
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    while (nheap && !ts_before(&now, &heap[0].when))
+    {
+        t = heap[0];
+        heap_pop();
+
+        /* the job already finished */
+        if ((job = getjobjid(jobs, t.jid)) == NULL || job->pid != t.pgid)
+            continue;
+
+        if (verbose)
+            printf("timers_run: Job [%d] (%d) deadline, sending signal %d\n", t.jid, t.pgid, t.sig);
+        kill(-t.pgid, t.sig);
+        if (t.sig == SIGTERM)
+        {
+            /* a stopped job cannot act on SIGTERM */
+            kill(-t.pgid, SIGCONT);
+            t.sig = SIGKILL;
+            t.when = add_secs(t.grace);
+            heap_push(&t);
+        }
+    }
+    rearm();
+}
+
+/*
+ * poll_set - Fill pfd with what the shell's waits watch: fd (unless it
+ *     is -1), the deadline timerfd, the pipe of the prompt's git helper
+ *     and the capture pipes of background jobs. Returns the number of
+ *     entries.
+ */
+static int poll_set(struct pollfd *pfd, int fd)
+{
+    int n = 0;
+
+    if (fd >= 0)
+    {
+        pfd[n].fd = fd;
+        pfd[n].events = POLLIN;
+        pfd[n++].revents = 0;
+    }
+    if (timer_fd >= 0)
+    {
+        pfd[n].fd = timer_fd;
+        pfd[n].events = POLLIN;
+        pfd[n++].revents = 0;
+    }
+    n += prompt_pollfds(pfd + n);
+    return n + capture_pollfds(pfd + n);
+}
+
+/*
+ * service_events - Act on expired deadlines, drain the output of
+ *     background jobs and of the prompt's helper, and start the queued
+ *     jobs that became ready (see sched.c). Called with SIGCHLD blocked.
+ */
+void service_events(void)
+{
+    timers_run();
+    capture_drain();
+    prompt_drain();
+    sched_run();
+}
+
+/*
+ * wait_event - Sleep with signal mask prev until a signal is handled, a
+ *     deadline expires or a background job writes output, and service
+ *     what happened. The caller has SIGCHLD blocked, like around
+ *     sigsuspend().
+ */
+void wait_event(sigset_t *prev)
+{
+    static struct pollfd pfd[MAXJOBS + 3];
+    int n = poll_set(pfd, -1);
+
+    if (n == 0)
+        sigsuspend(prev);
+    else
+        ppoll(pfd, n, NULL, prev);
+    service_events();
+}
+
+/*
+ * wait_input - Wait until fd is readable, servicing deadlines, job
+ *     output and queued jobs in the meantime. Used by the main loop
+ *     before it reads a line. Gives up after ms milliseconds unless ms
+ *     is -1, or early when input_wake is set, say because the prompt
+ *     changed. Returns 1 if fd is readable, 0 otherwise. With nothing
+ *     else to watch and no limit, it returns 1 at once and lets the read
+ *     block, unless fd is non-blocking.
+ */
+int wait_input(int fd, int ms)
+{
+    static struct pollfd pfd[MAXJOBS + 3];
+    struct timespec end, now, left;
+    sigset_t mask, prev;
+    int n, ready = 0, blocking = ms < 0 && !(fcntl(fd, F_GETFL) & O_NONBLOCK);
+
+    if (ms >= 0)
+        end = add_secs(ms / 1000.0);
+    sigemptyset(&mask);
+    sigaddset(&mask, SIGCHLD);
+    sigprocmask(SIG_BLOCK, &mask, &prev);
+    while (1)
+    {
+        service_events();
+        if (input_wake)
+        {
+            input_wake = 0;
+            break;
+        }
+        /* nothing else to watch: let the read block */
+        if ((n = poll_set(pfd, fd)) == 1 && !sched_queued() && blocking)
+        {
+            ready = 1;
+            break;
+        }
+        if (ms >= 0)
+        {
+            clock_gettime(CLOCK_MONOTONIC, &now);
+            if (!ts_before(&now, &end))
+                break;
+            left.tv_sec = end.tv_sec - now.tv_sec;
+            left.tv_nsec = end.tv_nsec - now.tv_nsec;
+            if (left.tv_nsec < 0)
+            {
+                left.tv_sec--;
+                left.tv_nsec += 1000000000;
+            }
+        }
+        if (ppoll(pfd, n, ms >= 0 ? &left : NULL, &prev) > 0
+            && (pfd[0].revents & (POLLIN | POLLHUP | POLLERR)))
+        {
+            ready = 1;
+            break;
+        }
+    }
+    service_events();
+    sigprocmask(SIG_SETMASK, &prev, NULL);
+    return ready;
+}
+
+/*
+ * timeout_prefix - Parse `timeout [-k grace] DURATION cmd ...` into attr.
+ *     Returns the index of cmd in argv, or -1 after printing an error.
+ */
+int timeout_prefix(char **argv, struct spawn_attr *attr)
+{
+    int i = 1;
+
+    attr->grace = 5;
+    if (argv[i] && !strcmp(argv[i], "-k"))
+    {
+        if (!argv[i + 1] || (attr->grace = parse_duration(argv[i + 1])) < 0)
+            goto usage;
+        i += 2;
+    }
+    if (!argv[i] || (attr->timeout = parse_duration(argv[i])) <= 0 || !argv[i + 1])
+        goto usage;
+    return i + 1;
+
+usage:
+    printf("usage: timeout [-k grace] DURATION cmd\n");
+    return -1;
+}
+
+/*
+ * do_deadline - Execute the builtin deadline command:
+ *     deadline %jobid|pid DURATION [grace]   (DURATION 0 cancels it)
+ */
+void do_deadline(int argc, char **argv)
+{
+    struct job_t *job;
+    double secs, grace = 5;
+    sigset_t mask, prev;
+    int id;
+
+    if (argc < 3 || (secs = parse_duration(argv[2])) < 0
+        || (argc > 3 && (grace = parse_duration(argv[3])) < 0))
+    {
+        printf("usage: deadline %%jobid|pid DURATION [grace]\n");
+        return;
+    }
+
+    sigemptyset(&mask);
+    sigaddset(&mask, SIGCHLD);
+    sigprocmask(SIG_BLOCK, &mask, &prev);
+    if (argv[1][0] == '%')
+        job = (id = atoi(argv[1] + 1)) > 0 ? getjobjid(jobs, id) : NULL;
+    else
+        job = (id = atoi(argv[1])) > 0 ? getjobpid(jobs, id) : NULL;
+
+    if (!job)
+        printf("%s: No such job\n", argv[1]);
+    else if (job->state == QU)
+        printf("%s: job is queued\n", argv[1]);
+    else
+    {
+        clear_deadline(job);
+        if (secs > 0)
+            set_deadline(job, secs, grace);
+    }
+    sigprocmask(SIG_SETMASK, &prev, NULL);
+}
@@ -0,0 +1,387 @@
+/*
+ * zsh - A mini shell program
+ * NKU OS Course
+ * Shuhao Zhang
+ *
+ * file: xargs.c
+ *
+ * The builtin xargs: cmd ... | xargs [-0] [-n max] [-P N] command [args]
+ * runs command with the lines (or with -0 the NUL-terminated strings) of
+ * its input as more arguments, as many per run as the kernel takes. With
+ * -P N up to N runs go at once. Without a pipeline, xargs reads a
+ * here-document or the shell's stdin.
+ *
+ * The shell runs xargs itself, as the last stage of the pipeline: the
+ * other stages are a foreground job writing into a pipe the shell reads
+ * in large blocks, and the runs of command are started with spawn(), the
+ * way jobs are, so there is no xargs process and no copy of the input
+ * through it. A run is as full as execve() allows: the kernel takes at
+ * most ARG_MAX bytes (a quarter of the stack limit, capped at 6MB) of
+ * strings -- the path, the environment and the arguments -- and their
+ * pointers, so a batch is packed up to exactly that, not up to MAXARGS.
+ *
+ * Runs are not jobs: the SIGCHLD handler hands their status to
+ * xargs_reaped(), and C-c is passed on to them by xargs_kill(). The
+ * status of xargs is that of GNU xargs: 123 if a run failed, 124 if one
+ * exited with 255, 125 if one was killed, 126 or 127 if command could
+ * not be run; the last four stop xargs.
+ */
+#include "main.h"
+#include <sys/resource.h>
+
+#define MAXPAR     64                   /* runs at once, -P */
+#define STK_LIM    (8 * 1024 * 1024)    /* the kernel's _STK_LIM */
+
+extern char **environ;
+extern struct job_t jobs[MAXJOBS];
+
+static pid_t running[MAXPAR];   /* runs not reaped yet */
+static int nrunning;
+static int result;              /* status of xargs so far */
+static int stop;                /* start no more runs */
+static int active;              /* xargs is running */
+
+/*
+ * xargs_reaped - Is pid a run of xargs? Called by the SIGCHLD handler
+ *     for every child it reaps.
+ */
+int xargs_reaped(pid_t pid, int status)
+{
+    int code;
+
+    for (int i = 0; i < nrunning; i++)
+    {
+        if (running[i] != pid)
+            continue;
+        if (WIFSTOPPED(status))
+            return 1;
+        running[i] = running[--nrunning];
+        if (WIFSIGNALED(status))
+            result = 125, stop = 1;
+        else if ((code = WEXITSTATUS(status)) == 255)
+            result = 124, stop = 1;
+        else if (code == 126 || code == 127)
+            result = code, stop = 1;
+        else if (code && !result)
+            result = 123;
+        return 1;
+    }
+    return 0;
+}
+
+/*
+ * xargs_kill - Send sig to the runs of xargs and stop it. Called by the
+ *     SIGINT handler.
+ */
+void xargs_kill(int sig)
+{
+    if (!active)
+        return;
+    for (int i = 0; i < nrunning; i++)
+        kill(-running[i], sig);
+    stop = 1;
+    if (!result)
+        result = 128 + sig;
+}
+
+/*
+ * xargs_stage - Index in argv of xargs if it is the command of the last
+ *     pipeline stage, or -1
+ */
+int xargs_stage(char **argv)
+{
+    int at = 0;
+
+    for (int i = 0; argv[i]; i++)
+        if (!strcmp(argv[i], "|"))
+            at = i + 1;
+    return argv[at] && !strcmp(argv[at], "xargs") ? at : -1;
+}
+
+/* which - The full path of command name, so every run is one execve() */
+static const char *which(const char *name, char *buf, size_t size)
+{
+    const char *path = getenv("PATH"), *hashed, *p, *end;
+
+    if (strchr(name, '/') || !path)
+        return name;
+    if ((hashed = rc_which(name, path)) != NULL)
+        return hashed;
+    for (p = path; *p; p = *end ? end + 1 : end)
+    {
+        end = p + strcspn(p, ":");
+        snprintf(buf, size, "%.*s/%s", (int)(end - p), end > p ? p : ".", name);
+        if (access(buf, X_OK) == 0)
+            return buf;
+    }
+    return name;                /* the run says it is not found */
+}
+
+/* arg_max - Bytes of strings and pointers execve() takes */
+static long arg_max(void)
+{
+    long max = sysconf(_SC_ARG_MAX);
+
+    if (max <= 0 || max > STK_LIM / 4 * 3)
+        max = STK_LIM / 4 * 3;
+    return max;
+}
+
+/* The batch being collected */
+static struct batch {
+    char **args;                /* the command, then the batch's arguments */
+    int cap;                    /* of args */
+    int nfixed, n, max;         /* max arguments a run, 0 for no limit */
+    char *arena;                /* the arguments, one after another */
+    size_t size, used;
+    long limit, base, cost;     /* of a run, the command, the arguments */
+    int par, devnull;
+} b;
+
+/* launch - Start a run of the batch, once fewer than par are running */
+static void launch(void)
+{
+    sigset_t set, prev;
+    int fds[3] = { b.devnull, STDOUT_FILENO, STDERR_FILENO };
+    char *p = b.arena;
+
+    for (int i = 0; i < b.n; i++, p += strlen(p) + 1)
+        b.args[b.nfixed + i] = p;
+    b.args[b.nfixed + b.n] = NULL;
+
+    sigemptyset(&set);
+    sigaddset(&set, SIGINT);
+    sigaddset(&set, SIGTSTP);
+    sigaddset(&set, SIGCHLD);
+    sigprocmask(SIG_BLOCK, &set, &prev);
+    while (nrunning >= b.par && !stop)
+        wait_event(&prev);
+    if (!stop)
+    {
+        fflush(stdout);
+        running[nrunning++] = spawn(b.args, fds, 0, &set, NULL, NULL);
+    }
+    sigprocmask(SIG_SETMASK, &prev, NULL);
+}
+
+/*
+ * add - The argument at arena[from..used) is complete: put it in the
+ *     batch, after running the batch if it does not fit any more
+ */
+static void add(size_t from)
+{
+    size_t len = b.used - from;
+    long cost = len + sizeof(char *);
+
+    if (b.base + cost > b.limit || len > (size_t)sysconf(_SC_PAGESIZE) * 32)
+    {
+        printf("xargs: argument line too long\n");
+        b.used = from;
+        return;
+    }
+    if (b.n > 0 && (b.base + b.cost + cost > b.limit || b.n == b.max))
+    {
+        launch();
+        memmove(b.arena, b.arena + from, len);
+        b.used = len;
+        b.n = 0;
+        b.cost = 0;
+    }
+    if (b.nfixed + b.n + 2 > b.cap)
+    {
+        char **args = realloc(b.args, 2 * b.cap * sizeof(char *));
+
+        if (args == NULL)
+        {
+            printf("xargs: %s\n", strerror(errno));
+            stop = 1;
+            return;
+        }
+        b.args = args;
+        b.cap *= 2;
+    }
+    b.n++;
+    b.cost += cost;
+}
+
+/*
+ * next_block - Read the next block of input. Gives up (-1) when xargs is
+ *     stopped or the job writing the input, pgid, is stopped.
+ */
+static ssize_t next_block(int fd, pid_t pgid, char *buf, size_t size)
+{
+    struct job_t *job;
+    size_t k;
+    ssize_t n;
+
+    /* what the shell already read ahead of its stdin comes first */
+    if (fd == STDIN_FILENO && (k = in_take(buf, size)) > 0)
+        return k;
+    while (1)
+    {
+        if (stop)
+            return -1;
+        if (pgid && (job = getjobpid(jobs, pgid)) != NULL && job->state == ST)
+        {
+            printf("xargs: input stopped\n");
+            return -1;
+        }
+        if (!wait_input(fd, 100))
+            continue;
+        if ((n = read(fd, buf, size)) >= 0 || (errno != EINTR && errno != EAGAIN))
+            return n;
+    }
+}
+
+/*
+ * xargs_run - Run xargs [options] command [args] (argv) on the input
+ *     read from fd, which pgid (or 0) writes. Returns its status.
+ */
+static int xargs_run(char **argv, int fd, pid_t pgid)
+{
+    static char block[64 * 1024];
+    static char *echo[] = { "echo", NULL };
+    char path[MAXPATH], **cmd, *p, *q, *end = "", *opt;
+    char delim = '\n';
+    long max = 0, par = 1;
+    size_t tok, k;
+    sigset_t set, prev;
+    ssize_t got;
+    int i;
+
+    /* options */
+    for (i = 1; argv[i] && argv[i][0] == '-'; i++)
+    {
+        if (!strcmp(argv[i], "--"))
+        {
+            i++;
+            break;
+        }
+        if (!strcmp(argv[i], "-0"))
+        {
+            delim = '\0';
+            continue;
+        }
+        if ((strcmp(argv[i], "-n") && strcmp(argv[i], "-P")) || !(opt = argv[++i]))
+        {
+            printf("usage: xargs [-0] [-n max] [-P N] [command [args...]]\n");
+            return 1;
+        }
+        if (argv[i - 1][1] == 'n')
+            max = strtol(opt, &end, 10);
+        else if ((par = strtol(opt, &end, 10)) == 0)
+            par = sysconf(_SC_NPROCESSORS_ONLN);
+        if (*end || max < 0 || par < 1)
+        {
+            printf("xargs: %s: invalid number\n", opt);
+            return 1;
+        }
+    }
+    cmd = argv[i] ? argv + i : echo;
+
+    /* a run costs the file name execve() copies, the environment and the
+     * command with its fixed arguments, every string with its pointer */
+    memset(&b, 0, sizeof(b));
+    for (b.nfixed = 0; cmd[b.nfixed]; b.nfixed++)
+        ;
+    b.max = max;
+    b.par = par < MAXPAR ? par : MAXPAR;
+    b.limit = arg_max();
+    b.cap = b.nfixed + 1024;
+    if ((b.args = malloc(b.cap * sizeof(char *))) == NULL)
+        return 1;
+    memcpy(b.args, cmd, b.nfixed * sizeof(char *));
+    b.args[0] = (char *)which(cmd[0], path, sizeof(path));
+    b.base = strlen(b.args[0]) + 1;
+    for (char **e = environ; *e; e++)
+        b.base += strlen(*e) + 1 + sizeof(char *);
+    for (i = 0; i < b.nfixed; i++)
+        b.base += strlen(b.args[i]) + 1 + sizeof(char *);
+    if (b.base >= b.limit)
+    {
+        printf("xargs: the environment is too large for exec\n");
+        free(b.args);
+        return 126;
+    }
+
+    /* room for a full batch and the argument that does not fit in it */
+    b.size = b.limit - b.base + sysconf(_SC_PAGESIZE) * 32 + 1;
+    if ((b.arena = malloc(b.size)) == NULL
+        || (b.devnull = open("/dev/null", O_RDONLY | O_CLOEXEC)) < 0)
+    {
+        printf("xargs: %s\n", strerror(errno));
+        free(b.arena);
+        free(b.args);
+        return 1;
+    }
+
+    nrunning = result = stop = 0;
+    active = 1;
+    tok = 0;
+    while ((got = next_block(fd, pgid, block, sizeof(block))) > 0)
+    {
+        for (p = block, end = block + got; p < end && !stop; p = q + 1)
+        {
+            q = memchr(p, delim, end - p);
+            k = (q ? q : end) - p;
+            if (b.used + k + 1 > b.size)
+                k = b.size - 1 - b.used;    /* add() drops it, too long */
+            memcpy(b.arena + b.used, p, k);
+            b.used += k;
+            if (!q)
+                break;
+            b.arena[b.used++] = '\0';
+            if (b.used - tok == 1 && delim == '\n')
+                b.used = tok;               /* an empty line */
+            else
+                add(tok);
+            tok = b.used;
+        }
+    }
+    /* the last argument may have no delimiter */
+    if (b.used > tok && !stop)
+    {
+        b.arena[b.used++] = '\0';
+        add(tok);
+    }
+    if (b.n > 0 && !stop)
+        launch();
+
+    /* wait for the runs */
+    sigemptyset(&set);
+    sigaddset(&set, SIGCHLD);
+    sigprocmask(SIG_BLOCK, &set, &prev);
+    while (nrunning > 0)
+        wait_event(&prev);
+    sigprocmask(SIG_SETMASK, &prev, NULL);
+    active = 0;
+
+    close(b.devnull);
+    free(b.args);
+    free(b.arena);
+    return result;
+}
+
+/*
+ * do_xargs - Execute a command line whose last pipeline stage is xargs,
+ *     at argv[at]. The stages before it write its input, see
+ *     stage_input(). Takes over r.
+ */
+void do_xargs(char **argv, int at, char *cmdline, struct redir *r)
+{
+    pid_t pgid;
+    int fd;
+
+    if ((fd = stage_input(argv, at, cmdline, r, &pgid)) < 0)
+        return;
+    last_status = xargs_run(argv + at, fd, pgid);
+    if (fd != STDIN_FILENO)
+        close(fd);
+    if (pgid)
+    {
+        int status = last_status;
+
+        waitfg(pgid);
+        last_status = status;
+    }
+}
@@ -0,0 +1,135 @@
+/*
+ * zshc - Client for the zsh command server (zsh -S sock)
+ * NKU OS Course
+ * Shuhao Zhang
+ *
+ * file: zshc.c
+ *
+ * Sends a script to the server together with our stdin, stdout and
+ * stderr, waits for it to finish and exits with its status.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+void usage(void)
+{
+    printf("Usage: zshc -S socket [-c command | file]\n");
+    printf("   -S   socket of the zsh command server\n");
+    printf("   -c   run command instead of a script file\n");
+    printf("   with neither, the script is read from stdin\n");
+    exit(1);
+}
+
+void unix_error(char *msg)
+{
+    fprintf(stderr, "zshc: %s: %s\n", msg, strerror(errno));
+    exit(1);
+}
+
+/* read_script - Slurp the whole script from fd */
+char *read_script(int fd, int *len)
+{
+    size_t cap = 4096, n = 0;
+    char *buf = malloc(cap);
+    ssize_t r;
+
+    while (buf && (r = read(fd, buf + n, cap - n)) != 0)
+    {
+        if (r < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            unix_error("read error");
+        }
+        if ((n += r) == cap)
+            buf = realloc(buf, cap *= 2);
+    }
+    if (!buf)
+        unix_error("malloc error");
+    *len = n;
+    return buf;
+}
+
+int main(int argc, char **argv)
+{
+    char *path = NULL, *script = NULL;
+    struct sockaddr_un addr;
+    int c, fd, len, status;
+    int fds[3] = { STDIN_FILENO, STDOUT_FILENO, STDERR_FILENO };
+    struct iovec iov = { &len, sizeof(len) };
+    struct msghdr msg;
+    union {
+        struct cmsghdr hdr;
+        char buf[CMSG_SPACE(sizeof(fds))];
+    } ctl;
+    struct cmsghdr *cmsg;
+
+    while ((c = getopt(argc, argv, "hS:c:")) != EOF)
+    {
+        switch (c)
+        {
+        case 'S':
+            path = optarg;
+            break;
+        case 'c':
+            script = optarg;
+            len = strlen(script);
+            break;
+        default:
+            usage();
+        }
+    }
+    if (!path || strlen(path) >= sizeof(addr.sun_path))
+        usage();
+
+    if (!script)
+    {
+        int in = STDIN_FILENO;
+        if (optind < argc && (in = open(argv[optind], O_RDONLY)) < 0)
+            unix_error(argv[optind]);
+        script = read_script(in, &len);
+    }
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, path);
+    if ((fd = socket(AF_UNIX, SOCK_STREAM, 0)) < 0)
+        unix_error("socket error");
+    if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0)
+        unix_error(path);
+
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = ctl.buf;
+    msg.msg_controllen = sizeof(ctl.buf);
+    cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(fds));
+    memcpy(CMSG_DATA(cmsg), fds, sizeof(fds));
+
+    if (sendmsg(fd, &msg, 0) != sizeof(len))
+        unix_error("sendmsg error");
+    for (int n = 0, r; n < len; n += r)
+        if ((r = write(fd, script + n, len - n)) < 0)
+            unix_error("write error");
+
+    if (read(fd, &status, sizeof(status)) != sizeof(status))
+    {
+        fprintf(stderr, "zshc: server closed the connection\n");
+        exit(1);
+    }
+    if (status < 0)
+    {
+        fprintf(stderr, "zshc: server could not run the script\n");
+        exit(1);
+    }
+    exit(status);
+}